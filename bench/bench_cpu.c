@@ -0,0 +1,401 @@
+#define _XOPEN_SOURCE 700
+
+#include <file_utils.h>
+#include <radix_sort.h>
+#include <renderlib.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SAMPLES 15
+#define MIN_SAMPLE_NS 2e6
+
+// defined in mesh.c
+struct Mesh*
+mesh_parse(const void *data, size_t size, const void **r_vertex_data, const void **r_index_data);
+
+/**
+ * Benchmark case.
+ *
+ * `run` executes the measured operation `iterations` times and returns 0 on
+ * failure.
+ */
+struct Bench {
+	const char *name;
+	char param[64];
+	int (*run)(void *ctx, size_t iterations);
+	void *ctx;
+};
+
+struct FileCtx {
+	char *data;
+	size_t size;
+	int codec;
+};
+
+struct SortCtx {
+	struct SortKey *input;
+	struct SortKey *keys;
+	struct SortKey *tmp;
+	size_t count;
+};
+
+struct AnimCtx {
+	struct Skeleton skeleton;
+	struct Animation anim;
+	struct AnimationInstance *inst;
+};
+
+struct LightCtx {
+	struct Light light;
+	struct Camera camera;
+};
+
+static double
+clock_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static int
+double_cmp(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static int
+run_mesh_parse(void *ctx, size_t iterations)
+{
+	struct FileCtx *file = ctx;
+	for (size_t i = 0; i < iterations; i++) {
+		const void *vdata = NULL, *idata = NULL;
+		struct Mesh *mesh = mesh_parse(file->data, file->size, &vdata, &idata);
+		if (!mesh) {
+			return 0;
+		}
+		mesh_free(mesh);
+	}
+	return 1;
+}
+
+static int
+run_image_decode(void *ctx, size_t iterations)
+{
+	struct FileCtx *file = ctx;
+	for (size_t i = 0; i < iterations; i++) {
+		struct Image *image = image_from_buffer(file->data, file->size, file->codec);
+		if (!image) {
+			return 0;
+		}
+		image_free(image);
+	}
+	return 1;
+}
+
+static int
+run_animation_play(void *ctx, size_t iterations)
+{
+	struct AnimCtx *anim = ctx;
+	for (size_t i = 0; i < iterations; i++) {
+		if (!animation_instance_play(anim->inst, 1 / 60.0f)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int
+run_radix_sort(void *ctx, size_t iterations)
+{
+	struct SortCtx *sort = ctx;
+	for (size_t i = 0; i < iterations; i++) {
+		memcpy(sort->keys, sort->input, sort->count * sizeof(struct SortKey));
+		radix_sort(sort->keys, sort->tmp, sort->count);
+	}
+	return 1;
+}
+
+static int
+sort_key_cmp(const void *a, const void *b)
+{
+	uint64_t x = ((const struct SortKey*)a)->key;
+	uint64_t y = ((const struct SortKey*)b)->key;
+	return (x > y) - (x < y);
+}
+
+static int
+run_qsort(void *ctx, size_t iterations)
+{
+	struct SortCtx *sort = ctx;
+	for (size_t i = 0; i < iterations; i++) {
+		memcpy(sort->keys, sort->input, sort->count * sizeof(struct SortKey));
+		qsort(sort->keys, sort->count, sizeof(struct SortKey), sort_key_cmp);
+	}
+	return 1;
+}
+
+static int
+run_light_projection(void *ctx, size_t iterations)
+{
+	struct LightCtx *lc = ctx;
+	for (size_t i = 0; i < iterations; i++) {
+		light_update_projection(&lc->light, &lc->camera);
+	}
+	return 1;
+}
+
+static struct FileCtx*
+file_ctx_new(const char *filename, int codec)
+{
+	struct FileCtx *file = malloc(sizeof(struct FileCtx));
+	if (!file) {
+		return NULL;
+	}
+	file->data = NULL;
+	file->codec = codec;
+	if ((file->size = file_read(filename, &file->data)) == 0) {
+		free(file);
+		return NULL;
+	}
+	return file;
+}
+
+static struct SortCtx*
+sort_ctx_new(size_t count)
+{
+	struct SortCtx *sort = malloc(sizeof(struct SortCtx));
+	if (!sort) {
+		return NULL;
+	}
+	sort->count = count;
+	sort->input = malloc(count * sizeof(struct SortKey));
+	sort->keys = malloc(count * sizeof(struct SortKey));
+	sort->tmp = malloc(count * sizeof(struct SortKey));
+	if (!sort->input || !sort->keys || !sort->tmp) {
+		return NULL;
+	}
+
+	// keys resembling render queue ones: a few distinct pipeline states
+	// in the high bits, scattered meshes and depths below
+	for (size_t i = 0; i < count; i++) {
+		uint64_t state = rand() % 8;
+		uint64_t mesh = rand() % 64;
+		uint64_t depth = rand() & 0xffff;
+		sort->input[i].key = state << 56 | depth << 24 | mesh << 8;
+		sort->input[i].index = i;
+	}
+	return sort;
+}
+
+/**
+ * Build a synthetic animation of a chain of joints, each one rotating about
+ * its parent.
+ */
+static struct AnimCtx*
+anim_ctx_new(unsigned joint_count, unsigned pose_count)
+{
+	struct AnimCtx *anim = malloc(sizeof(struct AnimCtx));
+	if (!anim) {
+		return NULL;
+	}
+
+	anim->skeleton.joint_count = joint_count;
+	anim->skeleton.joints = malloc(joint_count * sizeof(struct Joint));
+	if (!anim->skeleton.joints) {
+		return NULL;
+	}
+	for (unsigned j = 0; j < joint_count; j++) {
+		mat_ident(&anim->skeleton.joints[j].inv_bind_pose);
+		anim->skeleton.joints[j].parent = j == 0 ? 0xff : j - 1;
+	}
+
+	anim->anim.skeleton = &anim->skeleton;
+	anim->anim.duration = pose_count - 1;
+	anim->anim.speed = 25.0f;
+	anim->anim.pose_count = pose_count;
+	anim->anim.timestamps = malloc(pose_count * sizeof(float));
+	anim->anim.poses = malloc(pose_count * sizeof(struct SkeletonPose));
+	if (!anim->anim.timestamps || !anim->anim.poses) {
+		return NULL;
+	}
+	for (unsigned p = 0; p < pose_count; p++) {
+		struct SkeletonPose *sp = &anim->anim.poses[p];
+		anim->anim.timestamps[p] = p;
+		sp->skeleton = &anim->skeleton;
+		sp->joint_poses = malloc(joint_count * sizeof(struct JointPose));
+		if (!sp->joint_poses) {
+			return NULL;
+		}
+		for (unsigned j = 0; j < joint_count; j++) {
+			float half_angle = 0.005f * p;
+			sp->joint_poses[j].trans = vec(0, 1, 0, 0);
+			sp->joint_poses[j].rot = qtr(cosf(half_angle), 0, 0, sinf(half_angle));
+			sp->joint_poses[j].scale = vec(1, 1, 1, 0);
+		}
+	}
+
+	anim->inst = animation_instance_new(&anim->anim);
+	return anim->inst ? anim : NULL;
+}
+
+static struct LightCtx*
+light_ctx_new(void)
+{
+	struct LightCtx *lc = malloc(sizeof(struct LightCtx));
+	if (!lc) {
+		return NULL;
+	}
+	camera_init_perspective(&lc->camera, 45.0f, 4 / 3.0f, 1, 100);
+	Vec eye = vec(5, 5, 5, 0);
+	Vec origin = vec(0, 0, 0, 0);
+	Vec up = vec(0, 1, 0, 0);
+	mat_lookatv(&lc->camera.view, &eye, &origin, &up);
+	lc->light.direction = vec(0, -5, -5, 0);
+	vec_norm(&lc->light.direction);
+	return lc;
+}
+
+/**
+ * Run a benchmark and print its results as a JSON object.
+ *
+ * The iteration count is doubled until a sample takes long enough to be
+ * measured reliably, then a fixed number of samples is taken.
+ */
+static int
+measure(struct Bench *bench, int first)
+{
+	if (!bench->ctx) {
+		fprintf(stderr, "failed to set up %s %s\n", bench->name, bench->param);
+		return 0;
+	}
+
+	size_t iterations = 1;
+	double elapsed;
+	for (;;) {
+		double start = clock_ns();
+		if (!bench->run(bench->ctx, iterations)) {
+			return 0;
+		}
+		elapsed = clock_ns() - start;
+		if (elapsed >= MIN_SAMPLE_NS) {
+			break;
+		}
+		iterations *= 2;
+	}
+
+	double samples[SAMPLES], sum = 0;
+	for (int s = 0; s < SAMPLES; s++) {
+		double start = clock_ns();
+		if (!bench->run(bench->ctx, iterations)) {
+			return 0;
+		}
+		samples[s] = (clock_ns() - start) / iterations;
+		sum += samples[s];
+	}
+	qsort(samples, SAMPLES, sizeof(double), double_cmp);
+
+	printf(
+		"%s\n    {\"name\": \"%s\", \"param\": \"%s\", \"iterations\": %zu, "
+		"\"ns_per_op\": {\"min\": %.1f, \"median\": %.1f, \"mean\": %.1f, \"max\": %.1f}}",
+		first ? "" : ",",
+		bench->name,
+		bench->param,
+		iterations,
+		samples[0],
+		samples[SAMPLES / 2],
+		sum / SAMPLES,
+		samples[SAMPLES - 1]
+	);
+	fflush(stdout);
+	return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	srand(1);
+
+	struct Bench benches[32];
+	int count = 0;
+
+	const char *meshes[] = {"tests/data/zombie.mesh", "tests/data/plane.mesh"};
+	for (int i = 0; i < 2; i++) {
+		struct Bench *b = &benches[count++];
+		b->name = "mesh_parse";
+		snprintf(b->param, sizeof(b->param), "%s", meshes[i]);
+		b->run = run_mesh_parse;
+		b->ctx = file_ctx_new(meshes[i], 0);
+	}
+
+	struct {
+		const char *filename;
+		int codec;
+	} images[] = {
+		{"tests/data/blue_panel.png", IMAGE_CODEC_PNG},
+		{"tests/data/zombie.jpg", IMAGE_CODEC_JPEG}
+	};
+	for (int i = 0; i < 2; i++) {
+		struct Bench *b = &benches[count++];
+		b->name = "image_from_buffer";
+		snprintf(b->param, sizeof(b->param), "%s", images[i].filename);
+		b->run = run_image_decode;
+		b->ctx = file_ctx_new(images[i].filename, images[i].codec);
+	}
+
+	unsigned joint_counts[] = {16, 64, 255};
+	for (int i = 0; i < 3; i++) {
+		struct Bench *b = &benches[count++];
+		b->name = "animation_instance_play";
+		snprintf(b->param, sizeof(b->param), "joints=%u", joint_counts[i]);
+		b->run = run_animation_play;
+		b->ctx = anim_ctx_new(joint_counts[i], 30);
+	}
+
+	// both include the copy of the unsorted keys
+	size_t queue_sizes[] = {256, 4096, 65536};
+	for (int i = 0; i < 3; i++) {
+		struct SortCtx *ctx = sort_ctx_new(queue_sizes[i]);
+
+		struct Bench *b = &benches[count++];
+		b->name = "radix_sort";
+		snprintf(b->param, sizeof(b->param), "ops=%zu", queue_sizes[i]);
+		b->run = run_radix_sort;
+		b->ctx = ctx;
+
+		b = &benches[count++];
+		b->name = "qsort";
+		snprintf(b->param, sizeof(b->param), "ops=%zu", queue_sizes[i]);
+		b->run = run_qsort;
+		b->ctx = ctx;
+	}
+
+	struct Bench *b = &benches[count++];
+	b->name = "light_update_projection";
+	b->param[0] = '\0';
+	b->run = run_light_projection;
+	b->ctx = light_ctx_new();
+
+	// run the benchmarks whose name matches the filter, if any
+	const char *filter = argc > 1 ? argv[1] : NULL;
+	int ok = 1, first = 1;
+	printf("{\n  \"benchmarks\": [");
+	for (int i = 0; ok && i < count; i++) {
+		if (!filter || strstr(benches[i].name, filter)) {
+			ok = measure(&benches[i], first);
+			first = 0;
+		}
+	}
+	printf("\n  ]\n}\n");
+
+	if (!ok) {
+		error_dump_traceback(stderr);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,617 @@
+#define _XOPEN_SOURCE 700
+
+#include <SDL.h>
+#include <matlib.h>
+#include <renderlib.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WIDTH 800
+#define HEIGHT 600
+#define FRAME_DT (1 / 60.0f)
+#define SPHERE_KINDS 4
+#define MATERIAL_KINDS 4
+
+static SDL_Window *window = NULL;
+static SDL_GLContext *context = NULL;
+
+// benchmark configuration, set from command line
+static struct {
+	int static_meshes;
+	int skinned_meshes;
+	int texts;
+	int quads;
+	int frames;
+	int warmup;
+	int headless;
+	const char *trace;
+} config = {
+	.static_meshes = 1000,
+	.skinned_meshes = 50,
+	.texts = 50,
+	.quads = 100,
+	.frames = 500,
+	.warmup = 50,
+	.headless = 0,
+	.trace = NULL
+};
+
+static struct Camera camera;
+static struct Camera ui_camera;
+static struct Light light;
+static struct Scene *scene = NULL;
+static struct Scene *ui_scene = NULL;
+
+// resources shared by scene objects
+static struct Mesh *spheres[SPHERE_KINDS];
+static struct Material materials[MATERIAL_KINDS];
+static struct MeshProps static_props[SPHERE_KINDS * MATERIAL_KINDS];
+static struct Mesh *skinned_mesh = NULL;
+static struct Font *font = NULL;
+static struct Quad quad = {.width = 24, .height = 24};
+static struct QuadProps quad_props;
+static struct TextProps text_props;
+
+// per-object resources
+static struct AnimationInstance **animations = NULL;
+static struct MeshProps *skinned_props = NULL;
+static struct Text **texts = NULL;
+
+// per-frame measurements
+static double *frame_times = NULL;
+static struct RenderStats stats_acc;
+
+static void
+usage(const char *program)
+{
+	fprintf(
+		stderr,
+		"usage: %s [options]\n"
+		"  --meshes N    static meshes (default %d)\n"
+		"  --skinned N   skinned meshes (default %d)\n"
+		"  --texts N     text labels (default %d)\n"
+		"  --quads N     overlay quads (default %d)\n"
+		"  --frames N    measured frames (default %d)\n"
+		"  --warmup N    frames run before measuring (default %d)\n"
+		"  --headless    render offscreen, without a window\n"
+		"  --trace FILE  write Chrome trace JSON of measured frames\n",
+		program,
+		config.static_meshes,
+		config.skinned_meshes,
+		config.texts,
+		config.quads,
+		config.frames,
+		config.warmup
+	);
+}
+
+static int
+parse_args(int argc, char *argv[])
+{
+	struct {
+		const char *name;
+		int *value;
+	} options[] = {
+		{"--meshes", &config.static_meshes},
+		{"--skinned", &config.skinned_meshes},
+		{"--texts", &config.texts},
+		{"--quads", &config.quads},
+		{"--frames", &config.frames},
+		{"--warmup", &config.warmup},
+	};
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			config.headless = 1;
+			continue;
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			config.trace = argv[++i];
+			continue;
+		}
+
+		int found = 0;
+		for (unsigned o = 0; o < sizeof(options) / sizeof(options[0]); o++) {
+			if (strcmp(argv[i], options[o].name) == 0 && i + 1 < argc) {
+				*options[o].value = atoi(argv[++i]);
+				found = 1;
+				break;
+			}
+		}
+		if (!found) {
+			return 0;
+		}
+	}
+
+	return (
+		config.static_meshes >= 0 &&
+		config.skinned_meshes >= 0 &&
+		config.texts >= 0 &&
+		config.quads >= 0 &&
+		config.frames > 0 &&
+		config.warmup >= 0
+	);
+}
+
+static int
+init(unsigned width, unsigned height)
+{
+	if (config.headless) {
+		if (!renderer_init_headless(width, height)) {
+			return 0;
+		}
+	} else {
+		// initialize SDL video subsystem
+		if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+			return 0;
+		}
+
+		// create window
+		window = SDL_CreateWindow(
+			"renderlib benchmark",
+			SDL_WINDOWPOS_CENTERED,
+			SDL_WINDOWPOS_CENTERED,
+			width,
+			height,
+			SDL_WINDOW_OPENGL
+		);
+		if (!window) {
+			return 0;
+		}
+
+		// initialize OpenGL context
+		SDL_GL_SetAttribute(
+			SDL_GL_CONTEXT_PROFILE_MASK,
+			SDL_GL_CONTEXT_PROFILE_CORE
+		);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+		context = SDL_GL_CreateContext(window);
+		if (!context) {
+			return 0;
+		}
+
+		// disable vsync, in order to measure the renderer alone
+		SDL_GL_SetSwapInterval(0);
+
+		if (!renderer_init()) {
+			return 0;
+		}
+	}
+
+	// 2D orthographic camera for overlay
+	camera_init_orthographic(
+		&ui_camera,
+		-WIDTH / 2,
+		+WIDTH / 2,
+		+HEIGHT / 2,
+		-HEIGHT / 2,
+		0,
+		1
+	);
+
+	// perspective camera looking at the center of objects grid
+	camera_init_perspective(&camera, 45.0f, WIDTH / (float)HEIGHT, 1, 200);
+	Vec eye = vec(0, 40, 60, 0);
+	Vec origin = vec(0, 0, 0, 0);
+	Vec up = vec(0, 1, 0, 0);
+	camera.position = eye;
+	mat_lookatv(&camera.view, &eye, &origin, &up);
+
+	light.color = vec(1, 1, 1, 1);
+	light.ambient_intensity = 0.3;
+	light.diffuse_intensity = 1.0;
+	light.direction = vec(0, -5, -5, 0);
+	vec_norm(&light.direction);
+
+	return 1;
+}
+
+static void
+shutdown(void)
+{
+	renderer_shutdown();
+
+	if (context) {
+		SDL_GL_DeleteContext(context);
+		context = NULL;
+	}
+	if (window) {
+		SDL_DestroyWindow(window);
+		window = NULL;
+	}
+	if (!config.headless) {
+		SDL_Quit();
+	}
+}
+
+/**
+ * Generate a unit UV sphere with given tessellation.
+ */
+static struct Mesh*
+sphere_new(unsigned rings, unsigned sectors)
+{
+	size_t vertex_count = (rings + 1) * (sectors + 1);
+	size_t index_count = rings * sectors * 6;
+	float (*vertices)[3] = malloc(vertex_count * sizeof(*vertices));
+	float (*normals)[3] = malloc(vertex_count * sizeof(*normals));
+	uint32_t *indices = malloc(index_count * sizeof(uint32_t));
+	struct Mesh *mesh = NULL;
+	if (!vertices || !normals || !indices) {
+		goto cleanup;
+	}
+
+	size_t v = 0;
+	for (unsigned r = 0; r <= rings; r++) {
+		float theta = M_PI * r / rings;
+		for (unsigned s = 0; s <= sectors; s++, v++) {
+			float phi = 2 * M_PI * s / sectors;
+			normals[v][0] = sinf(theta) * cosf(phi);
+			normals[v][1] = cosf(theta);
+			normals[v][2] = sinf(theta) * sinf(phi);
+			memcpy(vertices[v], normals[v], sizeof(vertices[v]));
+		}
+	}
+
+	size_t i = 0;
+	for (unsigned r = 0; r < rings; r++) {
+		for (unsigned s = 0; s < sectors; s++) {
+			uint32_t a = r * (sectors + 1) + s;
+			uint32_t b = a + sectors + 1;
+			indices[i++] = a;
+			indices[i++] = b;
+			indices[i++] = a + 1;
+			indices[i++] = a + 1;
+			indices[i++] = b;
+			indices[i++] = b + 1;
+		}
+	}
+
+	mesh = mesh_new(
+		vertices,
+		normals,
+		NULL,
+		NULL,
+		NULL,
+		vertex_count,
+		indices,
+		index_count
+	);
+
+cleanup:
+	free(vertices);
+	free(normals);
+	free(indices);
+	return mesh;
+}
+
+static int
+load_resources(void)
+{
+	for (int i = 0; i < SPHERE_KINDS; i++) {
+		if (!(spheres[i] = sphere_new(8 << i, 16 << i))) {
+			return 0;
+		}
+	}
+
+	for (int i = 0; i < MATERIAL_KINDS; i++) {
+		materials[i].texture = NULL;
+		materials[i].color = vec(
+			(i & 1) ? 0.9 : 0.3,
+			(i & 2) ? 0.9 : 0.3,
+			0.5,
+			1.0
+		);
+		materials[i].receive_light = 1;
+		materials[i].specular_intensity = 0.2 * i;
+		materials[i].specular_power = 4;
+	}
+
+	for (int i = 0; i < SPHERE_KINDS * MATERIAL_KINDS; i++) {
+		memset(&static_props[i], 0, sizeof(struct MeshProps));
+		static_props[i].cast_shadows = 1;
+		static_props[i].receive_shadows = 1;
+		static_props[i].material = &materials[i % MATERIAL_KINDS];
+	}
+
+	if (config.skinned_meshes > 0 &&
+	    (!(skinned_mesh = mesh_from_file("tests/data/zombie.mesh")) ||
+	     skinned_mesh->anim_count == 0)) {
+		return 0;
+	}
+
+	if (config.texts > 0 &&
+	    !(font = font_from_file("tests/data/kenvector_future.ttf", 12))) {
+		return 0;
+	}
+	text_props.color = vec(1, 1, 1, 1);
+	text_props.opacity = 1.0;
+
+	memset(&quad_props, 0, sizeof(struct QuadProps));
+	quad_props.color = vec(0.2, 0.4, 0.8, 1);
+	quad_props.opacity = 0.8;
+
+	animations = calloc(config.skinned_meshes, sizeof(struct AnimationInstance*));
+	skinned_props = calloc(config.skinned_meshes, sizeof(struct MeshProps));
+	texts = calloc(config.texts, sizeof(struct Text*));
+	frame_times = malloc(config.frames * sizeof(double));
+	if ((config.skinned_meshes > 0 && (!animations || !skinned_props)) ||
+	    (config.texts > 0 && !texts) ||
+	    !frame_times) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Lay the i-th out of `count` objects on a square grid centered at origin.
+ */
+static Vec
+grid_position(int i, int count, float spacing)
+{
+	int side = ceilf(sqrtf(count));
+	float offset = (side - 1) * spacing / 2;
+	return vec(
+		(i % side) * spacing - offset,
+		0,
+		(i / side) * spacing - offset,
+		0
+	);
+}
+
+static int
+setup_scene(void)
+{
+	if (!(scene = scene_new()) || !(ui_scene = scene_new())) {
+		return 0;
+	}
+
+	// static meshes, interleaving mesh and material kinds so that
+	// consecutive objects don't share state
+	for (int i = 0; i < config.static_meshes; i++) {
+		struct Object *obj = scene_add_mesh(
+			scene,
+			spheres[i % SPHERE_KINDS],
+			&static_props[i % (SPHERE_KINDS * MATERIAL_KINDS)]
+		);
+		if (!obj) {
+			return 0;
+		}
+		obj->position = grid_position(i, config.static_meshes, 2.5);
+	}
+
+	// skinned meshes, each with its own animation instance desynchronized
+	// from the others
+	for (int i = 0; i < config.skinned_meshes; i++) {
+		struct Animation *anim = &skinned_mesh->animations[i % skinned_mesh->anim_count];
+		if (!(animations[i] = animation_instance_new(anim)) ||
+		    !animation_instance_play(animations[i], i * 0.1f)) {
+			return 0;
+		}
+		skinned_props[i].cast_shadows = 1;
+		skinned_props[i].receive_shadows = 1;
+		skinned_props[i].animation = animations[i];
+		skinned_props[i].material = &materials[i % MATERIAL_KINDS];
+
+		struct Object *obj = scene_add_mesh(scene, skinned_mesh, &skinned_props[i]);
+		if (!obj) {
+			return 0;
+		}
+		obj->position = grid_position(i, config.skinned_meshes, 4);
+		obj->position.data[1] = 2;
+		obj->scale = vec(0.02, 0.02, 0.02, 0);
+	}
+
+	// text labels
+	for (int i = 0; i < config.texts; i++) {
+		if (!(texts[i] = text_new(font)) ||
+		    !text_set_fmt(texts[i], "Label %d", i)) {
+			return 0;
+		}
+		struct Object *obj = scene_add_text(ui_scene, texts[i], &text_props);
+		if (!obj) {
+			return 0;
+		}
+		obj->position = vec(
+			(i % 8) * 100 - WIDTH / 2 + 10,
+			HEIGHT / 2 - 20 - (i / 8 % 28) * 20,
+			0.1,
+			0
+		);
+	}
+
+	// overlay quads
+	for (int i = 0; i < config.quads; i++) {
+		struct Object *obj = scene_add_quad(ui_scene, &quad, &quad_props);
+		if (!obj) {
+			return 0;
+		}
+		obj->position = vec(
+			(i % 30) * 26 - WIDTH / 2 + 10,
+			-HEIGHT / 2 + 30 + (i / 30 % 20) * 26,
+			0,
+			0
+		);
+	}
+
+	return 1;
+}
+
+static void
+cleanup_resources(void)
+{
+	scene_free(ui_scene);
+	scene_free(scene);
+	for (int i = 0; texts && i < config.texts; i++) {
+		text_free(texts[i]);
+	}
+	free(texts);
+	for (int i = 0; animations && i < config.skinned_meshes; i++) {
+		animation_instance_free(animations[i]);
+	}
+	free(animations);
+	free(skinned_props);
+	font_free(font);
+	mesh_free(skinned_mesh);
+	for (int i = 0; i < SPHERE_KINDS; i++) {
+		mesh_free(spheres[i]);
+	}
+	free(frame_times);
+}
+
+static double
+clock_ms(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static int
+render_frame(void)
+{
+	for (int i = 0; i < config.skinned_meshes; i++) {
+		if (!animation_instance_play(animations[i], FRAME_DT)) {
+			return 0;
+		}
+	}
+
+	renderer_clear();
+	int ok = (
+		scene_render(scene, RENDER_TARGET_FRAMEBUFFER, &camera, &light) &&
+		scene_render(ui_scene, RENDER_TARGET_OVERLAY, &ui_camera, NULL) &&
+		renderer_present()
+	);
+
+	if (window) {
+		SDL_GL_SwapWindow(window);
+	}
+
+	return ok;
+}
+
+static int
+run(void)
+{
+	for (int f = 0; f < config.warmup; f++) {
+		if (!render_frame()) {
+			return 0;
+		}
+	}
+
+	memset(&stats_acc, 0, sizeof(stats_acc));
+	renderer_trace_clear();
+	for (int f = 0; f < config.frames; f++) {
+		// CPU time of the submission path: scene traversal, queueing and
+		// `renderer_present()`, swap excluded
+		double start = clock_ms();
+		if (!render_frame()) {
+			return 0;
+		}
+		frame_times[f] = clock_ms() - start;
+
+		struct RenderStats stats;
+		renderer_get_stats(&stats);
+		stats_acc.draw_calls += stats.draw_calls;
+		stats_acc.triangles += stats.triangles;
+		stats_acc.shadow_ops += stats.shadow_ops;
+		stats_acc.depth_ops += stats.depth_ops;
+		stats_acc.render_ops += stats.render_ops;
+		stats_acc.overlay_ops += stats.overlay_ops;
+	}
+
+	return !config.trace || renderer_trace_dump(config.trace);
+}
+
+static int
+double_cmp(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static double
+percentile(const double *sorted, int count, double p)
+{
+	int i = ceil(p / 100.0 * count) - 1;
+	return sorted[i < 0 ? 0 : i];
+}
+
+static void
+report(void)
+{
+	int n = config.frames;
+	qsort(frame_times, n, sizeof(double), double_cmp);
+	double sum = 0;
+	for (int i = 0; i < n; i++) {
+		sum += frame_times[i];
+	}
+
+	printf(
+		"scene: %d static meshes, %d skinned meshes, %d texts, %d quads\n",
+		config.static_meshes,
+		config.skinned_meshes,
+		config.texts,
+		config.quads
+	);
+	printf(
+		"frames: %d (+%d warmup)%s\n",
+		n,
+		config.warmup,
+		config.headless ? ", headless" : ""
+	);
+	printf(
+		"cpu ms: mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+		sum / n,
+		percentile(frame_times, n, 50),
+		percentile(frame_times, n, 90),
+		percentile(frame_times, n, 99),
+		frame_times[n - 1]
+	);
+	printf(
+		"per frame: %zu draw calls, %zu triangles\n",
+		stats_acc.draw_calls / n,
+		stats_acc.triangles / n
+	);
+	printf(
+		"queues: shadow %zu  depth %zu  render %zu  overlay %zu\n",
+		stats_acc.shadow_ops / n,
+		stats_acc.depth_ops / n,
+		stats_acc.render_ops / n,
+		stats_acc.overlay_ops / n
+	);
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (!parse_args(argc, argv)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int ok = (
+		init(WIDTH, HEIGHT) &&
+		load_resources() &&
+		setup_scene() &&
+		run()
+	);
+
+	if (ok) {
+		report();
+	}
+
+	cleanup_resources();
+	shutdown();
+
+	if (!ok) {
+		error_dump_traceback(stderr);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
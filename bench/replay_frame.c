@@ -0,0 +1,409 @@
+#define _XOPEN_SOURCE 700
+
+#include <SDL.h>
+#include <renderlib.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_ASSETS 256
+#define DEFAULT_FONT_SIZE 12
+
+static SDL_Window *window = NULL;
+static SDL_GLContext *context = NULL;
+
+// replay configuration, set from command line
+static struct {
+	const char *filename;
+	int frames;
+	int warmup;
+	int width;
+	int height;
+	int headless;
+	int null;
+} config = {
+	.filename = NULL,
+	.frames = 500,
+	.warmup = 50,
+	.width = 800,
+	.height = 600,
+	.headless = 0,
+	.null = 0
+};
+
+// assets loaded for the capture, freed at exit
+static struct {
+	int type;
+	void *asset;
+} assets[MAX_ASSETS];
+static int asset_count = 0;
+
+static struct RenderCapture *capture = NULL;
+
+// per-frame measurements
+static double *frame_times = NULL;
+static struct RenderStats stats_acc;
+
+static void
+usage(const char *program)
+{
+	fprintf(
+		stderr,
+		"usage: %s [options] CAPTURE\n"
+		"  --frames N    measured frames (default %d)\n"
+		"  --warmup N    frames run before measuring (default %d)\n"
+		"  --width N     framebuffer width (default %d)\n"
+		"  --height N    framebuffer height (default %d)\n"
+		"  --headless    render offscreen, without a window\n"
+		"  --null        discard OpenGL calls, measure CPU side only\n"
+		"\n"
+		"Asset IDs are file paths, optionally followed by ':PARAM', which is\n"
+		"the point size of fonts (default %d), or 'rect' for rectangle\n"
+		"textures.\n",
+		program,
+		config.frames,
+		config.warmup,
+		config.width,
+		config.height,
+		DEFAULT_FONT_SIZE
+	);
+}
+
+static int
+parse_args(int argc, char *argv[])
+{
+	struct {
+		const char *name;
+		int *value;
+	} options[] = {
+		{"--frames", &config.frames},
+		{"--warmup", &config.warmup},
+		{"--width", &config.width},
+		{"--height", &config.height},
+	};
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			config.headless = 1;
+			continue;
+		} else if (strcmp(argv[i], "--null") == 0) {
+			config.null = 1;
+			continue;
+		} else if (argv[i][0] != '-' && !config.filename) {
+			config.filename = argv[i];
+			continue;
+		}
+
+		int found = 0;
+		for (unsigned o = 0; o < sizeof(options) / sizeof(options[0]); o++) {
+			if (strcmp(argv[i], options[o].name) == 0 && i + 1 < argc) {
+				*options[o].value = atoi(argv[++i]);
+				found = 1;
+				break;
+			}
+		}
+		if (!found) {
+			return 0;
+		}
+	}
+
+	return (
+		config.filename &&
+		!(config.headless && config.null) &&
+		config.frames > 0 &&
+		config.warmup >= 0 &&
+		config.width > 0 &&
+		config.height > 0
+	);
+}
+
+static int
+init(void)
+{
+	if (config.null) {
+		if (!renderer_init_null()) {
+			return 0;
+		}
+	} else if (config.headless) {
+		if (!renderer_init_headless(config.width, config.height)) {
+			return 0;
+		}
+	} else {
+		// initialize SDL video subsystem
+		if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+			return 0;
+		}
+
+		// create window
+		window = SDL_CreateWindow(
+			"renderlib frame replay",
+			SDL_WINDOWPOS_CENTERED,
+			SDL_WINDOWPOS_CENTERED,
+			config.width,
+			config.height,
+			SDL_WINDOW_OPENGL
+		);
+		if (!window) {
+			return 0;
+		}
+
+		// initialize OpenGL context
+		SDL_GL_SetAttribute(
+			SDL_GL_CONTEXT_PROFILE_MASK,
+			SDL_GL_CONTEXT_PROFILE_CORE
+		);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+		context = SDL_GL_CreateContext(window);
+		if (!context) {
+			return 0;
+		}
+
+		// disable vsync, in order to measure the renderer alone
+		SDL_GL_SetSwapInterval(0);
+
+		if (!renderer_init()) {
+			return 0;
+		}
+	}
+
+	frame_times = malloc(sizeof(double) * config.frames);
+	return frame_times != NULL;
+}
+
+static void
+shutdown(void)
+{
+	renderer_shutdown();
+
+	if (context) {
+		SDL_GL_DeleteContext(context);
+		context = NULL;
+	}
+	if (window) {
+		SDL_DestroyWindow(window);
+		window = NULL;
+	}
+	if (!config.headless && !config.null) {
+		SDL_Quit();
+	}
+}
+
+/**
+ * Load a capture asset given its ID, see `usage()` for ID format.
+ */
+static void*
+load_asset(int type, const char *id, void *userdata)
+{
+	if (asset_count == MAX_ASSETS) {
+		fprintf(stderr, "too many assets\n");
+		return NULL;
+	}
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s", id);
+	const char *param = "";
+	char *sep = strrchr(path, ':');
+	if (sep) {
+		*sep = '\0';
+		param = sep + 1;
+	}
+
+	void *asset = NULL;
+	switch (type) {
+	case RENDER_ASSET_MESH:
+		asset = mesh_from_file(path);
+		break;
+	case RENDER_ASSET_TEXTURE:
+		{
+			struct Image *image = image_from_file(path);
+			if (image) {
+				GLenum target = (
+					strcmp(param, "rect") == 0
+					? GL_TEXTURE_RECTANGLE
+					: GL_TEXTURE_2D
+				);
+				asset = texture_from_image(image, target);
+				image_free(image);
+			}
+		}
+		break;
+	case RENDER_ASSET_FONT:
+		asset = font_from_file(path, *param ? atoi(param) : DEFAULT_FONT_SIZE);
+		break;
+	}
+
+	if (asset) {
+		assets[asset_count].type = type;
+		assets[asset_count].asset = asset;
+		asset_count++;
+	}
+	return asset;
+}
+
+static void
+cleanup_resources(void)
+{
+	render_capture_free(capture);
+	capture = NULL;
+	for (int i = 0; i < asset_count; i++) {
+		switch (assets[i].type) {
+		case RENDER_ASSET_MESH:
+			mesh_free(assets[i].asset);
+			break;
+		case RENDER_ASSET_TEXTURE:
+			texture_free(assets[i].asset);
+			break;
+		case RENDER_ASSET_FONT:
+			font_free(assets[i].asset);
+			break;
+		}
+	}
+	asset_count = 0;
+	free(frame_times);
+}
+
+static double
+clock_ms(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static int
+render_frame(void)
+{
+	renderer_clear();
+	int ok = (
+		render_capture_submit(capture) &&
+		renderer_present()
+	);
+
+	if (window) {
+		SDL_GL_SwapWindow(window);
+	}
+
+	return ok;
+}
+
+static int
+run(void)
+{
+	for (int f = 0; f < config.warmup; f++) {
+		if (!render_frame()) {
+			return 0;
+		}
+	}
+
+	memset(&stats_acc, 0, sizeof(stats_acc));
+	for (int f = 0; f < config.frames; f++) {
+		// CPU time of submission and `renderer_present()`, swap excluded
+		double start = clock_ms();
+		if (!render_frame()) {
+			return 0;
+		}
+		frame_times[f] = clock_ms() - start;
+
+		struct RenderStats stats;
+		renderer_get_stats(&stats);
+		stats_acc.draw_calls += stats.draw_calls;
+		stats_acc.triangles += stats.triangles;
+		stats_acc.gl_calls += stats.gl_calls;
+		stats_acc.shadow_ops += stats.shadow_ops;
+		stats_acc.depth_ops += stats.depth_ops;
+		stats_acc.render_ops += stats.render_ops;
+		stats_acc.overlay_ops += stats.overlay_ops;
+	}
+
+	return 1;
+}
+
+static int
+double_cmp(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static double
+percentile(const double *sorted, int count, double p)
+{
+	int i = ceil(p / 100.0 * count) - 1;
+	return sorted[i < 0 ? 0 : i];
+}
+
+static void
+report(void)
+{
+	int n = config.frames;
+	qsort(frame_times, n, sizeof(double), double_cmp);
+	double sum = 0;
+	for (int i = 0; i < n; i++) {
+		sum += frame_times[i];
+	}
+
+	printf("capture: %s, %d assets\n", config.filename, asset_count);
+	printf(
+		"frames: %d (+%d warmup)%s\n",
+		n,
+		config.warmup,
+		config.null ? ", null backend" : config.headless ? ", headless" : ""
+	);
+	printf(
+		"cpu ms: mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+		sum / n,
+		percentile(frame_times, n, 50),
+		percentile(frame_times, n, 90),
+		percentile(frame_times, n, 99),
+		frame_times[n - 1]
+	);
+	printf(
+		"per frame: %zu draw calls, %zu triangles",
+		stats_acc.draw_calls / n,
+		stats_acc.triangles / n
+	);
+	if (config.null) {
+		printf(", %zu gl calls", stats_acc.gl_calls / n);
+	}
+	printf("\n");
+	printf(
+		"queues: shadow %zu  depth %zu  render %zu  overlay %zu\n",
+		stats_acc.shadow_ops / n,
+		stats_acc.depth_ops / n,
+		stats_acc.render_ops / n,
+		stats_acc.overlay_ops / n
+	);
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (!parse_args(argc, argv)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int ok = (
+		init() &&
+		(capture = render_capture_load(config.filename, load_asset, NULL)) &&
+		run()
+	);
+
+	if (ok) {
+		report();
+	}
+
+	cleanup_resources();
+	shutdown();
+
+	if (!ok) {
+		error_dump_traceback(stderr);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
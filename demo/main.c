@@ -445,6 +445,12 @@ update(float dt)
 			case SDLK_SPACE:
 				controls.play_animation = !controls.play_animation;
 				break;
+			case SDLK_F12:
+				// capture next frame, to be replayed with `replay-frame`
+				if (!renderer_capture_frame("demo.rcap")) {
+					return 0;
+				}
+				break;
 			}
 		}
 
@@ -546,6 +552,14 @@ load_resources(void)
 		return 0;
 	}
 
+	// identify assets in frame captures
+	if (!renderer_register_asset(model_mesh, "tests/data/zombie.mesh") ||
+	    !renderer_register_asset(model_texture, "tests/data/zombie.jpg") ||
+	    !renderer_register_asset(terrain_mesh, "tests/data/plane.mesh") ||
+	    !renderer_register_asset(terrain_texture, "tests/data/grass.jpg")) {
+		return 0;
+	}
+
 	// model material
 	model_material.texture = model_texture;
 	model_material.receive_light = 1;
@@ -586,6 +600,11 @@ load_image_widget(struct Widget *w)
 	if (!w->image.texture) {
 		return 0;
 	}
+	char id[256];
+	snprintf(id, sizeof(id), "%s:rect", w->image.filename);
+	if (!renderer_register_asset(w->image.texture, id)) {
+		return 0;
+	}
 
 	// initialize the corresponding quad and props objects
 	w->image.quad = malloc(sizeof(struct Quad));
@@ -611,6 +630,11 @@ load_text_widget(struct Widget *w)
 	if (!w->text.font) {
 		return 0;
 	}
+	char id[256];
+	snprintf(id, sizeof(id), "%s:%d", w->text.font_filename, w->text.font_size);
+	if (!renderer_register_asset(w->text.font, id)) {
+		return 0;
+	}
 
 	// create text
 	w->text.text = text_new(w->text.font);
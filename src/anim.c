@@ -1,5 +1,8 @@
 #include "anim.h"
 #include "error.h"
+#include "renderlib.h"
+#include "stats.h"
+#include "trace.h"
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -118,6 +121,19 @@ joint_compute_pose(
 	return t;
 }
 
+/**
+ * Return the bytes allocated for an instance of given animation.
+ */
+static size_t
+instance_size(const struct Animation *anim)
+{
+	size_t n_joints = anim->skeleton->joint_count;
+	return (
+		sizeof(struct AnimationInstance) +
+		n_joints * (2 * sizeof(Mat) + sizeof(bool))
+	);
+}
+
 struct AnimationInstance*
 animation_instance_new(struct Animation *anim)
 {
@@ -135,8 +151,13 @@ animation_instance_new(struct Animation *anim)
 	    inst->skin_transforms == NULL ||
 	    inst->processed_joints == NULL) {
 		err(ERR_NO_MEM);
-		animation_instance_free(inst);
+		free(inst->joint_transforms);
+		free(inst->skin_transforms);
+		free(inst->processed_joints);
+		free(inst);
+		return NULL;
 	}
+	mem_track(RENDER_MEMORY_ANIMATION, MEM_CPU, instance_size(anim));
 
 	inst->anim = anim;
 	inst->time = 0.0f;
@@ -153,6 +174,7 @@ animation_instance_free(struct AnimationInstance *inst)
 		free(inst->joint_transforms);
 		free(inst->skin_transforms);
 		free(inst->processed_joints);
+		mem_track(RENDER_MEMORY_ANIMATION, MEM_CPU, -(ptrdiff_t)instance_size(inst->anim));
 		free(inst);
 	}
 }
@@ -162,6 +184,7 @@ animation_instance_play(struct AnimationInstance *inst, float dt)
 {
 	struct Animation *anim = inst->anim;
 	int n_joints = anim->skeleton->joint_count;
+	TRACE_BEGIN("anim", "animation_instance_play");
 
 	// reset joint processing flags
 	memset(inst->processed_joints, 0, sizeof(bool) * n_joints);
@@ -202,5 +225,6 @@ animation_instance_play(struct AnimationInstance *inst, float dt)
 		}
 	}
 
+	TRACE_END();
 	return 1;
 }
@@ -0,0 +1,147 @@
+#include "arena.h"
+#include "error.h"
+#include <assert.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGNMENT 16
+#define align(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+struct ArenaBlock {
+	struct ArenaBlock *next;  // previously filled block
+	size_t size;              // usable size in bytes
+	size_t offset;            // offset of the first free byte
+};
+
+#define BLOCK_HEADER_SIZE align(sizeof(struct ArenaBlock))
+
+struct Arena {
+	struct ArenaBlock *blocks;  // blocks chain, current block first
+	size_t block_size;          // minimum size of a new block
+	size_t capacity;            // total size of all blocks
+	size_t used;                // bytes allocated since last reset
+	size_t peak;                // high-water mark of `used`
+};
+
+static struct ArenaBlock*
+block_new(size_t size)
+{
+	struct ArenaBlock *block = malloc(BLOCK_HEADER_SIZE + size);
+	if (!block) {
+		err(ERR_NO_MEM);
+		return NULL;
+	}
+	block->next = NULL;
+	block->size = size;
+	block->offset = 0;
+	return block;
+}
+
+static void
+blocks_free(struct ArenaBlock *block)
+{
+	while (block) {
+		struct ArenaBlock *next = block->next;
+		free(block);
+		block = next;
+	}
+}
+
+struct Arena*
+arena_new(size_t block_size)
+{
+	assert(block_size > 0);
+
+	struct Arena *arena = malloc(sizeof(struct Arena));
+	if (!arena) {
+		err(ERR_NO_MEM);
+		return NULL;
+	}
+	arena->blocks = NULL;
+	arena->block_size = align(block_size);
+	arena->capacity = 0;
+	arena->used = 0;
+	arena->peak = 0;
+
+	return arena;
+}
+
+void*
+arena_alloc(struct Arena *arena, size_t size)
+{
+	assert(arena != NULL);
+
+	size = align(size);
+
+	// chain a new block if the current one can't fit the allocation; the
+	// arena at least doubles its capacity each time in order to amortize
+	// the number of blocks in a frame
+	struct ArenaBlock *block = arena->blocks;
+	if (!block || block->offset + size > block->size) {
+		size_t block_size = arena->block_size;
+		if (block_size < arena->capacity) {
+			block_size = arena->capacity;
+		}
+		if (block_size < size) {
+			block_size = size;
+		}
+		if (!(block = block_new(block_size))) {
+			return NULL;
+		}
+		block->next = arena->blocks;
+		arena->blocks = block;
+		arena->capacity += block_size;
+	}
+
+	void *ptr = (char*)block + BLOCK_HEADER_SIZE + block->offset;
+	block->offset += size;
+
+	arena->used += size;
+	if (arena->used > arena->peak) {
+		arena->peak = arena->used;
+	}
+
+	return ptr;
+}
+
+void
+arena_reset(struct Arena *arena)
+{
+	assert(arena != NULL);
+
+	struct ArenaBlock *block = arena->blocks;
+	if (block && block->next) {
+		// the arena overflowed its first block; drop all blocks and
+		// let the next allocation create a single one big enough to
+		// hold them all
+		blocks_free(block);
+		arena->blocks = NULL;
+		arena->block_size = arena->capacity;
+		arena->capacity = 0;
+	} else if (block) {
+		block->offset = 0;
+	}
+	arena->used = 0;
+}
+
+size_t
+arena_used(struct Arena *arena)
+{
+	assert(arena != NULL);
+	return arena->used;
+}
+
+size_t
+arena_peak(struct Arena *arena)
+{
+	assert(arena != NULL);
+	return arena->peak;
+}
+
+void
+arena_free(struct Arena *arena)
+{
+	if (arena) {
+		blocks_free(arena->blocks);
+		free(arena);
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Linear memory arena.
+ *
+ * Allocations are carved sequentially out of a chain of memory blocks and are
+ * released all at once by `arena_reset()`. When an arena outgrows its first
+ * block, the blocks are coalesced into a single one on reset, so that after a
+ * few cycles a steady workload is served by one block.
+ */
+struct Arena;
+
+struct Arena*
+arena_new(size_t block_size);
+
+void*
+arena_alloc(struct Arena *arena, size_t size);
+
+void
+arena_reset(struct Arena *arena);
+
+size_t
+arena_used(struct Arena *arena);
+
+size_t
+arena_peak(struct Arena *arena);
+
+void
+arena_free(struct Arena *arena);
@@ -0,0 +1,843 @@
+#include "file_utils.h"
+#include "render_op.h"
+#include "renderlib.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Frame capture file layout. Values are native-endian, integers are 32 bit
+ * wide, strings are a length followed by as many characters, and references
+ * are indices into the tables preceding them, or -1 for none:
+ *
+ *   header      "RCAP", version
+ *   meshes      count, IDs
+ *   textures    count, IDs
+ *   fonts       count, IDs
+ *   materials   count, {texture, color, receive light, specular intensity,
+ *               specular power}
+ *   animations  count, {mesh, index into mesh animations, time}
+ *   texts       count, {font, string}
+ *   quads       count, {width, height}
+ *   ops         count, {queue, type, model, view, projection, payload}
+ *
+ * Mesh op payload is mesh, level of detail, cast shadows, receive shadows,
+ * animation, material, lit flag, light projection, direction, color, ambient
+ * and diffuse intensities and eye; text op payload is text, color and opacity; quad op
+ * payload is quad, color, texture, left, top, right and bottom borders and
+ * opacity.
+ *
+ * Materials, animation instances, texts and quads are recorded once and
+ * shared by all the operations which referred to them, so that replayed
+ * frames batch and share skinning palettes as the captured one did.
+ */
+#define CAPTURE_MAGIC "RCAP"
+#define CAPTURE_VERSION 2
+
+// defined in renderer.c
+int
+submit_render_op(int queue, const struct RenderOp *op);
+
+struct RenderCapture {
+	void **meshes;
+	size_t mesh_count;
+	void **textures;
+	size_t texture_count;
+	void **fonts;
+	size_t font_count;
+	struct Material *materials;
+	size_t material_count;
+	struct AnimationInstance **animations;
+	size_t animation_count;
+	struct Text **texts;
+	size_t text_count;
+	struct Quad *quads;
+	size_t quad_count;
+	struct RenderOp *ops;
+	int *queues;
+	size_t op_count;
+};
+
+/**
+ * Set of distinct objects, in insertion order.
+ */
+struct PtrSet {
+	const void **items;
+	size_t count;
+	size_t capacity;
+};
+
+struct Writer {
+	FILE *fp;
+	int ok;
+};
+
+struct Reader {
+	const char *data;
+	size_t size;
+	size_t pos;
+	int ok;
+};
+
+// asset IDs registry
+static struct AssetEntry {
+	const void *asset;
+	char *id;
+} *registry = NULL;
+static size_t registry_len = 0;
+static size_t registry_capacity = 0;
+
+static struct AssetEntry*
+registry_find(const void *asset)
+{
+	for (size_t i = 0; i < registry_len; i++) {
+		if (registry[i].asset == asset) {
+			return &registry[i];
+		}
+	}
+	return NULL;
+}
+
+int
+renderer_register_asset(const void *asset, const char *id)
+{
+	assert(asset != NULL);
+	assert(id != NULL);
+
+	char *copy = string_fmt("%s", id);
+	if (!copy) {
+		err(ERR_NO_MEM);
+		return 0;
+	}
+
+	struct AssetEntry *entry = registry_find(asset);
+	if (!entry) {
+		if (registry_len == registry_capacity) {
+			size_t capacity = registry_capacity ? registry_capacity * 2 : 16;
+			struct AssetEntry *grown = realloc(
+				registry,
+				sizeof(struct AssetEntry) * capacity
+			);
+			if (!grown) {
+				free(copy);
+				err(ERR_NO_MEM);
+				return 0;
+			}
+			registry = grown;
+			registry_capacity = capacity;
+		}
+		entry = &registry[registry_len++];
+		entry->asset = asset;
+		entry->id = NULL;
+	}
+	free(entry->id);
+	entry->id = copy;
+	return 1;
+}
+
+void
+renderer_unregister_asset(const void *asset)
+{
+	struct AssetEntry *entry = registry_find(asset);
+	if (entry) {
+		free(entry->id);
+		*entry = registry[--registry_len];
+	}
+}
+
+/**
+ * Drop asset registrations.
+ */
+void
+shutdown_capture(void)
+{
+	for (size_t i = 0; i < registry_len; i++) {
+		free(registry[i].id);
+	}
+	free(registry);
+	registry = NULL;
+	registry_len = registry_capacity = 0;
+}
+
+static int32_t
+ptr_set_index(const struct PtrSet *set, const void *ptr)
+{
+	if (ptr) {
+		for (size_t i = 0; i < set->count; i++) {
+			if (set->items[i] == ptr) {
+				return i;
+			}
+		}
+	}
+	return -1;
+}
+
+static int
+ptr_set_add(struct PtrSet *set, const void *ptr)
+{
+	if (!ptr || ptr_set_index(set, ptr) >= 0) {
+		return 1;
+	}
+	if (set->count == set->capacity) {
+		size_t capacity = set->capacity ? set->capacity * 2 : 16;
+		const void **items = realloc(set->items, sizeof(void*) * capacity);
+		if (!items) {
+			return 0;
+		}
+		set->items = items;
+		set->capacity = capacity;
+	}
+	set->items[set->count++] = ptr;
+	return 1;
+}
+
+static void
+write_data(struct Writer *w, const void *data, size_t size)
+{
+	if (w->ok && fwrite(data, 1, size, w->fp) != size) {
+		w->ok = 0;
+	}
+}
+
+static void
+write_int(struct Writer *w, int32_t value)
+{
+	write_data(w, &value, sizeof(value));
+}
+
+static void
+write_float(struct Writer *w, float value)
+{
+	write_data(w, &value, sizeof(value));
+}
+
+static void
+write_vec(struct Writer *w, const Vec *v)
+{
+	write_data(w, v->data, sizeof(float) * 4);
+}
+
+static void
+write_mat(struct Writer *w, const Mat *m)
+{
+	write_data(w, m->data, sizeof(float) * 16);
+}
+
+static void
+write_string(struct Writer *w, const char *str)
+{
+	size_t len = strlen(str);
+	write_int(w, len);
+	write_data(w, str, len);
+}
+
+static int
+write_asset_ids(struct Writer *w, const struct PtrSet *set, const char *kind)
+{
+	write_int(w, set->count);
+	for (size_t i = 0; i < set->count; i++) {
+		struct AssetEntry *entry = registry_find(set->items[i]);
+		if (!entry) {
+			errf(ERR_INVALID_CAPTURE, "unregistered %s asset", kind);
+			return 0;
+		}
+		write_string(w, entry->id);
+	}
+	return 1;
+}
+
+static void
+write_op(
+	struct Writer *w,
+	int queue,
+	const struct RenderOp *op,
+	const struct PtrSet *meshes,
+	const struct PtrSet *textures,
+	const struct PtrSet *materials,
+	const struct PtrSet *animations,
+	const struct PtrSet *texts,
+	const struct PtrSet *quads
+) {
+	write_int(w, queue);
+	write_int(w, op->type);
+	write_mat(w, &op->transform.model);
+	write_mat(w, &op->transform.view);
+	write_mat(w, &op->transform.projection);
+
+	switch (op->type) {
+	case MESH_OP:
+		write_int(w, ptr_set_index(meshes, op->mesh.mesh));
+		write_int(w, op->mesh.lod);
+		write_int(w, op->mesh.props.cast_shadows);
+		write_int(w, op->mesh.props.receive_shadows);
+		write_int(w, ptr_set_index(animations, op->mesh.props.animation));
+		write_int(w, ptr_set_index(materials, op->mesh.props.material));
+		write_int(w, op->mesh.is_lit);
+		write_mat(w, &op->mesh.light.projection);
+		write_vec(w, &op->mesh.light.direction);
+		write_vec(w, &op->mesh.light.color);
+		write_float(w, op->mesh.light.ambient_intensity);
+		write_float(w, op->mesh.light.diffuse_intensity);
+		write_vec(w, &op->mesh.eye);
+		break;
+	case TEXT_OP:
+		write_int(w, ptr_set_index(texts, op->text.text));
+		write_vec(w, &op->text.props.color);
+		write_float(w, op->text.props.opacity);
+		break;
+	case QUAD_OP:
+		write_int(w, ptr_set_index(quads, op->quad.quad));
+		write_vec(w, &op->quad.props.color);
+		write_int(w, ptr_set_index(textures, op->quad.props.texture));
+		write_float(w, op->quad.props.borders.left);
+		write_float(w, op->quad.props.borders.top);
+		write_float(w, op->quad.props.borders.right);
+		write_float(w, op->quad.props.borders.bottom);
+		write_float(w, op->quad.props.opacity);
+		break;
+	}
+}
+
+/**
+ * Write the operations of render queues to a frame capture file.
+ */
+int
+write_frame_capture(
+	const char *filename,
+	struct RenderOp **queues[QUEUE_COUNT],
+	const size_t lens[QUEUE_COUNT]
+) {
+	assert(filename != NULL);
+
+	int ok = 1;
+	struct PtrSet meshes = { NULL, 0, 0 };
+	struct PtrSet textures = { NULL, 0, 0 };
+	struct PtrSet fonts = { NULL, 0, 0 };
+	struct PtrSet materials = { NULL, 0, 0 };
+	struct PtrSet animations = { NULL, 0, 0 };
+	struct PtrSet texts = { NULL, 0, 0 };
+	struct PtrSet quads = { NULL, 0, 0 };
+	struct Writer w = { NULL, 1 };
+
+	// collect objects referenced by operations
+	size_t op_count = 0;
+	for (int q = 0; q < QUEUE_COUNT; q++) {
+		op_count += lens[q];
+		for (size_t i = 0; ok && i < lens[q]; i++) {
+			struct RenderOp *op = queues[q][i];
+			switch (op->type) {
+			case MESH_OP:
+				ok &= (
+					ptr_set_add(&meshes, op->mesh.mesh) &&
+					ptr_set_add(&animations, op->mesh.props.animation) &&
+					ptr_set_add(&materials, op->mesh.props.material) &&
+					(
+						!op->mesh.props.material ||
+						ptr_set_add(&textures, op->mesh.props.material->texture)
+					)
+				);
+				break;
+			case TEXT_OP:
+				ok &= (
+					ptr_set_add(&texts, op->text.text) &&
+					ptr_set_add(&fonts, op->text.text->font)
+				);
+				break;
+			case QUAD_OP:
+				ok &= (
+					ptr_set_add(&quads, op->quad.quad) &&
+					ptr_set_add(&textures, op->quad.props.texture)
+				);
+				break;
+			}
+		}
+	}
+	if (!ok) {
+		err(ERR_NO_MEM);
+		goto cleanup;
+	}
+
+	if (!(w.fp = fopen(filename, "wb"))) {
+		errf(ERR_IO, "%s", filename);
+		ok = 0;
+		goto cleanup;
+	}
+
+	write_data(&w, CAPTURE_MAGIC, 4);
+	write_int(&w, CAPTURE_VERSION);
+
+	// assets
+	ok &= (
+		write_asset_ids(&w, &meshes, "mesh") &&
+		write_asset_ids(&w, &textures, "texture") &&
+		write_asset_ids(&w, &fonts, "font")
+	);
+	if (!ok) {
+		goto cleanup;
+	}
+
+	// materials
+	write_int(&w, materials.count);
+	for (size_t i = 0; i < materials.count; i++) {
+		const struct Material *material = materials.items[i];
+		write_int(&w, ptr_set_index(&textures, material->texture));
+		write_vec(&w, &material->color);
+		write_int(&w, material->receive_light);
+		write_float(&w, material->specular_intensity);
+		write_float(&w, material->specular_power);
+	}
+
+	// animation instances, referring to animations by their index in the
+	// mesh they belong to
+	write_int(&w, animations.count);
+	for (size_t i = 0; i < animations.count; i++) {
+		const struct AnimationInstance *inst = animations.items[i];
+		int32_t mesh_index = -1, anim_index = -1;
+		for (size_t m = 0; mesh_index < 0 && m < meshes.count; m++) {
+			const struct Mesh *mesh = meshes.items[m];
+			if (inst->anim >= mesh->animations &&
+			    inst->anim < mesh->animations + mesh->anim_count) {
+				mesh_index = m;
+				anim_index = inst->anim - mesh->animations;
+			}
+		}
+		if (mesh_index < 0) {
+			errf(ERR_INVALID_CAPTURE, "animation of unknown mesh");
+			ok = 0;
+			goto cleanup;
+		}
+		write_int(&w, mesh_index);
+		write_int(&w, anim_index);
+		write_float(&w, inst->time);
+	}
+
+	// texts
+	write_int(&w, texts.count);
+	for (size_t i = 0; i < texts.count; i++) {
+		const struct Text *text = texts.items[i];
+		write_int(&w, ptr_set_index(&fonts, text->font));
+		write_string(&w, text->str ? text->str : "");
+	}
+
+	// quads
+	write_int(&w, quads.count);
+	for (size_t i = 0; i < quads.count; i++) {
+		const struct Quad *quad = quads.items[i];
+		write_float(&w, quad->width);
+		write_float(&w, quad->height);
+	}
+
+	// operations
+	write_int(&w, op_count);
+	for (int q = 0; q < QUEUE_COUNT; q++) {
+		for (size_t i = 0; i < lens[q]; i++) {
+			write_op(
+				&w,
+				q,
+				queues[q][i],
+				&meshes,
+				&textures,
+				&materials,
+				&animations,
+				&texts,
+				&quads
+			);
+		}
+	}
+
+	if (!w.ok) {
+		errf(ERR_IO, "%s", filename);
+		ok = 0;
+	}
+
+cleanup:
+	if (w.fp) {
+		ok &= fclose(w.fp) == 0;
+		if (!ok) {
+			remove(filename);
+		}
+	}
+	free(meshes.items);
+	free(textures.items);
+	free(fonts.items);
+	free(materials.items);
+	free(animations.items);
+	free(texts.items);
+	free(quads.items);
+	return ok;
+}
+
+static void
+read_data(struct Reader *r, void *dst, size_t size)
+{
+	if (r->ok && r->size - r->pos >= size) {
+		memcpy(dst, r->data + r->pos, size);
+		r->pos += size;
+	} else {
+		r->ok = 0;
+		memset(dst, 0, size);
+	}
+}
+
+static int32_t
+read_int(struct Reader *r)
+{
+	int32_t value;
+	read_data(r, &value, sizeof(value));
+	return value;
+}
+
+static float
+read_float(struct Reader *r)
+{
+	float value;
+	read_data(r, &value, sizeof(value));
+	return value;
+}
+
+static void
+read_vec(struct Reader *r, Vec *v)
+{
+	read_data(r, v->data, sizeof(float) * 4);
+}
+
+static void
+read_mat(struct Reader *r, Mat *m)
+{
+	read_data(r, m->data, sizeof(float) * 16);
+}
+
+/**
+ * Read a table length, which can't exceed the remaining bytes as each entry
+ * takes at least one.
+ */
+static size_t
+read_count(struct Reader *r)
+{
+	int32_t count = read_int(r);
+	if (count < 0 || (size_t)count > r->size - r->pos) {
+		r->ok = 0;
+		return 0;
+	}
+	return count;
+}
+
+/**
+ * Read a reference to an entry of a table of given length.
+ */
+static int32_t
+read_ref(struct Reader *r, size_t count)
+{
+	int32_t ref = read_int(r);
+	if (ref < -1 || ref >= (int32_t)count) {
+		r->ok = 0;
+		return -1;
+	}
+	return ref;
+}
+
+static char*
+read_string(struct Reader *r)
+{
+	size_t len = read_count(r);
+	if (!r->ok) {
+		return NULL;
+	}
+	char *str = malloc(len + 1);
+	if (!str) {
+		err(ERR_NO_MEM);
+		r->ok = 0;
+		return NULL;
+	}
+	read_data(r, str, len);
+	str[len] = 0;
+	return str;
+}
+
+static int
+load_assets(
+	struct Reader *r,
+	int type,
+	void ***r_assets,
+	size_t *r_count,
+	void *(*load_asset)(int type, const char *id, void *userdata),
+	void *userdata
+) {
+	size_t count = read_count(r);
+	if (!r->ok || !(*r_assets = calloc(count + 1, sizeof(void*)))) {
+		return 0;
+	}
+	*r_count = count;
+
+	for (size_t i = 0; i < count; i++) {
+		char *id = read_string(r);
+		if (!id) {
+			return 0;
+		}
+		(*r_assets)[i] = load_asset(type, id, userdata);
+		if (!(*r_assets)[i]) {
+			errf(ERR_INVALID_CAPTURE, "failed to load asset %s", id);
+			free(id);
+			return 0;
+		}
+		free(id);
+	}
+	return 1;
+}
+
+static int
+read_op(struct Reader *r, struct RenderCapture *capture, int *r_queue, struct RenderOp *op)
+{
+	int32_t ref;
+	memset(op, 0, sizeof(struct RenderOp));
+
+	*r_queue = read_int(r);
+	op->type = read_int(r);
+	read_mat(r, &op->transform.model);
+	read_mat(r, &op->transform.view);
+	read_mat(r, &op->transform.projection);
+	if (*r_queue < 0 || *r_queue >= QUEUE_COUNT) {
+		return 0;
+	}
+
+	switch (op->type) {
+	case MESH_OP:
+		if ((ref = read_ref(r, capture->mesh_count)) < 0) {
+			return 0;
+		}
+		op->mesh.mesh = capture->meshes[ref];
+
+		// replayed meshes may come with fewer levels of detail
+		int32_t lod = read_int(r);
+		op->mesh.lod = lod < 0 ? 0 : lod;
+		if (op->mesh.lod >= op->mesh.mesh->lod_count) {
+			op->mesh.lod = op->mesh.mesh->lod_count - 1;
+		}
+		op->mesh.props.cast_shadows = read_int(r);
+		op->mesh.props.receive_shadows = read_int(r);
+		if ((ref = read_ref(r, capture->animation_count)) >= 0) {
+			op->mesh.props.animation = capture->animations[ref];
+		}
+		if ((ref = read_ref(r, capture->material_count)) >= 0) {
+			op->mesh.props.material = &capture->materials[ref];
+		}
+		op->mesh.is_lit = read_int(r);
+		read_mat(r, &op->mesh.light.projection);
+		read_vec(r, &op->mesh.light.direction);
+		read_vec(r, &op->mesh.light.color);
+		op->mesh.light.ambient_intensity = read_float(r);
+		op->mesh.light.diffuse_intensity = read_float(r);
+		read_vec(r, &op->mesh.eye);
+		break;
+	case TEXT_OP:
+		if ((ref = read_ref(r, capture->text_count)) < 0) {
+			return 0;
+		}
+		op->text.text = capture->texts[ref];
+		read_vec(r, &op->text.props.color);
+		op->text.props.opacity = read_float(r);
+		break;
+	case QUAD_OP:
+		if ((ref = read_ref(r, capture->quad_count)) < 0) {
+			return 0;
+		}
+		op->quad.quad = &capture->quads[ref];
+		read_vec(r, &op->quad.props.color);
+		if ((ref = read_ref(r, capture->texture_count)) >= 0) {
+			op->quad.props.texture = capture->textures[ref];
+		}
+		op->quad.props.borders.left = read_float(r);
+		op->quad.props.borders.top = read_float(r);
+		op->quad.props.borders.right = read_float(r);
+		op->quad.props.borders.bottom = read_float(r);
+		op->quad.props.opacity = read_float(r);
+		break;
+	default:
+		return 0;
+	}
+	return r->ok;
+}
+
+struct RenderCapture*
+render_capture_load(
+	const char *filename,
+	void *(*load_asset)(int type, const char *id, void *userdata),
+	void *userdata
+) {
+	assert(filename != NULL);
+	assert(load_asset != NULL);
+
+	char *data = NULL;
+	size_t size = file_read(filename, &data);
+	if (size == 0) {
+		errf(ERR_INVALID_CAPTURE, "%s", filename);
+		return NULL;
+	}
+	struct Reader r = { data, size, 0, 1 };
+	int32_t ref;
+
+	struct RenderCapture *capture = calloc(1, sizeof(struct RenderCapture));
+	if (!capture) {
+		err(ERR_NO_MEM);
+		goto error;
+	}
+
+	char magic[4];
+	read_data(&r, magic, 4);
+	if (memcmp(magic, CAPTURE_MAGIC, 4) != 0 ||
+	    read_int(&r) != CAPTURE_VERSION) {
+		errf(ERR_INVALID_CAPTURE, "%s: unknown format", filename);
+		goto error;
+	}
+
+	// assets
+	if (!load_assets(&r, RENDER_ASSET_MESH, &capture->meshes, &capture->mesh_count, load_asset, userdata) ||
+	    !load_assets(&r, RENDER_ASSET_TEXTURE, &capture->textures, &capture->texture_count, load_asset, userdata) ||
+	    !load_assets(&r, RENDER_ASSET_FONT, &capture->fonts, &capture->font_count, load_asset, userdata)) {
+		goto invalid;
+	}
+
+	// materials
+	size_t count = read_count(&r);
+	if (!r.ok || !(capture->materials = calloc(count + 1, sizeof(struct Material)))) {
+		goto invalid;
+	}
+	for (size_t i = 0; i < count; i++) {
+		struct Material *material = &capture->materials[i];
+		if ((ref = read_ref(&r, capture->texture_count)) >= 0) {
+			material->texture = capture->textures[ref];
+		}
+		read_vec(&r, &material->color);
+		material->receive_light = read_int(&r);
+		material->specular_intensity = read_float(&r);
+		material->specular_power = read_float(&r);
+	}
+	capture->material_count = count;
+
+	// animation instances, advanced to their captured time
+	count = read_count(&r);
+	if (!r.ok || !(capture->animations = calloc(count + 1, sizeof(struct AnimationInstance*)))) {
+		goto invalid;
+	}
+	for (size_t i = 0; i < count; i++) {
+		ref = read_ref(&r, capture->mesh_count);
+		int32_t anim_index = read_int(&r);
+		float time = read_float(&r);
+		if (!r.ok || ref < 0) {
+			goto invalid;
+		}
+		struct Mesh *mesh = capture->meshes[ref];
+		if (anim_index < 0 || (size_t)anim_index >= mesh->anim_count) {
+			goto invalid;
+		}
+		struct AnimationInstance *inst = animation_instance_new(&mesh->animations[anim_index]);
+		if (!inst) {
+			goto error;
+		}
+		capture->animations[capture->animation_count++] = inst;
+		if (!animation_instance_play(inst, time)) {
+			goto error;
+		}
+	}
+
+	// texts
+	count = read_count(&r);
+	if (!r.ok || !(capture->texts = calloc(count + 1, sizeof(struct Text*)))) {
+		goto invalid;
+	}
+	for (size_t i = 0; i < count; i++) {
+		ref = read_ref(&r, capture->font_count);
+		char *str = read_string(&r);
+		if (!str || ref < 0) {
+			free(str);
+			goto invalid;
+		}
+		struct Text *text = text_new(capture->fonts[ref]);
+		if (text) {
+			capture->texts[capture->text_count++] = text;
+		}
+		int ok = text && (!*str || text_set_string(text, str));
+		free(str);
+		if (!ok) {
+			goto error;
+		}
+	}
+
+	// quads
+	count = read_count(&r);
+	if (!r.ok || !(capture->quads = calloc(count + 1, sizeof(struct Quad)))) {
+		goto invalid;
+	}
+	for (size_t i = 0; i < count; i++) {
+		capture->quads[i].width = read_float(&r);
+		capture->quads[i].height = read_float(&r);
+	}
+	capture->quad_count = count;
+
+	// operations
+	count = read_count(&r);
+	if (!r.ok ||
+	    !(capture->ops = calloc(count + 1, sizeof(struct RenderOp))) ||
+	    !(capture->queues = calloc(count + 1, sizeof(int)))) {
+		goto invalid;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (!read_op(&r, capture, &capture->queues[i], &capture->ops[i])) {
+			goto invalid;
+		}
+	}
+	capture->op_count = count;
+
+	if (!r.ok) {
+		goto invalid;
+	}
+
+	free(data);
+	return capture;
+
+invalid:
+	errf(ERR_INVALID_CAPTURE, "%s", filename);
+error:
+	render_capture_free(capture);
+	free(data);
+	return NULL;
+}
+
+int
+render_capture_submit(struct RenderCapture *capture)
+{
+	assert(capture != NULL);
+
+	for (size_t i = 0; i < capture->op_count; i++) {
+		if (!submit_render_op(capture->queues[i], &capture->ops[i])) {
+			errf(ERR_RENDER, "failed to submit captured operation");
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void
+render_capture_free(struct RenderCapture *capture)
+{
+	if (capture) {
+		for (size_t i = 0; i < capture->animation_count; i++) {
+			animation_instance_free(capture->animations[i]);
+		}
+		for (size_t i = 0; i < capture->text_count; i++) {
+			text_free(capture->texts[i]);
+		}
+		free(capture->meshes);
+		free(capture->textures);
+		free(capture->fonts);
+		free(capture->materials);
+		free(capture->animations);
+		free(capture->texts);
+		free(capture->quads);
+		free(capture->ops);
+		free(capture->queues);
+		free(capture);
+	}
+}
@@ -1,126 +1,494 @@
 #include "anim.h"
 #include "error.h"
+#include "gl_api.h"
+#include "gl_state.h"
+#include "renderlib.h"
 #include "shader.h"
-#include <GL/glew.h>
+#include "stats.h"
+#include "stream_buffer.h"
+#include <string.h>
+
+// uniform buffer binding point of the skin transforms block
+#define ANIMATION_BLOCK_BINDING 1
+
+// uniform buffer binding point of the per-frame constants block
+#define FRAME_BLOCK_BINDING 3
+
+// first of the four vertex attribute locations of per-instance model
+// transform; must match `in_model` location in mesh and shadow shaders
+#define VERTEX_ATTRIB_INSTANCE_TRANSFORM 5
+
+// size of a segment of the buffer instance transforms are streamed into
+#define INSTANCE_BUFFER_SIZE (4096 * sizeof(Mat))
+
+// size of a segment of the buffer per-draw constants are streamed into
+#define CONSTANTS_BUFFER_SIZE 262144
+
+/**
+ * Per-frame constants, mirrors the std140 `Frame` block shared by all
+ * shaders.
+ *
+ * Vectors which are declared as `vec3` in the block are packed together with
+ * the following scalar, and matrices are stored in column-major order.
+ */
+struct FrameConstants {
+	Mat view;
+	Mat projection;
+	Mat light_space_transform;
+	float eye[3];
+	float light_ambient_intensity;
+	float light_direction[3];
+	float light_diffuse_intensity;
+	float light_color[3];
+	float padding;
+};
+
+static struct StreamBuffer *instance_buffer = NULL;
+static struct StreamBuffer *constants_buffer = NULL;
+static size_t constants_alignment = 0;
+
+// last streamed frame constants and the generation of constants buffer they
+// were streamed in
+static struct FrameConstants frame;
+static int frame_valid = 0;
+static size_t frame_generation = 0;
+
+static int
+stream_frame(const struct FrameConstants *f);
+
+// skinning palettes buffer and layout of a single palette in it
+static GLuint palette_buffer = 0;
+static size_t palette_buffer_size = 0;
+static size_t palette_size = 0;
+static size_t palette_stride = 0;
+static size_t palette_skin_transforms_offset = 0;
+static size_t palette_skin_transforms_size = 0;
 
 /**
- * Updates uniform buffer with skinning transform data for given animation
- * instance.
+ * Initializes resources shared by pipelines: the buffers instance transforms
+ * and per-draw constants are streamed into and the skinning palettes buffer.
  *
- *   inst    Animation instance to retrieve the skin transforms from.
- *   buffer  The name of uniform buffer to be updated.
- *   offset  Skin transforms array offset in the buffer.
- *   size    Skin transforms array size in bytes.
+ * Released by `shutdown_draw_common()`.
  */
 int
-update_skin_transforms_buffer(
-	struct AnimationInstance *inst,
-	GLuint buffer,
-	size_t offset,
-	size_t size
-) {
-	// check whether there's enough room for all joint transforms
-	if (size < inst->anim->skeleton->joint_count * sizeof(Mat)) {
-		errf(
-			ERR_NO_MEM,
-			"buffer too small for animation skin transforms"
+init_draw_common(void)
+{
+	if (!(instance_buffer = stream_buffer_new(GL_ARRAY_BUFFER, INSTANCE_BUFFER_SIZE))) {
+		errf(ERR_GENERIC, "instance buffer creation failed");
+		return 0;
+	}
+
+	GLint alignment = 1;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	constants_alignment = alignment;
+	if (!(constants_buffer = stream_buffer_new(GL_UNIFORM_BUFFER, CONSTANTS_BUFFER_SIZE))) {
+		errf(ERR_GENERIC, "constants buffer creation failed");
+		return 0;
+	}
+
+	// palettes buffer storage is allocated on first use, when the size
+	// of the animation uniform block is known
+	glGenBuffers(1, &palette_buffer);
+	if (!palette_buffer) {
+		err(ERR_OPENGL);
+		return 0;
+	}
+	palette_buffer_size = 0;
+	palette_size = 0;
+	frame_valid = 0;
+
+	return 1;
+}
+
+/**
+ * Releases the resources of `init_draw_common()`, including their memory
+ * accounting.
+ */
+void
+shutdown_draw_common(void)
+{
+	stream_buffer_free(instance_buffer);
+	instance_buffer = NULL;
+	stream_buffer_free(constants_buffer);
+	constants_buffer = NULL;
+
+	// OpenGL entry points are not loaded if initialization failed early
+	if (palette_buffer) {
+		glDeleteBuffers(1, &palette_buffer);
+		palette_buffer = 0;
+	}
+	mem_track(RENDER_MEMORY_UNIFORM, MEM_GPU, -(ptrdiff_t)palette_buffer_size);
+	palette_buffer_size = 0;
+	frame_valid = 0;
+}
+
+/**
+ * Streams instance model transforms and points the per-instance transform
+ * attribute of currently bound vertex array at them.
+ *
+ *   transforms  Model transforms, one per instance.
+ *   count       Number of instances.
+ *
+ * Returns the number of instances actually configured, which can be less than
+ * requested if they don't fit in the instance buffer; the caller is expected
+ * to issue the draw and configure the remaining ones. Returns 0 on error.
+ */
+size_t
+configure_instancing(const Mat *transforms, size_t count)
+{
+	size_t max_count = INSTANCE_BUFFER_SIZE / sizeof(Mat);
+	if (count > max_count) {
+		count = max_count;
+	}
+
+	// copy transforms to instance buffer in column-major order
+	size_t offset;
+	Mat *dst = stream_buffer_map(
+		instance_buffer,
+		sizeof(Mat) * count,
+		sizeof(Mat),
+		&offset
+	);
+	if (!dst) {
+		return 0;
+	}
+	for (size_t i = 0; i < count; i++) {
+		mat_transpose(&transforms[i], &dst[i]);
+	}
+	if (!stream_buffer_unmap(instance_buffer)) {
+		return 0;
+	}
+
+	// a 4x4 matrix attribute is made up of four column vectors, each of
+	// which occupies its own location and advances once per instance
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buffer->buffer);
+	for (int col = 0; col < 4; col++) {
+		GLuint loc = VERTEX_ATTRIB_INSTANCE_TRANSFORM + col;
+		glEnableVertexAttribArray(loc);
+		glVertexAttribPointer(
+			loc,
+			4,
+			GL_FLOAT,
+			GL_FALSE,
+			sizeof(Mat),
+			(void*)(offset + col * sizeof(float) * 4)
 		);
+		glVertexAttribDivisor(loc, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+#ifdef DEBUG
+	if (glGetError() != GL_NO_ERROR) {
+		err(ERR_OPENGL);
 		return 0;
 	}
+#endif
+	return count;
+}
 
-	// bind the buffer to uniform target and map its memory to client
-	// address space
-	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-	struct Animation *anim = inst->anim;
-	Mat *dst = glMapBufferRange(
-		GL_UNIFORM_BUFFER,
-		offset,
+/**
+ * Streams a block of per-draw constants and binds it to given uniform buffer
+ * binding point.
+ *
+ *   binding  Uniform buffer binding point.
+ *   data     Block data, laid out as the std140 block in the shader.
+ *   size     Size of the block in bytes.
+ *
+ * The data can't be modified once streamed, thus the block must be
+ * configured again for each draw call which needs different values.
+ */
+int
+configure_constants(GLuint binding, const void *data, size_t size)
+{
+	size_t generation = constants_buffer->generation;
+	size_t offset;
+	void *dst = stream_buffer_map(
+		constants_buffer,
 		size,
-		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+		constants_alignment,
+		&offset
 	);
-	if (!dst || glGetError() != GL_NO_ERROR) {
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
-		err(ERR_OPENGL);
+	if (!dst) {
+		return 0;
+	}
+	memcpy(dst, data, size);
+	if (!stream_buffer_unmap(constants_buffer)) {
 		return 0;
 	}
 
-	// compute final skinning transforms and store them in the buffer
-	Mat tmp;
-	for (int j = 0; j < anim->skeleton->joint_count; j++) {
-		mat_mul(
-			&inst->joint_transforms[j],
-			&anim->skeleton->joints[j].inv_bind_pose,
-			&tmp
-		);
-		mat_transpose(&tmp, &dst[j]);
+	gl_state_bind_uniform_buffer_range(
+		binding,
+		constants_buffer->buffer,
+		offset,
+		size
+	);
+
+	// the segment switch fenced the frame block before the coming draw
+	// reads it, thus the block moves along to the new segment
+	if (generation != constants_buffer->generation &&
+	    binding != FRAME_BLOCK_BINDING &&
+	    frame_valid) {
+		return stream_frame(&frame);
 	}
+	return 1;
+}
 
-	// unmap the buffer
-	glUnmapBuffer(GL_UNIFORM_BUFFER);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+/**
+ * Binds the frame uniform block of given shader to the frame constants
+ * binding point.
+ *
+ *   shader    Shader program which declares the block.
+ *   ub_frame  Frame uniform block.
+ */
+int
+init_frame(struct Shader *shader, struct ShaderUniformBlock *ub_frame)
+{
+	if (ub_frame->size > sizeof(struct FrameConstants)) {
+		errf(ERR_GENERIC, "frame block layout mismatch");
+		return 0;
+	}
+	glUniformBlockBinding(shader->prog, ub_frame->index, FRAME_BLOCK_BINDING);
+	if (glGetError() != GL_NO_ERROR) {
+		err(ERR_OPENGL);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Marks the frame constants as stale, forcing the next call to
+ * `configure_frame()` to stream them.
+ */
+void
+invalidate_frame(void)
+{
+	frame_valid = 0;
+}
+
+static void
+copy_vec3(float dst[3], const Vec *src)
+{
+	dst[0] = src->data[0];
+	dst[1] = src->data[1];
+	dst[2] = src->data[2];
+}
 
+static int
+stream_frame(const struct FrameConstants *f)
+{
+	if (!configure_constants(FRAME_BLOCK_BINDING, f, sizeof(*f))) {
+		frame_valid = 0;
+		return 0;
+	}
+	frame = *f;
+	frame_valid = 1;
+	frame_generation = constants_buffer->generation;
 	return 1;
 }
 
 /**
- * Configures skinning-related uniforms.
+ * Configures per-frame constants.
  *
- *   inst               Animation instance.
- *   shader             Shader program to set the uniforms for.
- *   u_enable_skinning  Skinning toggle flag uniform.
- *   u_skin_transforms  Skin transforms uniform.
- *   ub_aimation        Animation uniform block.
- *   buffer             Uniform buffer which will hold skinning data.
+ *   view        View transform.
+ *   projection  Projection transform.
+ *   light       Light or NULL to keep current light constants.
+ *   eye         Eye position or NULL to keep current one.
+ *
+ * Constants are streamed only when they differ from the last streamed ones, so
+ * that consecutive draws which share camera and light setup, typically a
+ * whole pass, refer to the same block.
  */
 int
-configure_skinning(
-	struct AnimationInstance *inst,
-	struct Shader *shader,
-	struct ShaderUniform *u_enable_skinning,
-	struct ShaderUniform *u_skin_transforms,
-	struct ShaderUniformBlock *ub_animation,
-	GLuint buffer
+configure_frame(
+	const Mat *view,
+	const Mat *projection,
+	const struct Light *light,
+	const Vec *eye
 ) {
-	int enable_skinning = inst != NULL;
+	struct FrameConstants f = frame;
+	if (!frame_valid) {
+		memset(&f, 0, sizeof(f));
+	}
+	mat_transpose(view, &f.view);
+	mat_transpose(projection, &f.projection);
+	if (light) {
+		mat_transpose(&light->projection, &f.light_space_transform);
+		copy_vec3(f.light_direction, &light->direction);
+		copy_vec3(f.light_color, &light->color);
+		f.light_ambient_intensity = light->ambient_intensity;
+		f.light_diffuse_intensity = light->diffuse_intensity;
+	}
+	if (eye) {
+		copy_vec3(f.eye, eye);
+	}
 
-	// configure uniforms
-	int configured = shader_uniform_set(
-		u_enable_skinning,
-		1,
-		&enable_skinning
-	);
-	if (!enable_skinning) {
-		return configured;
+	// the block is still bound, unless the constants buffer has moved to
+	// another segment, which will eventually be recycled
+	if (frame_valid &&
+	    frame_generation == constants_buffer->generation &&
+	    memcmp(&f, &frame, sizeof(f)) == 0) {
+		return 1;
 	}
 
-	// update the skin transforms buffer
-	int ok = update_skin_transforms_buffer(
-		inst,
-		buffer,
-		u_skin_transforms->offset,
-		u_skin_transforms->size
+	return stream_frame(&f);
+}
+
+/**
+ * Binds the animation uniform block of given shader to the skin transforms
+ * buffer binding point and records the block layout.
+ *
+ *   shader             Shader program which declares the block.
+ *   ub_animation       Animation uniform block.
+ *   u_skin_transforms  Skin transforms uniform within the block.
+ *
+ * All pipelines declare the same block with shared layout, thus palettes
+ * written once can be bound to any of them.
+ */
+int
+init_skinning(
+	struct Shader *shader,
+	struct ShaderUniformBlock *ub_animation,
+	struct ShaderUniform *u_skin_transforms
+) {
+	glUniformBlockBinding(
+		shader->prog,
+		ub_animation->index,
+		ANIMATION_BLOCK_BINDING
 	);
-	if (!ok) {
+	if (glGetError() != GL_NO_ERROR) {
+		err(ERR_OPENGL);
 		return 0;
 	}
 
-	// perform indexed buffer binding
-	GLuint binding_index = 1;
-	glBindBufferBase(
+	// compute the stride between palettes in the buffer, which must be a
+	// multiple of uniform buffer offset alignment
+	GLint alignment = 1;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (ub_animation->size > palette_size) {
+		palette_size = ub_animation->size;
+	}
+	palette_stride = (palette_size + alignment - 1) / alignment * alignment;
+	palette_skin_transforms_offset = u_skin_transforms->offset;
+	palette_skin_transforms_size = u_skin_transforms->size;
+
+	return 1;
+}
+
+/**
+ * Computes skinning palettes of given animation instances and uploads them to
+ * the palette buffer, the i-th at offset `i * palette_stride`.
+ *
+ *   instances  Animation instances.
+ *   count      Number of instances.
+ *
+ * This is meant to be called once per frame, before any draw call which
+ * refers to the palettes is issued.
+ */
+int
+update_skinning_palettes(struct AnimationInstance **instances, size_t count)
+{
+	if (count == 0) {
+		return 1;
+	}
+
+	// grow the buffer if all palettes don't fit in
+	size_t size = count * palette_stride;
+	glBindBuffer(GL_UNIFORM_BUFFER, palette_buffer);
+	if (size > palette_buffer_size) {
+		if (size < palette_buffer_size * 2) {
+			size = palette_buffer_size * 2;
+		}
+		glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_STREAM_DRAW);
+		mem_track(RENDER_MEMORY_UNIFORM, MEM_GPU, size - palette_buffer_size);
+		palette_buffer_size = size;
+	}
+
+	// map the whole buffer invalidating its previous contents; this
+	// happens once per frame, before any draw call reads from it, thus the
+	// driver can hand out fresh storage instead of stalling
+	char *dst = glMapBufferRange(
 		GL_UNIFORM_BUFFER,
-		binding_index,
-		buffer
+		0,
+		count * palette_stride,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
 	);
-	glUniformBlockBinding(
-		shader->prog,
-		ub_animation->index,
-		binding_index
+	if (!dst) {
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		err(ERR_OPENGL);
+		return 0;
+	}
+
+	stats_add(bytes_uploaded, count * palette_stride);
+
+	int ok = 1;
+	for (size_t i = 0; i < count; i++) {
+		struct AnimationInstance *inst = instances[i];
+		struct Skeleton *skeleton = inst->anim->skeleton;
+
+		// check whether there's enough room for all joint transforms
+		if (palette_skin_transforms_size < skeleton->joint_count * sizeof(Mat)) {
+			errf(
+				ERR_NO_MEM,
+				"buffer too small for animation skin transforms"
+			);
+			ok = 0;
+			break;
+		}
+
+		// compute final skinning transforms and store them in the
+		// buffer
+		Mat tmp, *palette = (Mat*)(
+			dst +
+			i * palette_stride +
+			palette_skin_transforms_offset
+		);
+		for (int j = 0; j < skeleton->joint_count; j++) {
+			mat_mul(
+				&inst->joint_transforms[j],
+				&skeleton->joints[j].inv_bind_pose,
+				&tmp
+			);
+			mat_transpose(&tmp, &palette[j]);
+		}
+	}
+
+	// unmap the buffer
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	return ok;
+}
+
+/**
+ * Binds the skinning palette of an animation instance, if any.
+ *
+ *   inst     Animation instance or NULL.
+ *   palette  Index of instance palette, as uploaded by
+ *            `update_skinning_palettes()`.
+ *
+ * Skinning itself is toggled by the per-draw constants of each pipeline.
+ */
+int
+configure_skinning(struct AnimationInstance *inst, size_t palette)
+{
+	if (!inst) {
+		return 1;
+	}
+
+	// bind the instance palette range; the block itself is bound to the
+	// binding point once by `init_skinning()`
+	gl_state_bind_uniform_buffer_range(
+		ANIMATION_BLOCK_BINDING,
+		palette_buffer,
+		palette * palette_stride,
+		palette_size
 	);
 
+#ifdef DEBUG
 	if (glGetError() != GL_NO_ERROR) {
 		err(ERR_OPENGL);
 		return 0;
 	}
-
+#endif
 	return 1;
 }
@@ -1,5 +1,9 @@
+#include "gl_api.h"
+#include "gl_state.h"
 #include "renderlib.h"
+#include "stats.h"
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 static const char *vertex_shader = (
@@ -12,47 +16,59 @@ static const char *fragment_shader = (
 
 // defined in draw_common.c
 int
-update_skin_transforms_buffer(
-	struct AnimationInstance *inst,
-	GLuint buffer,
-	size_t offset,
-	size_t size
-);
-
-int
-configure_skinning(
-	struct AnimationInstance *inst,
+init_skinning(
 	struct Shader *shader,
-	struct ShaderUniform *u_enable_skinning,
-	struct ShaderUniform *u_skin_transforms,
 	struct ShaderUniformBlock *ub_animation,
-	GLuint buffer
+	struct ShaderUniform *u_skin_transforms
 );
 
+int
+configure_skinning(struct AnimationInstance *inst, size_t palette);
+
+size_t
+configure_instancing(const Mat *transforms, size_t count);
+
+int
+configure_constants(GLuint binding, const void *data, size_t size);
+
+int
+init_frame(struct Shader *shader, struct ShaderUniformBlock *ub_frame);
+
+// uniform buffer binding point of the per-draw constants block
+#define DRAW_BLOCK_BINDING 2
+
+// texture unit of the texture map
+#define TEXTURE_MAP_UNIT 0
+
+/**
+ * Per-draw constants, mirrors the std140 `Draw` block of mesh shaders.
+ *
+ * Camera and light data are per-frame constants, see `configure_frame()`.
+ * Vectors declared as `vec3` are packed together with the following scalar.
+ */
+struct DrawConstants {
+	float material_color[4];
+	float position_scale[3];
+	int32_t packed_normals;
+	float position_offset[3];
+	float material_specular_intensity;
+	float material_specular_power;
+	int32_t enable_lighting;
+	int32_t enable_texture_mapping;
+	int32_t enable_shadow_mapping;
+	int32_t enable_skinning;
+	float padding[3];
+};
+
 static struct Shader *shader = NULL;
 static struct ShaderSource *shader_sources[2] = { NULL, NULL };
-static struct ShaderUniform u_model;
-static struct ShaderUniform u_view;
-static struct ShaderUniform u_projection;
-static struct ShaderUniform u_enable_skinning;
 static struct ShaderUniformBlock ub_animation;
 static struct ShaderUniform u_skin_transforms;
-static struct ShaderUniform u_enable_texture_mapping;
+static struct ShaderUniformBlock ub_draw;
+static struct ShaderUniformBlock ub_frame;
 static struct ShaderUniform u_texture_map_sampler;
-static struct ShaderUniform u_enable_shadow_mapping;
 static struct ShaderUniform u_shadow_map_sampler;
-static struct ShaderUniform u_light_space_transform;
-static struct ShaderUniform u_enable_lighting;
-static struct ShaderUniform u_eye;
-static struct ShaderUniform u_light_direction;
-static struct ShaderUniform u_light_color;
-static struct ShaderUniform u_light_ambient_intensity;
-static struct ShaderUniform u_light_diffuse_intensity;
-static struct ShaderUniform u_material_color;
-static struct ShaderUniform u_material_specular_intensity;
-static struct ShaderUniform u_material_specular_power;
-
-static GLuint skin_transforms_buffer = 0;
+static GLint shadow_map_unit = -1;
 
 static void
 cleanup(void)
@@ -60,65 +76,41 @@ cleanup(void)
 	shader_free(shader);
 	shader_source_free(shader_sources[0]);
 	shader_source_free(shader_sources[1]);
-	glDeleteBuffers(1, &skin_transforms_buffer);
 }
 
+/**
+ * Initializes the mesh pipeline.
+ *
+ *   shadow_unit  Texture unit the shadow map is bound to.
+ */
 int
-init_mesh_pipeline(void)
+init_mesh_pipeline(GLint shadow_unit)
 {
 	// cleanup resources at program exit
 	atexit(cleanup);
 
 	// uniform names and receiver pointers
 	const char *uniform_names[] = {
-		"model",
-		"view",
-		"projection",
-		"enable_skinning",
-		"enable_texture_mapping",
 		"texture_map_sampler",
-		"enable_shadow_mapping",
 		"shadow_map_sampler",
-		"light_space_transform",
-		"enable_lighting",
-		"eye",
-		"light.direction",
-		"light.color",
-		"light.ambient_intensity",
-		"light.diffuse_intensity",
-		"material.color",
-		"material.specular_intensity",
-		"material.specular_power",
 		NULL
 	};
 	struct ShaderUniform *uniforms[] = {
-		&u_model,
-		&u_view,
-		&u_projection,
-		&u_enable_skinning,
-		&u_enable_texture_mapping,
 		&u_texture_map_sampler,
-		&u_enable_shadow_mapping,
-		&u_shadow_map_sampler,
-		&u_light_space_transform,
-		&u_enable_lighting,
-		&u_eye,
-		&u_light_direction,
-		&u_light_color,
-		&u_light_ambient_intensity,
-		&u_light_diffuse_intensity,
-		&u_material_color,
-		&u_material_specular_intensity,
-		&u_material_specular_power
+		&u_shadow_map_sampler
 	};
 
 	// uniform block names and receiver pointers
 	const char *uniform_block_names[] = {
 		"Animation",
+		"Draw",
+		"Frame",
 		NULL
 	};
 	struct ShaderUniformBlock *uniform_blocks[] = {
-		&ub_animation
+		&ub_animation,
+		&ub_draw,
+		&ub_frame
 	};
 
 	// compile mesh pipeline shader and initialize uniforms
@@ -139,6 +131,9 @@ init_mesh_pipeline(void)
 	           !shader_get_uniform_blocks(shader, uniform_block_names, uniform_blocks)) {
 		errf(ERR_GENERIC, "bad mesh pipeline shader");
 		return 0;
+	} else if (ub_draw.size > sizeof(struct DrawConstants)) {
+		errf(ERR_GENERIC, "mesh pipeline draw block layout mismatch");
+		return 0;
 	}
 
 	// lookup skin transforms array uniform within the uniform block
@@ -150,23 +145,21 @@ init_mesh_pipeline(void)
 		return 0;
 	}
 	u_skin_transforms = *u;
-
-	// allocate an OpenGL buffer for animation uniform block
-	glGenBuffers(1, &skin_transforms_buffer);
-	if (!skin_transforms_buffer) {
-		err(ERR_OPENGL);
+	if (!init_skinning(shader, &ub_animation, &u_skin_transforms) ||
+	    !init_frame(shader, &ub_frame)) {
 		return 0;
 	}
 
-	// initialize buffer storage
-	glBindBuffer(GL_UNIFORM_BUFFER, skin_transforms_buffer);
-	glBufferData(
-		GL_UNIFORM_BUFFER,
-		ub_animation.size,
-		NULL,
-		GL_DYNAMIC_DRAW
-	);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	// bind the draw block to its binding point and the samplers to their
+	// units once and for all
+	glUniformBlockBinding(shader->prog, ub_draw.index, DRAW_BLOCK_BINDING);
+	GLint tex_unit = TEXTURE_MAP_UNIT;
+	shadow_map_unit = shadow_unit;
+	if (!shader_bind(shader) ||
+	    !shader_uniform_set(&u_texture_map_sampler, 1, &tex_unit) ||
+	    !shader_uniform_set(&u_shadow_map_sampler, 1, &shadow_map_unit)) {
+		return 0;
+	}
 
 	// check for any OpenGL-related errors
 	if (glGetError() != GL_NO_ERROR) {
@@ -178,179 +171,159 @@ init_mesh_pipeline(void)
 }
 
 static int
-configure_texture_mapping(struct MeshProps *props)
+configure_texture_mapping(struct MeshProps *props, struct DrawConstants *c)
 {
-	int enable_texture_mapping = props->material && props->material->texture;
-	int ok = shader_uniform_set(
-		&u_enable_texture_mapping,
-		1,
-		&enable_texture_mapping
+	c->enable_texture_mapping = (
+		props->material &&
+		props->material->texture
 	);
-	if (enable_texture_mapping) {
+	if (c->enable_texture_mapping) {
 		struct Texture *texture = props->material->texture;
-		GLint tex_unit = 0;
-		ok &= shader_uniform_set(
-			&u_texture_map_sampler,
-			1,
-			&tex_unit
+		gl_state_bind_texture(
+			TEXTURE_MAP_UNIT,
+			texture->type,
+			texture->id
 		);
-		glActiveTexture(GL_TEXTURE0 + tex_unit);
-		glBindTexture(texture->type, texture->id);
+#ifdef DEBUG
 		if (glGetError() != GL_NO_ERROR) {
 			err(ERR_OPENGL);
 			return 0;
 		}
+#endif
 	}
-	return ok;
+	return 1;
 }
 
-static int
-configure_lighting(struct MeshProps *props, struct Light *light, Vec *eye)
-{
-	int enable_lighting = (
+static void
+configure_lighting(
+	struct MeshProps *props,
+	struct Light *light,
+	Vec *eye,
+	struct DrawConstants *c
+) {
+	c->enable_lighting = (
 		light &&
 		eye &&
 		props->material &&
 		props->material->receive_light
 	);
-	int configured = shader_uniform_set(
-		&u_enable_lighting,
-		1,
-		&enable_lighting
-	);
-
-	if (enable_lighting) {
-		configured &= (
-			shader_uniform_set(
-				&u_eye,
-				1,
-				eye
-			) &&
-			shader_uniform_set(
-				&u_material_specular_intensity,
-				1,
-				&props->material->specular_intensity
-			) &&
-			shader_uniform_set(
-				&u_material_specular_power,
-				1,
-				&props->material->specular_power
-			) &&
-			shader_uniform_set(
-				&u_light_direction,
-				1,
-				&light->direction
-			) &&
-			shader_uniform_set(
-				&u_light_color,
-				1,
-				&light->color
-			) &&
-			shader_uniform_set(
-				&u_light_ambient_intensity,
-				1,
-				&light->ambient_intensity
-			) &&
-			shader_uniform_set(
-				&u_light_diffuse_intensity,
-				1,
-				&light->diffuse_intensity
-			)
-		);
+	if (c->enable_lighting) {
+		c->material_specular_intensity = props->material->specular_intensity;
+		c->material_specular_power = props->material->specular_power;
 	}
-
-	return configured;
 }
 
-static int
+static void
 configure_shadow_mapping(
 	struct MeshProps *props,
 	struct Light *light,
-	int shadow_map
+	struct DrawConstants *c
 ) {
-	int enable_shadow_mapping = (
+	c->enable_shadow_mapping = (
 		props->receive_shadows &&
 		light &&
-		shadow_map > 0
+		shadow_map_unit > 0
 	);
-	int configured = shader_uniform_set(
-		&u_enable_shadow_mapping,
-		1,
-		&enable_shadow_mapping
-	);
-	if (enable_shadow_mapping) {
-		configured &= shader_uniform_set(
-			&u_shadow_map_sampler,
-			1,
-			&shadow_map
-		);
-		configured &= shader_uniform_set(
-			&u_light_space_transform,
-			1,
-			&light->projection
-		);
-	}
-	return configured;
 }
 
-static int
-configure_shading(struct MeshProps *props)
+static void
+configure_shading(struct MeshProps *props, struct DrawConstants *c)
 {
 	Vec color = (
 		props->material
 		? props->material->color
 		: vec(0.7, 0.7, 0.7, 1)
 	);
-	return shader_uniform_set(
-		&u_material_color,
-		1,
-		&color
-	);
+	for (int i = 0; i < 4; i++) {
+		c->material_color[i] = color.data[i];
+	}
 }
 
+static void
+configure_vertex_format(struct Mesh *mesh, struct DrawConstants *c)
+{
+	for (int i = 0; i < 3; i++) {
+		c->position_scale[i] = mesh->position_scale.data[i];
+		c->position_offset[i] = mesh->position_offset.data[i];
+	}
+	c->packed_normals = mesh->packed;
+}
+
+/**
+ * Draws instances of a mesh which share the same properties.
+ *
+ *   mesh        Mesh to draw.
+ *   props       Mesh render properties.
+ *   palette     Skinning palette index of animated meshes.
+ *   lod         Level of detail to draw.
+ *   models      Model transforms, one per instance.
+ *   count       Number of instances.
+ *   light       Light or NULL for unlit rendering.
+ *   eye         Eye position or NULL for unlit rendering.
+ *
+ * The shadow map must be bound to the unit given to `init_mesh_pipeline()`.
+ * Camera and light constants must have been configured with
+ * `configure_frame()`.
+ */
 int
 draw_mesh(
 	struct Mesh *mesh,
 	struct MeshProps *props,
-	struct Transform *transform,
+	size_t palette,
+	size_t lod,
+	const Mat *models,
+	size_t count,
 	struct Light *light,
-	Vec *eye,
-	int shadow_map
+	Vec *eye
 ) {
 	assert(mesh != NULL);
 	assert(props != NULL);
-	assert(transform != NULL);
+	assert(lod < mesh->lod_count);
+	assert(models != NULL && count > 0);
+
+	// gather per-draw constants and stream them in one go
+	struct DrawConstants constants = { .enable_lighting = 0 };
+	configure_shading(props, &constants);
+	configure_lighting(props, light, eye, &constants);
+	configure_shadow_mapping(props, light, &constants);
+	configure_vertex_format(mesh, &constants);
+	constants.enable_skinning = props->animation != NULL;
 
 	int configured = (
 		shader_bind(shader) &&
-		shader_uniform_set(&u_model, 1, &transform->model) &&
-		shader_uniform_set(&u_view, 1, &transform->view) &&
-		shader_uniform_set(&u_projection, 1, &transform->projection) &&
-		configure_skinning(
-			props->animation,
-			shader,
-			&u_enable_skinning,
-			&u_skin_transforms,
-			&ub_animation,
-			skin_transforms_buffer
-		) &&
-		configure_shading(props) &&
-		configure_texture_mapping(props) &&
-		configure_shadow_mapping(props, light, shadow_map) &&
-		configure_lighting(props, light, eye)
+		configure_skinning(props->animation, palette) &&
+		configure_texture_mapping(props, &constants) &&
+		configure_constants(
+			DRAW_BLOCK_BINDING,
+			&constants,
+			sizeof(constants)
+		)
 	);
 	if (!configured) {
 		errf(ERR_GENERIC, "failed to configure mesh pipeline");
 		return 0;
 	}
 
-	glBindVertexArray(mesh->vao);
-	glDrawElements(
-		GL_TRIANGLES,
-		mesh->index_count,
-		GL_UNSIGNED_INT,
-		(void*)(0)
-	);
+	gl_state_enable(GL_BLEND, 0);
+	gl_state_bind_vertex_array(mesh->vao);
+	size_t index_size = mesh->index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+
+	// draw instances in as many batches as the instance buffer requires
+	for (size_t drawn = 0, n; drawn < count; drawn += n) {
+		if (!(n = configure_instancing(models + drawn, count - drawn))) {
+			errf(ERR_GENERIC, "failed to configure mesh instancing");
+			return 0;
+		}
+		glDrawElementsInstanced(
+			GL_TRIANGLES,
+			mesh->lods[lod].index_count,
+			mesh->index_type,
+			(void*)(mesh->lods[lod].index_offset * index_size),
+			n
+		);
+		stats_add(draw_calls, 1);
+		stats_add(triangles, mesh->lods[lod].index_count / 3 * n);
+	}
 
 #ifdef DEBUG
 	if (glGetError() != GL_NO_ERROR) {
@@ -1,5 +1,7 @@
+#include "gl_api.h"
+#include "gl_state.h"
 #include "renderlib.h"
-#include <GL/glew.h>
+#include "stats.h"
 #include <assert.h>
 #include <stdlib.h>
 
@@ -11,9 +13,14 @@ static const char *fragment_shader = (
 # include "quad.frag.h"
 );
 
+// defined in draw_common.c
+int
+init_frame(struct Shader *shader, struct ShaderUniformBlock *ub_frame);
+
 static struct Shader *shader = NULL;
 static struct ShaderSource *shader_sources[2] = { NULL, NULL };
-static struct ShaderUniform u_mvp;
+static struct ShaderUniform u_model;
+static struct ShaderUniformBlock ub_frame;
 static struct ShaderUniform u_size;
 static struct ShaderUniform u_border;
 static struct ShaderUniform u_color;
@@ -40,7 +47,7 @@ init_quad_pipeline(void)
 
 	// uniform names and receiver pointers
 	const char *uniform_names[] = {
-		"mvp",
+		"model",
 		"size",
 		"border",
 		"color",
@@ -50,7 +57,7 @@ init_quad_pipeline(void)
 		NULL
 	};
 	struct ShaderUniform *uniforms[] = {
-		&u_mvp,
+		&u_model,
 		&u_size,
 		&u_border,
 		&u_color,
@@ -59,6 +66,15 @@ init_quad_pipeline(void)
 		&u_enable_texture_mapping
 	};
 
+	// uniform block names and receiver pointers
+	const char *uniform_block_names[] = {
+		"Frame",
+		NULL
+	};
+	struct ShaderUniformBlock *uniform_blocks[] = {
+		&ub_frame
+	};
+
 	// compile quad pipeline shader and initialize uniforms
 	shader_sources[0] = shader_source_from_string(
 		vertex_shader,
@@ -73,11 +89,16 @@ init_quad_pipeline(void)
 	    !(shader = shader_new(shader_sources, 2))) {
 		errf(ERR_GENERIC, "quad pipeline shader compile failed");
 		return 0;
-	} else if (!shader_get_uniforms(shader, uniform_names, uniforms)) {
+	} else if (!shader_get_uniforms(shader, uniform_names, uniforms) ||
+	           !shader_get_uniform_blocks(shader, uniform_block_names, uniform_blocks)) {
 		errf(ERR_GENERIC, "bad quad pipeline shader");
 		return 0;
 	}
 
+	if (!init_frame(shader, &ub_frame)) {
+		return 0;
+	}
+
 	// create a VAO for the quad prototype
 	glGenVertexArrays(1, &quad_vao);
 
@@ -97,19 +118,20 @@ draw_quad(struct Quad *quad, struct QuadProps *props, struct Transform *transfor
 	assert(props != NULL);
 	assert(transform != NULL);
 
-	Mat mv, mvp;
-	mat_mul(&transform->view, &transform->model, &mv);
-	mat_mul(&transform->projection, &mv, &mvp);
-
 	int enable_texture_mapping = props->texture != NULL;
 	int texture_sampler = 0;
 	if (enable_texture_mapping) {
-		glActiveTexture(GL_TEXTURE0 + texture_sampler);
-		glBindTexture(GL_TEXTURE_RECTANGLE, props->texture->id);
+		gl_state_bind_texture(
+			texture_sampler,
+			GL_TEXTURE_RECTANGLE,
+			props->texture->id
+		);
+#ifdef DEBUG
 		if (glGetError() != GL_NO_ERROR) {
 			err(ERR_OPENGL);
 			return 0;
 		}
+#endif
 	}
 
 	Vec size = vec(quad->width, quad->height, 0, 0);
@@ -122,7 +144,7 @@ draw_quad(struct Quad *quad, struct QuadProps *props, struct Transform *transfor
 
 	int configured = (
 		shader_bind(shader) &&
-		shader_uniform_set(&u_mvp, 1, &mvp) &&
+		shader_uniform_set(&u_model, 1, &transform->model) &&
 		shader_uniform_set(&u_size, 1, &size) &&
 		shader_uniform_set(&u_border, 1, &border) &&
 		shader_uniform_set(&u_color, 1, &props->color) &&
@@ -135,11 +157,12 @@ draw_quad(struct Quad *quad, struct QuadProps *props, struct Transform *transfor
 		return 0;
 	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBindVertexArray(quad_vao);
+	gl_state_enable(GL_BLEND, 1);
+	gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_state_bind_vertex_array(quad_vao);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glDisable(GL_BLEND);
+	stats_add(draw_calls, 1);
+	stats_add(triangles, 2);
 
 #ifdef DEBUG
 	if (glGetError() != GL_NO_ERROR) {
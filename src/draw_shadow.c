@@ -1,6 +1,9 @@
+#include "gl_api.h"
+#include "gl_state.h"
 #include "renderlib.h"
-#include <GL/glew.h>
+#include "stats.h"
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 static const char *vertex_shader = (
@@ -13,31 +16,46 @@ static const char *fragment_shader = (
 
 // defined in draw_common.c
 int
-update_skin_transforms_buffer(
-	struct AnimationInstance *inst,
-	GLuint buffer,
-	size_t offset,
-	size_t size
-);
-
-int
-configure_skinning(
-	struct AnimationInstance *inst,
+init_skinning(
 	struct Shader *shader,
-	struct ShaderUniform *u_enable_skinning,
-	struct ShaderUniform *u_skin_transforms,
 	struct ShaderUniformBlock *ub_animation,
-	GLuint buffer
+	struct ShaderUniform *u_skin_transforms
 );
 
+int
+configure_skinning(struct AnimationInstance *inst, size_t palette);
+
+size_t
+configure_instancing(const Mat *transforms, size_t count);
+
+int
+configure_constants(GLuint binding, const void *data, size_t size);
+
+int
+init_frame(struct Shader *shader, struct ShaderUniformBlock *ub_frame);
+
+// uniform buffer binding point of the per-draw constants block, shared with
+// the mesh pipeline as each draw binds its own range
+#define DRAW_BLOCK_BINDING 2
+
+/**
+ * Per-draw constants, mirrors the std140 `Draw` block of shadow shaders.
+ *
+ * Vectors declared as `vec3` are packed together with the following scalar.
+ */
+struct DrawConstants {
+	float position_scale[3];
+	int32_t depth_prepass;
+	float position_offset[3];
+	int32_t enable_skinning;
+};
+
 static struct Shader *shader = NULL;
 static struct ShaderSource *shader_sources[2] = { NULL, NULL };
-static struct ShaderUniform u_mvp;
-static struct ShaderUniform u_enable_skinning;
 static struct ShaderUniform u_skin_transforms;
 static struct ShaderUniformBlock ub_animation;
-
-static GLuint skin_transforms_buffer = 0;
+static struct ShaderUniformBlock ub_draw;
+static struct ShaderUniformBlock ub_frame;
 
 static void
 cleanup(void)
@@ -45,7 +63,6 @@ cleanup(void)
 	shader_free(shader);
 	shader_source_free(shader_sources[0]);
 	shader_source_free(shader_sources[1]);
-	glDeleteBuffers(1, &skin_transforms_buffer);
 }
 
 int
@@ -54,24 +71,17 @@ init_shadow_pipeline(void)
 	// cleanup resources at program exit
 	atexit(cleanup);
 
-	// uniform names and receiver pointers
-	const char *uniform_names[] = {
-		"mvp",
-		"enable_skinning",
-		NULL
-	};
-	struct ShaderUniform *uniforms[] = {
-		&u_mvp,
-		&u_enable_skinning
-	};
-
 	// uniform block names and receiver pointers
 	const char *uniform_block_names[] = {
 		"Animation",
+		"Draw",
+		"Frame",
 		NULL
 	};
 	struct ShaderUniformBlock *uniform_blocks[] = {
-		&ub_animation
+		&ub_animation,
+		&ub_draw,
+		&ub_frame
 	};
 
 	// compile shadow pipeline shader and initialize uniforms
@@ -88,10 +98,12 @@ init_shadow_pipeline(void)
 	    !(shader = shader_new(shader_sources, 2))) {
 		errf(ERR_GENERIC, "shadow pipeline shader compile failed");
 		return 0;
-	} else if (!shader_get_uniforms(shader, uniform_names, uniforms) ||
-	           !shader_get_uniform_blocks(shader, uniform_block_names, uniform_blocks)) {
+	} else if (!shader_get_uniform_blocks(shader, uniform_block_names, uniform_blocks)) {
 		errf(ERR_GENERIC, "bad shadow pipeline shader");
 		return 0;
+	} else if (ub_draw.size > sizeof(struct DrawConstants)) {
+		errf(ERR_GENERIC, "shadow pipeline draw block layout mismatch");
+		return 0;
 	}
 
 	// lookup skin transforms array uniform within the uniform block
@@ -103,23 +115,11 @@ init_shadow_pipeline(void)
 		return 0;
 	}
 	u_skin_transforms = *u;
-
-	// allocate an OpenGL buffer for animation uniform block
-	glGenBuffers(1, &skin_transforms_buffer);
-	if (!skin_transforms_buffer) {
-		err(ERR_OPENGL);
+	if (!init_skinning(shader, &ub_animation, &u_skin_transforms) ||
+	    !init_frame(shader, &ub_frame)) {
 		return 0;
 	}
-
-	// initialize buffer storage
-	glBindBuffer(GL_UNIFORM_BUFFER, skin_transforms_buffer);
-	glBufferData(
-		GL_UNIFORM_BUFFER,
-		ub_animation.size,
-		NULL,
-		GL_DYNAMIC_DRAW
-	);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glUniformBlockBinding(shader->prog, ub_draw.index, DRAW_BLOCK_BINDING);
 
 	// check for any OpenGL-related errors
 	if (glGetError() != GL_NO_ERROR) {
@@ -130,31 +130,37 @@ init_shadow_pipeline(void)
 	return 1;
 }
 
-int
-draw_mesh_shadow(
+static int
+draw(
 	struct Mesh *mesh,
 	struct MeshProps *props,
-	struct Transform *transform,
-	struct Light *light
+	size_t palette,
+	size_t lod,
+	const Mat *models,
+	size_t count,
+	int depth_prepass
 ) {
 	assert(mesh != NULL);
 	assert(props != NULL);
-	assert(light != NULL);
+	assert(lod < mesh->lod_count);
+	assert(models != NULL && count > 0);
 
-	// compute final model-view-projection transform in light-space
-	Mat mvp;
-	mat_mul(&light->projection, &transform->model, &mvp);
+	struct DrawConstants constants = {
+		.depth_prepass = depth_prepass,
+		.enable_skinning = props->animation != NULL
+	};
+	for (int i = 0; i < 3; i++) {
+		constants.position_scale[i] = mesh->position_scale.data[i];
+		constants.position_offset[i] = mesh->position_offset.data[i];
+	}
 
 	int configured = (
 		shader_bind(shader) &&
-		shader_uniform_set(&u_mvp, 1, &mvp) &&
-		configure_skinning(
-			props->animation,
-			shader,
-			&u_enable_skinning,
-			&u_skin_transforms,
-			&ub_animation,
-			skin_transforms_buffer
+		configure_skinning(props->animation, palette) &&
+		configure_constants(
+			DRAW_BLOCK_BINDING,
+			&constants,
+			sizeof(constants)
 		)
 	);
 	if (!configured) {
@@ -162,13 +168,26 @@ draw_mesh_shadow(
 		return 0;
 	}
 
-	glBindVertexArray(mesh->vao);
-	glDrawElements(
-		GL_TRIANGLES,
-		mesh->index_count,
-		GL_UNSIGNED_INT,
-		(void*)(0)
-	);
+	gl_state_enable(GL_BLEND, 0);
+	gl_state_bind_vertex_array(mesh->vao);
+	size_t index_size = mesh->index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+
+	// draw instances in as many batches as the instance buffer requires
+	for (size_t drawn = 0, n; drawn < count; drawn += n) {
+		if (!(n = configure_instancing(models + drawn, count - drawn))) {
+			errf(ERR_GENERIC, "failed to configure shadow instancing");
+			return 0;
+		}
+		glDrawElementsInstanced(
+			GL_TRIANGLES,
+			mesh->lods[lod].index_count,
+			mesh->index_type,
+			(void*)(mesh->lods[lod].index_offset * index_size),
+			n
+		);
+		stats_add(draw_calls, 1);
+		stats_add(triangles, mesh->lods[lod].index_count / 3 * n);
+	}
 
 #ifdef DEBUG
 	if (glGetError() != GL_NO_ERROR) {
@@ -177,4 +196,55 @@ draw_mesh_shadow(
 	}
 #endif
 	return 1;
-}
\ No newline at end of file
+}
+
+/**
+ * Draws instances of a mesh into the shadow map.
+ *
+ *   mesh     Mesh to draw.
+ *   props    Mesh render properties.
+ *   palette  Skinning palette index of animated meshes.
+ *   lod      Level of detail to draw.
+ *   models   Model transforms, one per instance.
+ *   count    Number of instances.
+ *
+ * Light-space transform must have been configured with `configure_frame()`.
+ */
+int
+draw_mesh_shadow(
+	struct Mesh *mesh,
+	struct MeshProps *props,
+	size_t palette,
+	size_t lod,
+	const Mat *models,
+	size_t count
+) {
+	return draw(mesh, props, palette, lod, models, count, 0);
+}
+
+/**
+ * Draws instances of a mesh into the depth buffer only, as seen from the
+ * camera.
+ *
+ *   mesh     Mesh to draw.
+ *   props    Mesh render properties.
+ *   palette  Skinning palette index of animated meshes.
+ *   lod      Level of detail to draw.
+ *   models   Model transforms, one per instance.
+ *   count    Number of instances.
+ *
+ * Vertex positions are computed exactly as in the mesh pipeline, so that a
+ * following color pass can test for equal depth. Camera transforms must have
+ * been configured with `configure_frame()`.
+ */
+int
+draw_mesh_depth(
+	struct Mesh *mesh,
+	struct MeshProps *props,
+	size_t palette,
+	size_t lod,
+	const Mat *models,
+	size_t count
+) {
+	return draw(mesh, props, palette, lod, models, count, 1);
+}
@@ -1,5 +1,7 @@
+#include "gl_api.h"
+#include "gl_state.h"
 #include "renderlib.h"
-#include <GL/glew.h>
+#include "stats.h"
 #include <assert.h>
 #include <stdlib.h>
 
@@ -11,9 +13,14 @@ static const char *fragment_shader = (
 # include "text.frag.h"
 );
 
+// defined in draw_common.c
+int
+init_frame(struct Shader *shader, struct ShaderUniformBlock *ub_frame);
+
 static struct Shader *shader = NULL;
 static struct ShaderSource *shader_sources[2] = { NULL, NULL };
-static struct ShaderUniform u_mvp;
+static struct ShaderUniform u_model;
+static struct ShaderUniformBlock ub_frame;
 static struct ShaderUniform u_glyph_map_sampler;
 static struct ShaderUniform u_atlas_map_sampler;
 static struct ShaderUniform u_atlas_offset;
@@ -36,7 +43,7 @@ init_text_pipeline(void)
 
 	// uniform names and receiver pointers
 	const char *uniform_names[] = {
-		"mvp",
+		"model",
 		"glyph_map_sampler",
 		"atlas_map_sampler",
 		"atlas_offset",
@@ -45,7 +52,7 @@ init_text_pipeline(void)
 		NULL
 	};
 	struct ShaderUniform *uniforms[] = {
-		&u_mvp,
+		&u_model,
 		&u_glyph_map_sampler,
 		&u_atlas_map_sampler,
 		&u_atlas_offset,
@@ -53,6 +60,15 @@ init_text_pipeline(void)
 		&u_opacity
 	};
 
+	// uniform block names and receiver pointers
+	const char *uniform_block_names[] = {
+		"Frame",
+		NULL
+	};
+	struct ShaderUniformBlock *uniform_blocks[] = {
+		&ub_frame
+	};
+
 	// compile text pipeline shader and initialize uniforms
 	shader_sources[0] = shader_source_from_string(
 		vertex_shader,
@@ -67,11 +83,16 @@ init_text_pipeline(void)
 	    !(shader = shader_new(shader_sources, 2))) {
 		errf(ERR_GENERIC, "text pipeline shader compile failed");
 		return 0;
-	} else if (!shader_get_uniforms(shader, uniform_names, uniforms)) {
+	} else if (!shader_get_uniforms(shader, uniform_names, uniforms) ||
+	           !shader_get_uniform_blocks(shader, uniform_block_names, uniform_blocks)) {
 		errf(ERR_GENERIC, "bad text pipeline shader");
 		return 0;
 	}
 
+	if (!init_frame(shader, &ub_frame)) {
+		return 0;
+	}
+
 	// check for any OpenGL-related errors
 	if (glGetError() != GL_NO_ERROR) {
 		err(ERR_OPENGL);
@@ -87,30 +108,24 @@ draw_text(struct Text *text, struct TextProps *props, struct Transform *transfor
 	assert(text != NULL);
 	assert(props != NULL);
 
-	Mat mv, mvp;
-	mat_mul(&transform->view, &transform->model, &mv);
-	mat_mul(&transform->projection, &mv, &mvp);
-
 	int glyph_map_sampler = 0, glyph_map = font_get_glyph_texture(text->font);
-	glActiveTexture(GL_TEXTURE0 + glyph_map_sampler);
-	glBindTexture(GL_TEXTURE_1D, glyph_map);
+	gl_state_bind_texture(glyph_map_sampler, GL_TEXTURE_1D, glyph_map);
 
 	int atlas_map_sampler = 1, atlas_map = font_get_atlas_texture(text->font);
-	glActiveTexture(GL_TEXTURE0 + atlas_map_sampler);
-	glBindTexture(GL_TEXTURE_RECTANGLE, atlas_map);
+	gl_state_bind_texture(atlas_map_sampler, GL_TEXTURE_RECTANGLE, atlas_map);
 
+#ifdef DEBUG
 	if (glGetError() != GL_NO_ERROR) {
-		glBindTexture(GL_TEXTURE_1D, 0);
-		glBindTexture(GL_TEXTURE_RECTANGLE, 0);
 		err(ERR_OPENGL);
 		return 0;
 	}
+#endif
 
 	int atlas_offset = font_get_atlas_offset(text->font);
 
 	int configured = (
 		shader_bind(shader) &&
-		shader_uniform_set(&u_mvp, 1, &mvp) &&
+		shader_uniform_set(&u_model, 1, &transform->model) &&
 		shader_uniform_set(&u_glyph_map_sampler, 1, &glyph_map_sampler) &&
 		shader_uniform_set(&u_atlas_map_sampler, 1, &atlas_map_sampler) &&
 		shader_uniform_set(&u_atlas_offset, 1, &atlas_offset) &&
@@ -122,11 +137,12 @@ draw_text(struct Text *text, struct TextProps *props, struct Transform *transfor
 		return 0;
 	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBindVertexArray(text->vao);
+	gl_state_enable(GL_BLEND, 1);
+	gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_state_bind_vertex_array(text->vao);
         glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, text->len);
-	glDisable(GL_BLEND);
+	stats_add(draw_calls, 1);
+	stats_add(triangles, 2 * text->len);
 
 #ifdef DEBUG
 	if (glGetError() != GL_NO_ERROR) {
@@ -4,16 +4,27 @@
 
 #define ERROR_TRACEBACK_SIZE 100
 
-static struct Error {
+struct Error {
 	int code;
 	char *descr;
 	const char *file;
 	const char *context;
 	int line;
-} traceback[ERROR_TRACEBACK_SIZE];
+};
+
+/**
+ * Errors detached from a thread traceback.
+ */
+struct ErrorTraceback {
+	size_t len;
+	struct Error errors[];
+};
 
-static size_t traceback_len = 0;
-static int initialized = 0;
+// each thread has its own traceback, so that errors of concurrent operations
+// don't mix
+static __thread struct Error traceback[ERROR_TRACEBACK_SIZE];
+static __thread size_t traceback_len = 0;
+static int exit_hook = 0;
 
 static const char *error_names[] = {
 	// ERR_TRACEBACK_FULL
@@ -62,17 +73,17 @@ static const char *error_names[] = {
 	"shader uniform type unknown",
 	// ERR_RENDER
 	"render error",
-	// ERR_RENDER_QUEUE_FULL
-	"full render queue"
+	// ERR_INVALID_CAPTURE
+	"invalid frame capture"
 };
 
 void
 error_push(int code, char *descr, const char *file, const char *context, int line)
 {
-	if (!initialized) {
-		memset(traceback, 0, sizeof(traceback));
+	// free the traceback of the main thread at exit, those of other threads
+	// are theirs to clear
+	if (!__atomic_exchange_n(&exit_hook, 1, __ATOMIC_ACQ_REL)) {
 		atexit(error_clear_traceback);
-		initialized = 1;
 	}
 
 	if (traceback_len == ERROR_TRACEBACK_SIZE - 1) {
@@ -105,10 +116,6 @@ error_push(int code, char *descr, const char *file, const char *context, int lin
 void
 error_dump_traceback(FILE *fp)
 {
-	if (!initialized) {
-		return;
-	}
-
 	for (size_t i = 0; i < traceback_len; i++) {
 		struct Error *error = &traceback[i];
 		const char *fmt = (
@@ -137,13 +144,42 @@ error_print_traceback(void)
 void
 error_clear_traceback(void)
 {
-	if (!initialized) {
-		return;
-	}
-
 	for (size_t i = 0; i < traceback_len; i++) {
 		free(traceback[i].descr);
 	}
 	memset(traceback, 0, sizeof(traceback));
 	traceback_len = 0;
-}
\ No newline at end of file
+}
+
+struct ErrorTraceback*
+error_detach_traceback(void)
+{
+	struct ErrorTraceback *tb = malloc(
+		sizeof(struct ErrorTraceback) + traceback_len * sizeof(struct Error)
+	);
+	if (!tb) {
+		error_clear_traceback();
+		return NULL;
+	}
+
+	// descriptions move along with the errors
+	tb->len = traceback_len;
+	memcpy(tb->errors, traceback, traceback_len * sizeof(struct Error));
+	memset(traceback, 0, sizeof(traceback));
+	traceback_len = 0;
+	return tb;
+}
+
+void
+error_attach_traceback(struct ErrorTraceback *tb)
+{
+	if (!tb) {
+		return;
+	}
+
+	for (size_t i = 0; i < tb->len; i++) {
+		struct Error *error = &tb->errors[i];
+		error_push(error->code, error->descr, error->file, error->context, error->line);
+	}
+	free(tb);
+}
@@ -27,7 +27,7 @@ enum {
 	ERR_SHADER_NO_UNIFORM_BLOCK,
 	ERR_SHADER_UNKNOWN_UNIFORM_TYPE,
 	ERR_RENDER,
-	ERR_RENDER_QUEUE_FULL,
+	ERR_INVALID_CAPTURE,
 };
 
 #define err(code) error_push(code, NULL, __FILE__, __func__, __LINE__)
@@ -44,3 +44,25 @@ error_print_traceback(void);
 
 void
 error_clear_traceback(void);
+
+/**
+ * Errors of a thread, handed over to another one.
+ */
+struct ErrorTraceback;
+
+/**
+ * Move the errors pushed so far by the calling thread out of its traceback.
+ *
+ * Tracebacks are kept per thread, thus errors of work done on behalf of
+ * another thread have to be handed over to it. Returns NULL if the
+ * allocation fails, in which case the errors are lost.
+ */
+struct ErrorTraceback*
+error_detach_traceback(void);
+
+/**
+ * Append detached errors to the traceback of the calling thread and free
+ * them. Does nothing if `tb` is NULL.
+ */
+void
+error_attach_traceback(struct ErrorTraceback *tb);
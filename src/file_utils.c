@@ -1,8 +1,15 @@
+// use open source standard library features
+#define _XOPEN_SOURCE 700
+
 #include "file_utils.h"
 #include "error.h"
 #include <assert.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 size_t
 file_read(const char *filename, char **r_buf)
@@ -50,3 +57,50 @@ error:
 	free(*r_buf);
 	goto cleanup;
 }
+
+const void*
+file_map(const char *filename, size_t *r_size)
+{
+	assert(filename != NULL);
+	assert(r_size != NULL);
+
+	void *data = NULL;
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		errf(ERR_NO_FILE, "%s", filename);
+		goto cleanup;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		errf(ERR_IO, "%s", filename);
+		goto cleanup;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		data = NULL;
+		errf(ERR_IO, "%s", filename);
+		goto cleanup;
+	}
+	*r_size = st.st_size;
+
+	// loaders read files front to back once
+	posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+cleanup:
+	// the mapping stays valid after the descriptor is closed
+	if (fd >= 0) {
+		close(fd);
+	}
+	return data;
+}
+
+void
+file_unmap(const void *data, size_t size)
+{
+	if (data) {
+		munmap((void*)data, size);
+	}
+}
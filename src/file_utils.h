@@ -4,3 +4,18 @@
 
 size_t
 file_read(const char *filename, char **r_buf);
+
+/**
+ * Map a file read-only into memory.
+ *
+ * Pages are loaded on access, so that the contents are never copied into an
+ * intermediate buffer. Empty files can't be mapped. Returns NULL on failure.
+ */
+const void*
+file_map(const char *filename, size_t *r_size);
+
+/**
+ * Unmap a file mapped by `file_map()`.
+ */
+void
+file_unmap(const void *data, size_t size);
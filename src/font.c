@@ -5,6 +5,10 @@
 #include "error.h"
 #include "file_utils.h"
 #include "font.h"
+#include "gl_api.h"
+#include "renderlib.h"
+#include "stats.h"
+#include "trace.h"
 #include <assert.h>
 #include <stdlib.h>
 
@@ -16,6 +20,7 @@ struct Font {
 	GLuint tex_glyph;
 	GLuint tex_atlas;
 	unsigned tex_atlas_offset;
+	size_t gpu_bytes;             // texture storage, accounted to statistics
 };
 
 static void
@@ -77,6 +82,8 @@ init_glyph_texture(struct Font *font, FT_Glyph *glyphs)
 		err(ERR_OPENGL);
 		return 0;
 	}
+	font->gpu_bytes += 128 * 2 * sizeof(GLushort);
+	mem_track(RENDER_MEMORY_FONT, MEM_GPU, 128 * 2 * sizeof(GLushort));
 
 	return 1;
 }
@@ -155,6 +162,8 @@ init_atlas_texture(struct Font *font, FT_Glyph *glyphs)
 		err(ERR_OPENGL);
 		return 0;
 	}
+	font->gpu_bytes += atlas_w * atlas_h;
+	mem_track(RENDER_MEMORY_FONT, MEM_GPU, atlas_w * atlas_h);
 
 	return 1;
 }
@@ -204,6 +213,7 @@ font_from_buffer(const void *data, size_t size, unsigned pt)
 
 	FT_Face face = NULL;
 	struct Font *font = NULL;
+	TRACE_BEGIN("load", "font_from_buffer");
 
 	if ((!ft_initialized && !init_freetype())) {
 		err(ERR_FREETYPE);
@@ -212,10 +222,12 @@ font_from_buffer(const void *data, size_t size, unsigned pt)
 	           FT_Set_Pixel_Sizes(face, 0, pt) != 0) {
 		err(ERR_INVALID_FONT);
 		goto error;
-	} else if (!(font = malloc(sizeof(struct Font)))) {
+	} else if (!(font = calloc(1, sizeof(struct Font)))) {
 		err(ERR_NO_MEM);
 		goto error;
-	} else if (!init_font(font, face)) {
+	}
+	mem_track(RENDER_MEMORY_FONT, MEM_CPU, sizeof(struct Font));
+	if (!init_font(font, face)) {
 		goto error;
 	}
 
@@ -224,6 +236,7 @@ cleanup:
 		FT_Done_Face(face);
 	}
 
+	TRACE_END();
 	return font;
 
 error:
@@ -240,9 +253,11 @@ font_from_file(const char *filename, unsigned pt)
 	assert(pt > 0);
 
 	// attempt to read the font file
+	TRACE_BEGIN("load", "font_from_file");
 	char *data = NULL;
 	size_t size = file_read(filename, &data);
 	if (!size) {
+		TRACE_END();
 		return NULL;
 	}
 
@@ -251,6 +266,7 @@ font_from_file(const char *filename, unsigned pt)
 
 	free(data);
 
+	TRACE_END();
 	return font;
 }
 
@@ -286,6 +302,10 @@ void
 font_free(struct Font *font)
 {
 	if (font) {
+		glDeleteTextures(1, &font->tex_glyph);
+		glDeleteTextures(1, &font->tex_atlas);
+		mem_track(RENDER_MEMORY_FONT, MEM_GPU, -(ptrdiff_t)font->gpu_bytes);
+		mem_track(RENDER_MEMORY_FONT, MEM_CPU, -(ptrdiff_t)sizeof(struct Font));
 		free(font);
 	}
 }
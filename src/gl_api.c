@@ -0,0 +1,27 @@
+#define GL_API_IMPLEMENTATION
+
+#include "gl_api.h"
+
+struct GLApi gl_api;
+
+// defined in gl_null.c
+void
+free_null_backend(void);
+
+void
+gl_api_init(void)
+{
+	// entry points are GLEW function pointers or, for OpenGL 1.1 ones,
+	// functions exported by the OpenGL library
+#define GL_API_LOAD(ret, name, params, kind) gl_api.name = gl##name;
+	GL_API_FUNCTIONS(GL_API_LOAD)
+#undef GL_API_LOAD
+}
+
+void
+gl_api_shutdown(void)
+{
+	// the table itself is left untouched, as pipelines release their
+	// OpenGL objects at program exit
+	free_null_backend();
+}
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <GL/glew.h>
+
+/**
+ * OpenGL functions used by the library.
+ *
+ * Each entry gives return type, name without `gl` prefix, parameters and
+ * whether the null backend implements the function (CUSTOM) or just counts
+ * calls to it (NOOP).
+ */
+#define GL_API_FUNCTIONS(X) \
+	X(void, ActiveTexture, (GLenum texture), NOOP) \
+	X(void, AttachShader, (GLuint program, GLuint shader), CUSTOM) \
+	X(void, BindBuffer, (GLenum target, GLuint buffer), NOOP) \
+	X(void, BindBufferBase, (GLenum target, GLuint index, GLuint buffer), NOOP) \
+	X(void, BindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size), NOOP) \
+	X(void, BindFramebuffer, (GLenum target, GLuint framebuffer), NOOP) \
+	X(void, BindRenderbuffer, (GLenum target, GLuint renderbuffer), NOOP) \
+	X(void, BindTexture, (GLenum target, GLuint texture), NOOP) \
+	X(void, BindVertexArray, (GLuint array), NOOP) \
+	X(void, BlendFunc, (GLenum sfactor, GLenum dfactor), NOOP) \
+	X(void, BufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage), NOOP) \
+	X(void, BufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data), NOOP) \
+	X(GLenum, CheckFramebufferStatus, (GLenum target), CUSTOM) \
+	X(void, Clear, (GLbitfield mask), NOOP) \
+	X(void, ClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), NOOP) \
+	X(GLenum, ClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), CUSTOM) \
+	X(void, ColorMask, (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha), NOOP) \
+	X(void, CompileShader, (GLuint shader), NOOP) \
+	X(GLuint, CreateProgram, (void), CUSTOM) \
+	X(GLuint, CreateShader, (GLenum type), CUSTOM) \
+	X(void, DeleteBuffers, (GLsizei n, const GLuint *buffers), NOOP) \
+	X(void, DeleteFramebuffers, (GLsizei n, const GLuint *framebuffers), NOOP) \
+	X(void, DeleteQueries, (GLsizei n, const GLuint *ids), NOOP) \
+	X(void, DeleteRenderbuffers, (GLsizei n, const GLuint *renderbuffers), NOOP) \
+	X(void, DeleteShader, (GLuint shader), CUSTOM) \
+	X(void, DeleteSync, (GLsync sync), NOOP) \
+	X(void, DeleteTextures, (GLsizei n, const GLuint *textures), NOOP) \
+	X(void, DeleteVertexArrays, (GLsizei n, const GLuint *arrays), NOOP) \
+	X(void, DepthFunc, (GLenum func), CUSTOM) \
+	X(void, DepthMask, (GLboolean flag), CUSTOM) \
+	X(void, Disable, (GLenum cap), NOOP) \
+	X(void, DrawArrays, (GLenum mode, GLint first, GLsizei count), NOOP) \
+	X(void, DrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount), NOOP) \
+	X(void, DrawBuffer, (GLenum mode), NOOP) \
+	X(void, DrawElementsInstanced, (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount), NOOP) \
+	X(void, Enable, (GLenum cap), NOOP) \
+	X(void, EnableVertexAttribArray, (GLuint index), NOOP) \
+	X(GLsync, FenceSync, (GLenum condition, GLbitfield flags), CUSTOM) \
+	X(void, FramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer), NOOP) \
+	X(void, FramebufferTexture, (GLenum target, GLenum attachment, GLuint texture, GLint level), NOOP) \
+	X(void, GenBuffers, (GLsizei n, GLuint *buffers), CUSTOM) \
+	X(void, GenFramebuffers, (GLsizei n, GLuint *framebuffers), CUSTOM) \
+	X(void, GenQueries, (GLsizei n, GLuint *ids), CUSTOM) \
+	X(void, GenRenderbuffers, (GLsizei n, GLuint *renderbuffers), CUSTOM) \
+	X(void, GenTextures, (GLsizei n, GLuint *textures), CUSTOM) \
+	X(void, GenVertexArrays, (GLsizei n, GLuint *arrays), CUSTOM) \
+	X(void, GetActiveUniform, (GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name), CUSTOM) \
+	X(void, GetActiveUniformBlockName, (GLuint program, GLuint uniformBlockIndex, GLsizei bufSize, GLsizei *length, GLchar *uniformBlockName), CUSTOM) \
+	X(void, GetActiveUniformBlockiv, (GLuint program, GLuint uniformBlockIndex, GLenum pname, GLint *params), CUSTOM) \
+	X(void, GetActiveUniformName, (GLuint program, GLuint uniformIndex, GLsizei bufSize, GLsizei *length, GLchar *uniformName), CUSTOM) \
+	X(void, GetActiveUniformsiv, (GLuint program, GLsizei uniformCount, const GLuint *uniformIndices, GLenum pname, GLint *params), CUSTOM) \
+	X(GLenum, GetError, (void), CUSTOM) \
+	X(void, GetIntegerv, (GLenum pname, GLint *params), CUSTOM) \
+	X(void, GetProgramInfoLog, (GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog), CUSTOM) \
+	X(void, GetProgramiv, (GLuint program, GLenum pname, GLint *params), CUSTOM) \
+	X(void, GetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64 *params), CUSTOM) \
+	X(void, GetQueryObjectuiv, (GLuint id, GLenum pname, GLuint *params), CUSTOM) \
+	X(void, GetShaderInfoLog, (GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog), NOOP) \
+	X(void, GetShaderiv, (GLuint shader, GLenum pname, GLint *params), CUSTOM) \
+	X(GLuint, GetUniformBlockIndex, (GLuint program, const GLchar *uniformBlockName), CUSTOM) \
+	X(GLint, GetUniformLocation, (GLuint program, const GLchar *name), CUSTOM) \
+	X(void, LinkProgram, (GLuint program), CUSTOM) \
+	X(void *, MapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), CUSTOM) \
+	X(void, PixelStorei, (GLenum pname, GLint param), NOOP) \
+	X(void, QueryCounter, (GLuint id, GLenum target), NOOP) \
+	X(void, ReadBuffer, (GLenum mode), NOOP) \
+	X(void, ReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels), CUSTOM) \
+	X(void, RenderbufferStorage, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height), NOOP) \
+	X(void, ShaderSource, (GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length), CUSTOM) \
+	X(void, TexImage1D, (GLenum target, GLint level, GLint internalFormat, GLsizei width, GLint border, GLenum format, GLenum type, const void *pixels), NOOP) \
+	X(void, TexImage2D, (GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels), NOOP) \
+	X(void, TexParameteri, (GLenum target, GLenum pname, GLint param), NOOP) \
+	X(void, Uniform1fv, (GLint location, GLsizei count, const GLfloat *value), NOOP) \
+	X(void, Uniform1iv, (GLint location, GLsizei count, const GLint *value), NOOP) \
+	X(void, Uniform1uiv, (GLint location, GLsizei count, const GLuint *value), NOOP) \
+	X(void, Uniform2fv, (GLint location, GLsizei count, const GLfloat *value), NOOP) \
+	X(void, Uniform3fv, (GLint location, GLsizei count, const GLfloat *value), NOOP) \
+	X(void, Uniform4fv, (GLint location, GLsizei count, const GLfloat *value), NOOP) \
+	X(void, Uniform4iv, (GLint location, GLsizei count, const GLint *value), NOOP) \
+	X(void, Uniform4uiv, (GLint location, GLsizei count, const GLuint *value), NOOP) \
+	X(void, UniformBlockBinding, (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding), NOOP) \
+	X(void, UniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), NOOP) \
+	X(GLboolean, UnmapBuffer, (GLenum target), CUSTOM) \
+	X(void, UseProgram, (GLuint program), NOOP) \
+	X(void, VertexAttribDivisor, (GLuint index, GLuint divisor), NOOP) \
+	X(void, VertexAttribIPointer, (GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer), NOOP) \
+	X(void, VertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer), NOOP) \
+	X(void, Viewport, (GLint x, GLint y, GLsizei width, GLsizei height), CUSTOM)
+
+/**
+ * OpenGL dispatch table.
+ *
+ * Library sources call OpenGL through this table by including this header,
+ * which redirects `gl*()` functions to its entries, so that the backend can be
+ * swapped at initialization time.
+ */
+struct GLApi {
+#define GL_API_ENTRY(ret, name, params, kind) ret (GLAPIENTRY *name) params;
+	GL_API_FUNCTIONS(GL_API_ENTRY)
+#undef GL_API_ENTRY
+};
+
+extern struct GLApi gl_api;
+
+/**
+ * Fill the dispatch table with GLEW entry points.
+ *
+ * Must be called after GLEW initialization.
+ */
+void
+gl_api_init(void);
+
+/**
+ * Fill the dispatch table with the null backend.
+ *
+ * Null backend calls do nothing but update the `gl_calls` frame statistics
+ * counter, return fake object names and report success. Shader programs are
+ * reflected from their GLSL sources, so that uniforms and uniform blocks
+ * lookups behave as with a driver.
+ */
+void
+gl_api_init_null(void);
+
+/**
+ * Release the resources held by the backend.
+ *
+ * The dispatch table remains usable, so that OpenGL objects can still be
+ * released afterwards.
+ */
+void
+gl_api_shutdown(void);
+
+#ifndef GL_API_IMPLEMENTATION
+#undef glActiveTexture
+#define glActiveTexture gl_api.ActiveTexture
+#undef glAttachShader
+#define glAttachShader gl_api.AttachShader
+#undef glBindBuffer
+#define glBindBuffer gl_api.BindBuffer
+#undef glBindBufferBase
+#define glBindBufferBase gl_api.BindBufferBase
+#undef glBindBufferRange
+#define glBindBufferRange gl_api.BindBufferRange
+#undef glBindFramebuffer
+#define glBindFramebuffer gl_api.BindFramebuffer
+#undef glBindRenderbuffer
+#define glBindRenderbuffer gl_api.BindRenderbuffer
+#undef glBindTexture
+#define glBindTexture gl_api.BindTexture
+#undef glBindVertexArray
+#define glBindVertexArray gl_api.BindVertexArray
+#undef glBlendFunc
+#define glBlendFunc gl_api.BlendFunc
+#undef glBufferData
+#define glBufferData gl_api.BufferData
+#undef glBufferSubData
+#define glBufferSubData gl_api.BufferSubData
+#undef glCheckFramebufferStatus
+#define glCheckFramebufferStatus gl_api.CheckFramebufferStatus
+#undef glClear
+#define glClear gl_api.Clear
+#undef glClearColor
+#define glClearColor gl_api.ClearColor
+#undef glClientWaitSync
+#define glClientWaitSync gl_api.ClientWaitSync
+#undef glColorMask
+#define glColorMask gl_api.ColorMask
+#undef glCompileShader
+#define glCompileShader gl_api.CompileShader
+#undef glCreateProgram
+#define glCreateProgram gl_api.CreateProgram
+#undef glCreateShader
+#define glCreateShader gl_api.CreateShader
+#undef glDeleteBuffers
+#define glDeleteBuffers gl_api.DeleteBuffers
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers gl_api.DeleteFramebuffers
+#undef glDeleteQueries
+#define glDeleteQueries gl_api.DeleteQueries
+#undef glDeleteRenderbuffers
+#define glDeleteRenderbuffers gl_api.DeleteRenderbuffers
+#undef glDeleteShader
+#define glDeleteShader gl_api.DeleteShader
+#undef glDeleteSync
+#define glDeleteSync gl_api.DeleteSync
+#undef glDeleteTextures
+#define glDeleteTextures gl_api.DeleteTextures
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays gl_api.DeleteVertexArrays
+#undef glDepthFunc
+#define glDepthFunc gl_api.DepthFunc
+#undef glDepthMask
+#define glDepthMask gl_api.DepthMask
+#undef glDisable
+#define glDisable gl_api.Disable
+#undef glDrawArrays
+#define glDrawArrays gl_api.DrawArrays
+#undef glDrawArraysInstanced
+#define glDrawArraysInstanced gl_api.DrawArraysInstanced
+#undef glDrawBuffer
+#define glDrawBuffer gl_api.DrawBuffer
+#undef glDrawElementsInstanced
+#define glDrawElementsInstanced gl_api.DrawElementsInstanced
+#undef glEnable
+#define glEnable gl_api.Enable
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray gl_api.EnableVertexAttribArray
+#undef glFenceSync
+#define glFenceSync gl_api.FenceSync
+#undef glFramebufferRenderbuffer
+#define glFramebufferRenderbuffer gl_api.FramebufferRenderbuffer
+#undef glFramebufferTexture
+#define glFramebufferTexture gl_api.FramebufferTexture
+#undef glGenBuffers
+#define glGenBuffers gl_api.GenBuffers
+#undef glGenFramebuffers
+#define glGenFramebuffers gl_api.GenFramebuffers
+#undef glGenQueries
+#define glGenQueries gl_api.GenQueries
+#undef glGenRenderbuffers
+#define glGenRenderbuffers gl_api.GenRenderbuffers
+#undef glGenTextures
+#define glGenTextures gl_api.GenTextures
+#undef glGenVertexArrays
+#define glGenVertexArrays gl_api.GenVertexArrays
+#undef glGetActiveUniform
+#define glGetActiveUniform gl_api.GetActiveUniform
+#undef glGetActiveUniformBlockName
+#define glGetActiveUniformBlockName gl_api.GetActiveUniformBlockName
+#undef glGetActiveUniformBlockiv
+#define glGetActiveUniformBlockiv gl_api.GetActiveUniformBlockiv
+#undef glGetActiveUniformName
+#define glGetActiveUniformName gl_api.GetActiveUniformName
+#undef glGetActiveUniformsiv
+#define glGetActiveUniformsiv gl_api.GetActiveUniformsiv
+#undef glGetError
+#define glGetError gl_api.GetError
+#undef glGetIntegerv
+#define glGetIntegerv gl_api.GetIntegerv
+#undef glGetProgramInfoLog
+#define glGetProgramInfoLog gl_api.GetProgramInfoLog
+#undef glGetProgramiv
+#define glGetProgramiv gl_api.GetProgramiv
+#undef glGetQueryObjectui64v
+#define glGetQueryObjectui64v gl_api.GetQueryObjectui64v
+#undef glGetQueryObjectuiv
+#define glGetQueryObjectuiv gl_api.GetQueryObjectuiv
+#undef glGetShaderInfoLog
+#define glGetShaderInfoLog gl_api.GetShaderInfoLog
+#undef glGetShaderiv
+#define glGetShaderiv gl_api.GetShaderiv
+#undef glGetUniformBlockIndex
+#define glGetUniformBlockIndex gl_api.GetUniformBlockIndex
+#undef glGetUniformLocation
+#define glGetUniformLocation gl_api.GetUniformLocation
+#undef glLinkProgram
+#define glLinkProgram gl_api.LinkProgram
+#undef glMapBufferRange
+#define glMapBufferRange gl_api.MapBufferRange
+#undef glPixelStorei
+#define glPixelStorei gl_api.PixelStorei
+#undef glQueryCounter
+#define glQueryCounter gl_api.QueryCounter
+#undef glReadBuffer
+#define glReadBuffer gl_api.ReadBuffer
+#undef glReadPixels
+#define glReadPixels gl_api.ReadPixels
+#undef glRenderbufferStorage
+#define glRenderbufferStorage gl_api.RenderbufferStorage
+#undef glShaderSource
+#define glShaderSource gl_api.ShaderSource
+#undef glTexImage1D
+#define glTexImage1D gl_api.TexImage1D
+#undef glTexImage2D
+#define glTexImage2D gl_api.TexImage2D
+#undef glTexParameteri
+#define glTexParameteri gl_api.TexParameteri
+#undef glUniform1fv
+#define glUniform1fv gl_api.Uniform1fv
+#undef glUniform1iv
+#define glUniform1iv gl_api.Uniform1iv
+#undef glUniform1uiv
+#define glUniform1uiv gl_api.Uniform1uiv
+#undef glUniform2fv
+#define glUniform2fv gl_api.Uniform2fv
+#undef glUniform3fv
+#define glUniform3fv gl_api.Uniform3fv
+#undef glUniform4fv
+#define glUniform4fv gl_api.Uniform4fv
+#undef glUniform4iv
+#define glUniform4iv gl_api.Uniform4iv
+#undef glUniform4uiv
+#define glUniform4uiv gl_api.Uniform4uiv
+#undef glUniformBlockBinding
+#define glUniformBlockBinding gl_api.UniformBlockBinding
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv gl_api.UniformMatrix4fv
+#undef glUnmapBuffer
+#define glUnmapBuffer gl_api.UnmapBuffer
+#undef glUseProgram
+#define glUseProgram gl_api.UseProgram
+#undef glVertexAttribDivisor
+#define glVertexAttribDivisor gl_api.VertexAttribDivisor
+#undef glVertexAttribIPointer
+#define glVertexAttribIPointer gl_api.VertexAttribIPointer
+#undef glVertexAttribPointer
+#define glVertexAttribPointer gl_api.VertexAttribPointer
+#undef glViewport
+#define glViewport gl_api.Viewport
+#endif
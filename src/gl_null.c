@@ -0,0 +1,906 @@
+#define GL_API_IMPLEMENTATION
+
+#include "gl_api.h"
+#include "stats.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_NAME_LENGTH 64
+#define MAX_ATTACHED_SHADERS 4
+
+// values reported for implementation limits
+#define MAX_COMBINED_TEXTURE_IMAGE_UNITS 48
+#define UNIFORM_BUFFER_OFFSET_ALIGNMENT 256
+
+/**
+ * Uniform declared in a shader source, either standalone or member of a
+ * uniform block.
+ */
+struct NullUniform {
+	char name[MAX_NAME_LENGTH];   // name, with `[0]` suffix for arrays
+	GLenum type;                  // OpenGL type
+	GLint count;                  // array length, 1 if not an array
+	GLint block;                  // block index or -1
+	GLint offset;                 // std140 offset within the block or -1
+};
+
+struct NullBlock {
+	char name[MAX_NAME_LENGTH];
+	GLint size;                   // std140 data size
+};
+
+struct NullShader {
+	GLuint name;
+	char *source;
+};
+
+struct NullProgram {
+	GLuint name;
+	GLuint shaders[MAX_ATTACHED_SHADERS];
+	size_t shader_count;
+	int linked;
+	char log[128];
+	struct NullUniform *uniforms;
+	size_t uniform_count;
+	struct NullBlock *blocks;
+	size_t block_count;
+};
+
+/**
+ * GLSL types which can be declared as uniforms, with their std140 size and
+ * alignment.
+ */
+static const struct {
+	const char *name;
+	GLenum type;
+	GLint size;
+	GLint alignment;
+} types[] = {
+	{"bool", GL_BOOL, 4, 4},
+	{"int", GL_INT, 4, 4},
+	{"uint", GL_UNSIGNED_INT, 4, 4},
+	{"float", GL_FLOAT, 4, 4},
+	{"vec2", GL_FLOAT_VEC2, 8, 8},
+	{"vec3", GL_FLOAT_VEC3, 12, 16},
+	{"vec4", GL_FLOAT_VEC4, 16, 16},
+	{"ivec4", GL_INT_VEC4, 16, 16},
+	{"uvec4", GL_UNSIGNED_INT_VEC4, 16, 16},
+	{"mat4", GL_FLOAT_MAT4, 64, 16},
+	{"sampler1D", GL_SAMPLER_1D, 0, 0},
+	{"sampler2D", GL_SAMPLER_2D, 0, 0},
+	{"sampler2DRect", GL_SAMPLER_2D_RECT, 0, 0},
+	{"isampler1D", GL_INT_SAMPLER_1D, 0, 0},
+	{"usampler1D", GL_UNSIGNED_INT_SAMPLER_1D, 0, 0},
+};
+
+#define TYPE_COUNT (sizeof(types) / sizeof(types[0]))
+
+static GLuint next_name = 1;
+static GLint viewport[4];
+static GLint depth_func = GL_LESS;
+static GLint depth_mask = GL_TRUE;
+static void *map_memory = NULL;
+static size_t map_size = 0;
+static struct NullShader *shaders = NULL;
+static size_t shader_count = 0;
+static struct NullProgram *programs = NULL;
+static size_t program_count = 0;
+
+#define count_call() stats_add(gl_calls, 1)
+
+static struct NullShader*
+get_shader(GLuint name)
+{
+	for (size_t i = 0; i < shader_count; i++) {
+		if (shaders[i].name == name) {
+			return &shaders[i];
+		}
+	}
+	return NULL;
+}
+
+static struct NullProgram*
+get_program(GLuint name)
+{
+	for (size_t i = 0; i < program_count; i++) {
+		if (programs[i].name == name) {
+			return &programs[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Tell whether a uniform has given name; arrays can be referred to with or
+ * without `[0]` suffix.
+ */
+static int
+uniform_has_name(const struct NullUniform *u, const char *name)
+{
+	size_t len = strlen(name);
+	return (
+		strncmp(u->name, name, len) == 0 &&
+		(u->name[len] == '\0' || strcmp(u->name + len, "[0]") == 0)
+	);
+}
+
+static void
+copy_name(const char *src, GLsizei size, GLsizei *length, GLchar *dst)
+{
+	int len = size > 0 ? snprintf(dst, size, "%s", src) : 0;
+	if (length) {
+		*length = len < size ? len : size - 1;
+	}
+}
+
+/**
+ * Read next GLSL token, skipping whitespace, comments and preprocessor
+ * directives.
+ *
+ * Tokens are either words made of alphanumeric characters, underscores and
+ * dots, or single punctuation characters. Returns the position past the token
+ * or NULL at the end of the source.
+ */
+static const char*
+next_token(const char *s, char token[MAX_NAME_LENGTH])
+{
+	for (;;) {
+		while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') {
+			s++;
+		}
+		if (s[0] == '/' && s[1] == '/') {
+			s += strcspn(s, "\n");
+		} else if (s[0] == '/' && s[1] == '*') {
+			const char *end = strstr(s + 2, "*/");
+			s = end ? end + 2 : s + strlen(s);
+		} else if (s[0] == '#') {
+			s += strcspn(s, "\n");
+		} else {
+			break;
+		}
+	}
+	if (*s == '\0') {
+		return NULL;
+	}
+
+	size_t len = strspn(
+		s,
+		"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_."
+	);
+	if (len == 0) {
+		len = 1;
+	}
+	if (len >= MAX_NAME_LENGTH) {
+		len = MAX_NAME_LENGTH - 1;
+	}
+	memcpy(token, s, len);
+	token[len] = '\0';
+	return s + len;
+}
+
+/**
+ * Skip tokens up to and including given one.
+ */
+static const char*
+skip_past(const char *s, const char *until)
+{
+	char token[MAX_NAME_LENGTH];
+	while (s && (s = next_token(s, token)) && strcmp(token, until) != 0);
+	return s;
+}
+
+static int
+add_uniform(
+	struct NullProgram *prog,
+	const char *type_name,
+	const char *name,
+	GLint count,
+	GLint block
+) {
+	// uniforms are shared by all stages of a program
+	for (size_t i = 0; i < prog->uniform_count; i++) {
+		if (uniform_has_name(&prog->uniforms[i], name)) {
+			return 1;
+		}
+	}
+
+	size_t t = 0;
+	while (t < TYPE_COUNT && strcmp(types[t].name, type_name) != 0) {
+		t++;
+	}
+	if (t == TYPE_COUNT) {
+		snprintf(prog->log, sizeof(prog->log), "unsupported type %s", type_name);
+		return 0;
+	}
+
+	struct NullUniform *uniforms = realloc(
+		prog->uniforms,
+		sizeof(struct NullUniform) * (prog->uniform_count + 1)
+	);
+	if (!uniforms) {
+		snprintf(prog->log, sizeof(prog->log), "out of memory");
+		return 0;
+	}
+	prog->uniforms = uniforms;
+
+	struct NullUniform *u = &uniforms[prog->uniform_count++];
+	snprintf(u->name, sizeof(u->name), count > 1 ? "%s[0]" : "%s", name);
+	u->type = types[t].type;
+	u->count = count;
+	u->block = block;
+	u->offset = -1;
+
+	// lay the uniform out within its block following std140 rules, where
+	// array elements are aligned to vec4
+	if (block >= 0) {
+		GLint size = types[t].size, alignment = types[t].alignment;
+		if (count > 1) {
+			size = alignment = 16 * ((size + 15) / 16);
+			size *= count;
+		}
+		struct NullBlock *b = &prog->blocks[block];
+		u->offset = (b->size + alignment - 1) / alignment * alignment;
+		b->size = u->offset + size;
+	}
+
+	return 1;
+}
+
+/**
+ * Parse a uniform declaration, following the `uniform` keyword.
+ */
+static const char*
+parse_uniform(struct NullProgram *prog, const char *s)
+{
+	char type_name[MAX_NAME_LENGTH], name[MAX_NAME_LENGTH], token[MAX_NAME_LENGTH];
+	if (!(s = next_token(s, type_name)) || !(s = next_token(s, name))) {
+		return NULL;
+	}
+
+	// standalone uniform, optionally an array and with a default value
+	if (strcmp(name, "{") != 0) {
+		if (!(s = next_token(s, token))) {
+			return NULL;
+		}
+		GLint count = 1;
+		if (strcmp(token, "[") == 0) {
+			if (!(s = next_token(s, token))) {
+				return NULL;
+			}
+			count = atoi(token);
+		}
+		if (strcmp(token, ";") != 0) {
+			s = skip_past(s, ";");
+		}
+		return add_uniform(prog, type_name, name, count, -1) ? s : NULL;
+	}
+
+	// uniform block; blocks declared by several stages are laid out once
+	GLint block = prog->block_count;
+	for (size_t b = 0; b < prog->block_count; b++) {
+		if (strcmp(prog->blocks[b].name, type_name) == 0) {
+			return skip_past(skip_past(s, "}"), ";");
+		}
+	}
+	struct NullBlock *blocks = realloc(
+		prog->blocks,
+		sizeof(struct NullBlock) * (prog->block_count + 1)
+	);
+	if (!blocks) {
+		snprintf(prog->log, sizeof(prog->log), "out of memory");
+		return NULL;
+	}
+	prog->blocks = blocks;
+	snprintf(blocks[block].name, MAX_NAME_LENGTH, "%s", type_name);
+	blocks[block].size = 0;
+	prog->block_count++;
+
+	// members, up to the closing brace
+	while ((s = next_token(s, type_name)) && strcmp(type_name, "}") != 0) {
+		GLint count = 1;
+		if (!(s = next_token(s, name)) || !(s = next_token(s, token))) {
+			return NULL;
+		}
+		if (strcmp(token, "[") == 0) {
+			if (!(s = next_token(s, token))) {
+				return NULL;
+			}
+			count = atoi(token);
+			s = skip_past(s, ";");
+		}
+		if (!s || !add_uniform(prog, type_name, name, count, block)) {
+			return NULL;
+		}
+	}
+
+	// std140 rounds block size up to vec4 alignment
+	blocks[block].size = (blocks[block].size + 15) / 16 * 16;
+
+	return s ? skip_past(s, ";") : NULL;
+}
+
+/**
+ * Collect uniform and uniform block declarations of a shader source.
+ */
+static int
+reflect_source(struct NullProgram *prog, const char *source)
+{
+	const char *s = source;
+	char token[MAX_NAME_LENGTH];
+	int depth = 0;
+	while ((s = next_token(s, token))) {
+		if (strcmp(token, "{") == 0) {
+			depth++;
+		} else if (strcmp(token, "}") == 0) {
+			depth--;
+		} else if (depth == 0 && strcmp(token, "uniform") == 0) {
+			if (!(s = parse_uniform(prog, s))) {
+				if (!prog->log[0]) {
+					snprintf(prog->log, sizeof(prog->log), "bad uniform declaration");
+				}
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static void GLAPIENTRY
+null_AttachShader(GLuint program, GLuint shader)
+{
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	if (prog && prog->shader_count < MAX_ATTACHED_SHADERS) {
+		prog->shaders[prog->shader_count++] = shader;
+	}
+}
+
+static GLenum GLAPIENTRY
+null_CheckFramebufferStatus(GLenum target)
+{
+	count_call();
+	return GL_FRAMEBUFFER_COMPLETE;
+}
+
+static GLenum GLAPIENTRY
+null_ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+{
+	count_call();
+	return GL_ALREADY_SIGNALED;
+}
+
+static GLuint GLAPIENTRY
+null_CreateProgram(void)
+{
+	count_call();
+	struct NullProgram *tmp = realloc(
+		programs,
+		sizeof(struct NullProgram) * (program_count + 1)
+	);
+	if (!tmp) {
+		return 0;
+	}
+	programs = tmp;
+	struct NullProgram *prog = &programs[program_count++];
+	memset(prog, 0, sizeof(struct NullProgram));
+	prog->name = next_name++;
+	return prog->name;
+}
+
+static GLuint GLAPIENTRY
+null_CreateShader(GLenum type)
+{
+	count_call();
+	struct NullShader *tmp = realloc(
+		shaders,
+		sizeof(struct NullShader) * (shader_count + 1)
+	);
+	if (!tmp) {
+		return 0;
+	}
+	shaders = tmp;
+	struct NullShader *shader = &shaders[shader_count++];
+	shader->name = next_name++;
+	shader->source = NULL;
+	return shader->name;
+}
+
+static void GLAPIENTRY
+null_DeleteShader(GLuint shader)
+{
+	count_call();
+	struct NullShader *s = get_shader(shader);
+	if (s) {
+		free(s->source);
+		*s = shaders[--shader_count];
+	}
+}
+
+static void GLAPIENTRY
+null_DepthFunc(GLenum func)
+{
+	count_call();
+	depth_func = func;
+}
+
+static void GLAPIENTRY
+null_DepthMask(GLboolean flag)
+{
+	count_call();
+	depth_mask = flag;
+}
+
+static GLsync GLAPIENTRY
+null_FenceSync(GLenum condition, GLbitfield flags)
+{
+	count_call();
+	return (GLsync)(uintptr_t)next_name++;
+}
+
+static void
+gen_names(GLsizei n, GLuint *names)
+{
+	count_call();
+	for (GLsizei i = 0; i < n; i++) {
+		names[i] = next_name++;
+	}
+}
+
+static void GLAPIENTRY
+null_GenBuffers(GLsizei n, GLuint *buffers)
+{
+	gen_names(n, buffers);
+}
+
+static void GLAPIENTRY
+null_GenFramebuffers(GLsizei n, GLuint *framebuffers)
+{
+	gen_names(n, framebuffers);
+}
+
+static void GLAPIENTRY
+null_GenQueries(GLsizei n, GLuint *ids)
+{
+	gen_names(n, ids);
+}
+
+static void GLAPIENTRY
+null_GenRenderbuffers(GLsizei n, GLuint *renderbuffers)
+{
+	gen_names(n, renderbuffers);
+}
+
+static void GLAPIENTRY
+null_GenTextures(GLsizei n, GLuint *textures)
+{
+	gen_names(n, textures);
+}
+
+static void GLAPIENTRY
+null_GenVertexArrays(GLsizei n, GLuint *arrays)
+{
+	gen_names(n, arrays);
+}
+
+static void GLAPIENTRY
+null_GetActiveUniform(
+	GLuint program,
+	GLuint index,
+	GLsizei bufSize,
+	GLsizei *length,
+	GLint *size,
+	GLenum *type,
+	GLchar *name
+) {
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	if (prog && index < prog->uniform_count) {
+		struct NullUniform *u = &prog->uniforms[index];
+		copy_name(u->name, bufSize, length, name);
+		*size = u->count;
+		*type = u->type;
+	}
+}
+
+static void GLAPIENTRY
+null_GetActiveUniformBlockName(
+	GLuint program,
+	GLuint uniformBlockIndex,
+	GLsizei bufSize,
+	GLsizei *length,
+	GLchar *uniformBlockName
+) {
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	if (prog && uniformBlockIndex < prog->block_count) {
+		copy_name(
+			prog->blocks[uniformBlockIndex].name,
+			bufSize,
+			length,
+			uniformBlockName
+		);
+	}
+}
+
+static void GLAPIENTRY
+null_GetActiveUniformBlockiv(
+	GLuint program,
+	GLuint uniformBlockIndex,
+	GLenum pname,
+	GLint *params
+) {
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	if (!prog || uniformBlockIndex >= prog->block_count) {
+		return;
+	}
+
+	GLint n = 0;
+	for (size_t i = 0; i < prog->uniform_count; i++) {
+		if (prog->uniforms[i].block == (GLint)uniformBlockIndex) {
+			if (pname == GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES) {
+				params[n] = i;
+			}
+			n++;
+		}
+	}
+
+	switch (pname) {
+	case GL_UNIFORM_BLOCK_DATA_SIZE:
+		*params = prog->blocks[uniformBlockIndex].size;
+		break;
+	case GL_UNIFORM_BLOCK_NAME_LENGTH:
+		*params = strlen(prog->blocks[uniformBlockIndex].name) + 1;
+		break;
+	case GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS:
+		*params = n;
+		break;
+	}
+}
+
+static void GLAPIENTRY
+null_GetActiveUniformName(
+	GLuint program,
+	GLuint uniformIndex,
+	GLsizei bufSize,
+	GLsizei *length,
+	GLchar *uniformName
+) {
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	if (prog && uniformIndex < prog->uniform_count) {
+		copy_name(prog->uniforms[uniformIndex].name, bufSize, length, uniformName);
+	}
+}
+
+static void GLAPIENTRY
+null_GetActiveUniformsiv(
+	GLuint program,
+	GLsizei uniformCount,
+	const GLuint *uniformIndices,
+	GLenum pname,
+	GLint *params
+) {
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	for (GLsizei i = 0; prog && i < uniformCount; i++) {
+		if (uniformIndices[i] >= prog->uniform_count) {
+			continue;
+		}
+		struct NullUniform *u = &prog->uniforms[uniformIndices[i]];
+		switch (pname) {
+		case GL_UNIFORM_TYPE:
+			params[i] = u->type;
+			break;
+		case GL_UNIFORM_SIZE:
+			params[i] = u->count;
+			break;
+		case GL_UNIFORM_NAME_LENGTH:
+			params[i] = strlen(u->name) + 1;
+			break;
+		case GL_UNIFORM_BLOCK_INDEX:
+			params[i] = u->block;
+			break;
+		case GL_UNIFORM_OFFSET:
+			params[i] = u->offset;
+			break;
+		}
+	}
+}
+
+static GLenum GLAPIENTRY
+null_GetError(void)
+{
+	count_call();
+	return GL_NO_ERROR;
+}
+
+static void GLAPIENTRY
+null_GetIntegerv(GLenum pname, GLint *params)
+{
+	count_call();
+	switch (pname) {
+	case GL_VIEWPORT:
+		memcpy(params, viewport, sizeof(viewport));
+		break;
+	case GL_DEPTH_FUNC:
+		*params = depth_func;
+		break;
+	case GL_DEPTH_WRITEMASK:
+		*params = depth_mask;
+		break;
+	case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS:
+		*params = MAX_COMBINED_TEXTURE_IMAGE_UNITS;
+		break;
+	case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+		*params = UNIFORM_BUFFER_OFFSET_ALIGNMENT;
+		break;
+	default:
+		*params = 0;
+	}
+}
+
+static void GLAPIENTRY
+null_GetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog)
+{
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	copy_name(prog ? prog->log : "", bufSize, length, infoLog);
+}
+
+static void GLAPIENTRY
+null_GetProgramiv(GLuint program, GLenum pname, GLint *params)
+{
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	if (!prog) {
+		*params = 0;
+		return;
+	}
+
+	GLint max_len = 0;
+	switch (pname) {
+	case GL_LINK_STATUS:
+		*params = prog->linked ? GL_TRUE : GL_FALSE;
+		break;
+	case GL_INFO_LOG_LENGTH:
+		*params = strlen(prog->log) + 1;
+		break;
+	case GL_ACTIVE_UNIFORMS:
+		*params = prog->uniform_count;
+		break;
+	case GL_ACTIVE_UNIFORM_BLOCKS:
+		*params = prog->block_count;
+		break;
+	case GL_ACTIVE_UNIFORM_MAX_LENGTH:
+		for (size_t i = 0; i < prog->uniform_count; i++) {
+			GLint len = strlen(prog->uniforms[i].name) + 1;
+			max_len = len > max_len ? len : max_len;
+		}
+		*params = max_len;
+		break;
+	case GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH:
+		for (size_t i = 0; i < prog->block_count; i++) {
+			GLint len = strlen(prog->blocks[i].name) + 1;
+			max_len = len > max_len ? len : max_len;
+		}
+		*params = max_len;
+		break;
+	default:
+		*params = 0;
+	}
+}
+
+static void GLAPIENTRY
+null_GetQueryObjectui64v(GLuint id, GLenum pname, GLuint64 *params)
+{
+	count_call();
+	*params = 0;
+}
+
+static void GLAPIENTRY
+null_GetQueryObjectuiv(GLuint id, GLenum pname, GLuint *params)
+{
+	count_call();
+	*params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+static void GLAPIENTRY
+null_GetShaderiv(GLuint shader, GLenum pname, GLint *params)
+{
+	count_call();
+	switch (pname) {
+	case GL_COMPILE_STATUS:
+		*params = GL_TRUE;
+		break;
+	case GL_INFO_LOG_LENGTH:
+		*params = 1;
+		break;
+	default:
+		*params = 0;
+	}
+}
+
+static GLuint GLAPIENTRY
+null_GetUniformBlockIndex(GLuint program, const GLchar *uniformBlockName)
+{
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	for (size_t i = 0; prog && i < prog->block_count; i++) {
+		if (strcmp(prog->blocks[i].name, uniformBlockName) == 0) {
+			return i;
+		}
+	}
+	return GL_INVALID_INDEX;
+}
+
+static GLint GLAPIENTRY
+null_GetUniformLocation(GLuint program, const GLchar *name)
+{
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	for (size_t i = 0; prog && i < prog->uniform_count; i++) {
+		struct NullUniform *u = &prog->uniforms[i];
+		if (u->block < 0 && uniform_has_name(u, name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void GLAPIENTRY
+null_LinkProgram(GLuint program)
+{
+	count_call();
+	struct NullProgram *prog = get_program(program);
+	if (!prog) {
+		return;
+	}
+
+	free(prog->uniforms);
+	free(prog->blocks);
+	prog->uniforms = NULL;
+	prog->uniform_count = 0;
+	prog->blocks = NULL;
+	prog->block_count = 0;
+	prog->log[0] = '\0';
+
+	prog->linked = 1;
+	for (size_t i = 0; prog->linked && i < prog->shader_count; i++) {
+		struct NullShader *shader = get_shader(prog->shaders[i]);
+		prog->linked = (
+			shader &&
+			shader->source &&
+			reflect_source(prog, shader->source)
+		);
+	}
+}
+
+static void* GLAPIENTRY
+null_MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	count_call();
+
+	// all mappings share one scratch area, as written data is discarded
+	if ((size_t)length > map_size) {
+		void *memory = realloc(map_memory, length);
+		if (!memory) {
+			return NULL;
+		}
+		map_memory = memory;
+		map_size = length;
+	}
+	return map_memory;
+}
+
+static void GLAPIENTRY
+null_ReadPixels(
+	GLint x,
+	GLint y,
+	GLsizei width,
+	GLsizei height,
+	GLenum format,
+	GLenum type,
+	void *pixels
+) {
+	count_call();
+	if (format == GL_RGBA && type == GL_UNSIGNED_BYTE) {
+		memset(pixels, 0, (size_t)width * height * 4);
+	}
+}
+
+static void GLAPIENTRY
+null_ShaderSource(
+	GLuint shader,
+	GLsizei count,
+	const GLchar *const *string,
+	const GLint *length
+) {
+	count_call();
+	struct NullShader *s = get_shader(shader);
+	if (!s) {
+		return;
+	}
+
+	size_t size = 1;
+	for (GLsizei i = 0; i < count; i++) {
+		size += length && length[i] >= 0 ? (size_t)length[i] : strlen(string[i]);
+	}
+	free(s->source);
+	if (!(s->source = malloc(size))) {
+		return;
+	}
+	s->source[0] = '\0';
+	for (GLsizei i = 0; i < count; i++) {
+		if (length && length[i] >= 0) {
+			strncat(s->source, string[i], length[i]);
+		} else {
+			strcat(s->source, string[i]);
+		}
+	}
+}
+
+static GLboolean GLAPIENTRY
+null_UnmapBuffer(GLenum target)
+{
+	count_call();
+	return GL_TRUE;
+}
+
+static void GLAPIENTRY
+null_Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	count_call();
+	viewport[0] = x;
+	viewport[1] = y;
+	viewport[2] = width;
+	viewport[3] = height;
+}
+
+// functions with no side effects other than being counted
+#define CUSTOM(ret, name, params)
+#define NOOP(ret, name, params) static ret GLAPIENTRY null_##name params { count_call(); }
+#define GL_API_NULL_STUB(ret, name, params, kind) kind(ret, name, params)
+GL_API_FUNCTIONS(GL_API_NULL_STUB)
+#undef GL_API_NULL_STUB
+#undef NOOP
+#undef CUSTOM
+
+void
+gl_api_init_null(void)
+{
+#define GL_API_LOAD(ret, name, params, kind) gl_api.name = null_##name;
+	GL_API_FUNCTIONS(GL_API_LOAD)
+#undef GL_API_LOAD
+}
+
+/**
+ * Release null backend objects.
+ */
+void
+free_null_backend(void)
+{
+	for (size_t i = 0; i < shader_count; i++) {
+		free(shaders[i].source);
+	}
+	free(shaders);
+	shaders = NULL;
+	shader_count = 0;
+
+	for (size_t i = 0; i < program_count; i++) {
+		free(programs[i].uniforms);
+		free(programs[i].blocks);
+	}
+	free(programs);
+	programs = NULL;
+	program_count = 0;
+
+	free(map_memory);
+	map_memory = NULL;
+	map_size = 0;
+	memset(viewport, 0, sizeof(viewport));
+	depth_func = GL_LESS;
+	depth_mask = GL_TRUE;
+}
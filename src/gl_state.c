@@ -0,0 +1,257 @@
+#include "gl_api.h"
+#include "gl_state.h"
+#include "stats.h"
+#include <string.h>
+
+#define MAX_TEXTURE_UNITS 32
+#define MAX_UNIFORM_BUFFERS 16
+
+// NOTE: unknown state is represented by all bits set, which is what
+// `gl_state_invalidate()` fills the state with; the state starts unknown
+#define ensure_initialized() if (!initialized) gl_state_invalidate()
+
+enum {
+	TEXTURE_TARGET_1D,
+	TEXTURE_TARGET_2D,
+	TEXTURE_TARGET_RECTANGLE,
+	TEXTURE_TARGET_COUNT
+};
+
+static struct {
+	GLuint program;
+	GLuint vertex_array;
+	GLuint active_texture;
+	GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+	struct {
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	} uniform_buffers[MAX_UNIFORM_BUFFERS];
+	GLuint depth_test;
+	GLuint blend;
+	GLuint blend_src;
+	GLuint blend_dst;
+	GLuint depth_func;
+	GLuint depth_mask;
+} state;
+
+static int initialized = 0;
+
+static int
+texture_target_slot(GLenum target)
+{
+	switch (target) {
+	case GL_TEXTURE_1D:
+		return TEXTURE_TARGET_1D;
+	case GL_TEXTURE_2D:
+		return TEXTURE_TARGET_2D;
+	case GL_TEXTURE_RECTANGLE:
+		return TEXTURE_TARGET_RECTANGLE;
+	}
+	return -1;
+}
+
+static GLuint*
+cap_slot(GLenum cap)
+{
+	switch (cap) {
+	case GL_DEPTH_TEST:
+		return &state.depth_test;
+	case GL_BLEND:
+		return &state.blend;
+	}
+	return NULL;
+}
+
+static void
+set_active_texture(GLuint unit)
+{
+	if (state.active_texture == unit) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	glActiveTexture(GL_TEXTURE0 + unit);
+	state.active_texture = unit;
+	stats_add(state_changes, 1);
+}
+
+void
+gl_state_invalidate(void)
+{
+	memset(&state, 0xff, sizeof(state));
+	initialized = 1;
+}
+
+void
+gl_state_use_program(GLuint program)
+{
+	ensure_initialized();
+
+	if (state.program == program) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	glUseProgram(program);
+	state.program = program;
+	stats_add(program_binds, 1);
+	stats_add(state_changes, 1);
+}
+
+void
+gl_state_bind_vertex_array(GLuint vao)
+{
+	ensure_initialized();
+
+	if (state.vertex_array == vao) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	glBindVertexArray(vao);
+	state.vertex_array = vao;
+	stats_add(vertex_array_binds, 1);
+	stats_add(state_changes, 1);
+}
+
+void
+gl_state_bind_texture(GLuint unit, GLenum target, GLuint texture)
+{
+	ensure_initialized();
+
+	// bindings on untracked units or targets always go through
+	int slot = texture_target_slot(target);
+	if (unit >= MAX_TEXTURE_UNITS || slot < 0) {
+		set_active_texture(unit);
+		glBindTexture(target, texture);
+		stats_add(texture_binds, 1);
+		stats_add(state_changes, 1);
+		return;
+	}
+
+	if (state.textures[unit][slot] == texture) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	set_active_texture(unit);
+	glBindTexture(target, texture);
+	state.textures[unit][slot] = texture;
+	stats_add(texture_binds, 1);
+	stats_add(state_changes, 1);
+}
+
+static int
+uniform_buffer_bound(
+	GLuint index,
+	GLuint buffer,
+	GLintptr offset,
+	GLsizeiptr size
+) {
+	if (index >= MAX_UNIFORM_BUFFERS) {
+		return 0;
+	}
+	if (state.uniform_buffers[index].buffer == buffer &&
+	    state.uniform_buffers[index].offset == offset &&
+	    state.uniform_buffers[index].size == size) {
+		return 1;
+	}
+	state.uniform_buffers[index].buffer = buffer;
+	state.uniform_buffers[index].offset = offset;
+	state.uniform_buffers[index].size = size;
+	return 0;
+}
+
+void
+gl_state_bind_uniform_buffer(GLuint index, GLuint buffer)
+{
+	ensure_initialized();
+
+	// whole buffer bindings are tracked as zero-sized ranges
+	if (uniform_buffer_bound(index, buffer, 0, 0)) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+	stats_add(state_changes, 1);
+}
+
+void
+gl_state_bind_uniform_buffer_range(
+	GLuint index,
+	GLuint buffer,
+	GLintptr offset,
+	GLsizeiptr size
+) {
+	ensure_initialized();
+
+	if (uniform_buffer_bound(index, buffer, offset, size)) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+	stats_add(state_changes, 1);
+}
+
+void
+gl_state_enable(GLenum cap, int enable)
+{
+	ensure_initialized();
+
+	GLuint *slot = cap_slot(cap);
+	GLuint value = enable ? 1 : 0;
+	if (slot && *slot == value) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	if (enable) {
+		glEnable(cap);
+	} else {
+		glDisable(cap);
+	}
+	if (slot) {
+		*slot = value;
+	}
+	stats_add(state_changes, 1);
+}
+
+void
+gl_state_blend_func(GLenum src, GLenum dst)
+{
+	ensure_initialized();
+
+	if (state.blend_src == src && state.blend_dst == dst) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	glBlendFunc(src, dst);
+	state.blend_src = src;
+	state.blend_dst = dst;
+	stats_add(state_changes, 1);
+}
+
+void
+gl_state_depth_func(GLenum func)
+{
+	ensure_initialized();
+
+	if (state.depth_func == func) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	glDepthFunc(func);
+	state.depth_func = func;
+	stats_add(state_changes, 1);
+}
+
+void
+gl_state_depth_mask(GLboolean flag)
+{
+	ensure_initialized();
+
+	GLuint value = flag ? 1 : 0;
+	if (state.depth_mask == value) {
+		stats_add(state_changes_skipped, 1);
+		return;
+	}
+	glDepthMask(flag);
+	state.depth_mask = value;
+	stats_add(state_changes, 1);
+}
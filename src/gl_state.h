@@ -0,0 +1,48 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <stddef.h>
+
+/**
+ * OpenGL state tracker.
+ *
+ * Remembers the state set through it and filters out calls which would not
+ * change anything. The tracker can't see changes made by direct OpenGL calls,
+ * thus the cache must be invalidated whenever the state might have been
+ * changed behind its back.
+ */
+
+void
+gl_state_invalidate(void);
+
+void
+gl_state_use_program(GLuint program);
+
+void
+gl_state_bind_vertex_array(GLuint vao);
+
+void
+gl_state_bind_texture(GLuint unit, GLenum target, GLuint texture);
+
+void
+gl_state_bind_uniform_buffer(GLuint index, GLuint buffer);
+
+void
+gl_state_bind_uniform_buffer_range(
+	GLuint index,
+	GLuint buffer,
+	GLintptr offset,
+	GLsizeiptr size
+);
+
+void
+gl_state_enable(GLenum cap, int enable);
+
+void
+gl_state_blend_func(GLenum src, GLenum dst);
+
+void
+gl_state_depth_func(GLenum func);
+
+void
+gl_state_depth_mask(GLboolean flag);
@@ -0,0 +1,107 @@
+#include "error.h"
+#include "gl_api.h"
+#include "gpu_timer.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct GpuTimer*
+gpu_timer_new(size_t mark_count)
+{
+	assert(mark_count > 0 && mark_count <= GPU_TIMER_MAX_MARKS);
+
+	struct GpuTimer *timer = malloc(sizeof(struct GpuTimer));
+	if (!timer) {
+		err(ERR_NO_MEM);
+		return NULL;
+	}
+	memset(timer, 0, sizeof(struct GpuTimer));
+	timer->mark_count = mark_count;
+
+	for (size_t f = 0; f < GPU_TIMER_FRAMES; f++) {
+		glGenQueries(mark_count, timer->queries[f]);
+	}
+	if (glGetError() != GL_NO_ERROR) {
+		err(ERR_OPENGL);
+		gpu_timer_free(timer);
+		return NULL;
+	}
+
+	return timer;
+}
+
+/**
+ * Record a GPU timestamp in current frame.
+ *
+ *   timer  GPU timer.
+ *   mark   Index of the timestamp; marks must be issued in order.
+ */
+void
+gpu_timer_mark(struct GpuTimer *timer, size_t mark)
+{
+	assert(timer != NULL);
+	assert(mark < timer->mark_count);
+
+	glQueryCounter(timer->queries[timer->frame][mark], GL_TIMESTAMP);
+	if (mark == timer->issued) {
+		timer->issued++;
+	}
+}
+
+/**
+ * End current frame and retrieve the timestamps of the oldest one.
+ *
+ *   timer         GPU timer.
+ *   r_timestamps  Array of `mark_count` timestamps in nanoseconds.
+ *
+ * Returns 1 if the timestamps of the frame issued `GPU_TIMER_FRAMES - 1`
+ * frames ago were available and have been stored, 0 otherwise. Frames which
+ * didn't issue all marks, e.g. because of an error, are never reported.
+ */
+int
+gpu_timer_end_frame(struct GpuTimer *timer, GLuint64 *r_timestamps)
+{
+	assert(timer != NULL);
+	assert(r_timestamps != NULL);
+
+	timer->pending[timer->frame] = timer->issued == timer->mark_count;
+	timer->issued = 0;
+	timer->frame = (timer->frame + 1) % GPU_TIMER_FRAMES;
+
+	// the slot about to be reused is the oldest one; if its results
+	// aren't there yet, they are dropped rather than waited for
+	size_t f = timer->frame;
+	if (!timer->pending[f]) {
+		return 0;
+	}
+	timer->pending[f] = 0;
+
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(
+		timer->queries[f][timer->mark_count - 1],
+		GL_QUERY_RESULT_AVAILABLE,
+		&available
+	);
+	if (!available) {
+		return 0;
+	}
+	for (size_t m = 0; m < timer->mark_count; m++) {
+		glGetQueryObjectui64v(
+			timer->queries[f][m],
+			GL_QUERY_RESULT,
+			&r_timestamps[m]
+		);
+	}
+	return 1;
+}
+
+void
+gpu_timer_free(struct GpuTimer *timer)
+{
+	if (timer) {
+		for (size_t f = 0; f < GPU_TIMER_FRAMES; f++) {
+			glDeleteQueries(timer->mark_count, timer->queries[f]);
+		}
+		free(timer);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <stddef.h>
+
+// maximum number of timestamps taken in a frame
+#define GPU_TIMER_MAX_MARKS 8
+
+// number of frames whose queries can be in flight at once
+#define GPU_TIMER_FRAMES 4
+
+/**
+ * GPU timer.
+ *
+ * Records GPU timestamps at fixed points (marks) of each frame through a ring
+ * of query objects, so that results are read a few frames later, once they
+ * are available, without ever stalling the pipeline.
+ */
+struct GpuTimer {
+	GLuint queries[GPU_TIMER_FRAMES][GPU_TIMER_MAX_MARKS];
+	size_t mark_count;
+	size_t frame;                       // current frame slot
+	size_t issued;                      // marks issued in current frame
+	int pending[GPU_TIMER_FRAMES];      // whether slot awaits results
+};
+
+struct GpuTimer*
+gpu_timer_new(size_t mark_count);
+
+void
+gpu_timer_mark(struct GpuTimer *timer, size_t mark);
+
+int
+gpu_timer_end_frame(struct GpuTimer *timer, GLuint64 *r_timestamps);
+
+void
+gpu_timer_free(struct GpuTimer *timer);
@@ -0,0 +1,235 @@
+#include "error.h"
+#include "gl_api.h"
+#include "renderlib.h"
+#include <assert.h>
+#include <string.h>
+
+#ifdef HAVE_EGL
+# include <EGL/egl.h>
+# include <EGL/eglext.h>
+#endif
+
+// defined in renderer.c
+void
+set_target_framebuffer(GLuint fbo);
+
+static struct {
+	int active;
+	GLuint fbo;
+	GLuint color;
+	GLuint depth;
+#ifdef HAVE_EGL
+	EGLDisplay display;
+	EGLContext context;
+#endif
+} headless;
+
+#ifdef HAVE_EGL
+static int
+has_extension(const char *extensions, const char *name)
+{
+	size_t len = strlen(name);
+	for (const char *s = extensions; s && (s = strstr(s, name)); s += len) {
+		if ((s == extensions || s[-1] == ' ') &&
+		    (s[len] == ' ' || s[len] == '\0')) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static EGLDisplay
+get_display(void)
+{
+	// prefer the surfaceless platform, which needs neither a display
+	// server nor a GPU, e.g. with Mesa llvmpipe
+	const char *client_ext = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (has_extension(client_ext, "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)
+			eglGetProcAddress("eglGetPlatformDisplayEXT")
+		);
+		if (get_platform_display) {
+			EGLDisplay display = get_platform_display(
+				EGL_PLATFORM_SURFACELESS_MESA,
+				EGL_DEFAULT_DISPLAY,
+				NULL
+			);
+			if (display != EGL_NO_DISPLAY) {
+				return display;
+			}
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static int
+init_context(void)
+{
+	if ((headless.display = get_display()) == EGL_NO_DISPLAY ||
+	    !eglInitialize(headless.display, NULL, NULL)) {
+		errf(ERR_GENERIC, "EGL display initialization failed");
+		return 0;
+	}
+
+	const char *ext = eglQueryString(headless.display, EGL_EXTENSIONS);
+	if (!has_extension(ext, "EGL_KHR_surfaceless_context")) {
+		errf(ERR_GENERIC, "EGL surfaceless contexts not supported");
+		return 0;
+	}
+
+	// any OpenGL capable config will do, as rendering goes to an FBO
+	EGLint config_attrs[] = {
+		EGL_SURFACE_TYPE, 0,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint config_count = 0;
+	if (!eglBindAPI(EGL_OPENGL_API) ||
+	    !eglChooseConfig(headless.display, config_attrs, &config, 1, &config_count) ||
+	    config_count == 0) {
+		errf(ERR_GENERIC, "no suitable EGL config");
+		return 0;
+	}
+
+	EGLint context_attrs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	headless.context = eglCreateContext(
+		headless.display,
+		config,
+		EGL_NO_CONTEXT,
+		context_attrs
+	);
+	if (headless.context == EGL_NO_CONTEXT ||
+	    !eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, headless.context)) {
+		errf(ERR_GENERIC, "EGL context creation failed");
+		return 0;
+	}
+
+	return 1;
+}
+
+static void
+free_context(void)
+{
+	if (headless.display != EGL_NO_DISPLAY) {
+		eglMakeCurrent(
+			headless.display,
+			EGL_NO_SURFACE,
+			EGL_NO_SURFACE,
+			EGL_NO_CONTEXT
+		);
+		if (headless.context != EGL_NO_CONTEXT) {
+			eglDestroyContext(headless.display, headless.context);
+		}
+		eglTerminate(headless.display);
+	}
+	headless.display = EGL_NO_DISPLAY;
+	headless.context = EGL_NO_CONTEXT;
+}
+#endif
+
+static int
+init_framebuffer(unsigned width, unsigned height)
+{
+	glGenRenderbuffers(1, &headless.color);
+	glBindRenderbuffer(GL_RENDERBUFFER, headless.color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &headless.depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, headless.depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &headless.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, headless.fbo);
+	glFramebufferRenderbuffer(
+		GL_FRAMEBUFFER,
+		GL_COLOR_ATTACHMENT0,
+		GL_RENDERBUFFER,
+		headless.color
+	);
+	glFramebufferRenderbuffer(
+		GL_FRAMEBUFFER,
+		GL_DEPTH_ATTACHMENT,
+		GL_RENDERBUFFER,
+		headless.depth
+	);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE || glGetError() != GL_NO_ERROR) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		errf(ERR_OPENGL, "offscreen framebuffer incomplete");
+		return 0;
+	}
+	glViewport(0, 0, width, height);
+
+	return 1;
+}
+
+int
+renderer_init_headless(unsigned width, unsigned height)
+{
+	assert(!headless.active);
+	assert(width > 0 && height > 0);
+
+#ifdef HAVE_EGL
+	headless.display = EGL_NO_DISPLAY;
+	headless.context = EGL_NO_CONTEXT;
+	headless.active = 1;
+
+	if (!init_context()) {
+		goto error;
+	}
+	// a failed renderer initialization has already shut everything down,
+	// the context included
+	if (!renderer_init()) {
+		errf(ERR_GENERIC, "headless renderer initialization failed");
+		return 0;
+	}
+	if (!init_framebuffer(width, height)) {
+		goto error;
+	}
+	set_target_framebuffer(headless.fbo);
+
+	return 1;
+
+error:
+	errf(ERR_GENERIC, "headless renderer initialization failed");
+	renderer_shutdown();
+	return 0;
+#else
+	errf(ERR_GENERIC, "renderer built without EGL support");
+	return 0;
+#endif
+}
+
+/**
+ * Release the resources of headless mode, if active.
+ *
+ * Called last by `renderer_shutdown()`, as the context must outlive all
+ * other OpenGL objects.
+ */
+void
+shutdown_headless(void)
+{
+	if (!headless.active) {
+		return;
+	}
+	// OpenGL entry points are not loaded if initialization failed early
+	if (headless.fbo) {
+		set_target_framebuffer(0);
+		glDeleteFramebuffers(1, &headless.fbo);
+		glDeleteRenderbuffers(1, &headless.color);
+		glDeleteRenderbuffers(1, &headless.depth);
+	}
+	headless.fbo = headless.color = headless.depth = 0;
+#ifdef HAVE_EGL
+	free_context();
+#endif
+	headless.active = 0;
+}
@@ -1,6 +1,7 @@
 #include "error.h"
 #include "file_utils.h"
 #include "image.h"
+#include "trace.h"
 #include <assert.h>
 #include <jerror.h>
 #include <jpeglib.h>
@@ -267,12 +268,14 @@ image_from_buffer(const void *data, size_t size, int codec)
 		.size = size,
 		.offset = 0
 	};
+	TRACE_BEGIN("load", "image_from_buffer");
 	image->data = reader(
 		&buffer,
 		&image->width,
 		&image->height,
 		&image->format
 	);
+	TRACE_END();
 	if (!image->data) {
 		err(ERR_INVALID_IMAGE);
 		image_free(image);
@@ -298,9 +301,11 @@ image_from_file(const char *filename)
 	}
 
 	// read file contents
+	TRACE_BEGIN("load", "image_from_file");
 	char *data = NULL;
 	size_t size = file_read(filename, &data);
 	if (!size) {
+		TRACE_END();
 		return NULL;
 	}
 
@@ -309,6 +314,7 @@ image_from_file(const char *filename)
 
 	free(data);
 
+	TRACE_END();
 	return image;
 }
 
@@ -4,15 +4,25 @@
 #include "anim.h"
 #include "error.h"
 #include "file_utils.h"
+#include "gl_api.h"
 #include "mesh.h"
+#include "mesh_optimize.h"
+#include "renderlib.h"
+#include "stats.h"
+#include "trace.h"
 #include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define VERSION_MAJOR 1
-#define VERSION_MINOR 0
-#define MESH_VERSION (VERSION_MINOR << 4 | VERSION_MAJOR)
+#define MESH_VERSION(major, minor) ((minor) << 4 | (major))
 
+// worker threads reading and processing meshes loaded in the background
+#define MESH_LOAD_THREADS 2
+
+// format v1, tightly packed
 #define HEADER_SIZE 78
 #define POSITION_ATTRIB_SIZE 12
 #define NORMAL_ATTRIB_SIZE 12
@@ -31,6 +41,27 @@
 #define ACOUNT_FIELD    uint16_t, 12
 #define TRANSFORM_FIELD Mat,      14
 
+// format v2, with 16 byte aligned sections and packed vertex attributes
+#define V2_HEADER_SIZE 112
+#define V2_ALIGNMENT 16
+#define V2_POSITION_ATTRIB_SIZE 8
+#define V2_NORMAL_ATTRIB_SIZE 4
+#define V2_UV_ATTRIB_SIZE 4
+#define V2_JOINT_SIZE 80
+#define V2_ANIM_SIZE 16
+#define V2_POSE_SIZE 48
+
+#define V2_JCOUNT_FIELD    uint8_t,  1
+#define V2_FORMAT_FIELD    uint16_t, 2
+#define V2_VCOUNT_FIELD    uint32_t, 4
+#define V2_ICOUNT_FIELD    uint32_t, 8
+#define V2_ACOUNT_FIELD    uint16_t, 12
+#define V2_SCALE_FIELD     Vec,      16
+#define V2_OFFSET_FIELD    Vec,      32
+#define V2_TRANSFORM_FIELD Mat,      48
+
+#define align(offset) (((offset) + V2_ALIGNMENT - 1) & ~(size_t)(V2_ALIGNMENT - 1))
+
 #define invoke(macro, ...) macro(__VA_ARGS__)
 #define cast(data, type, offset) (*(type*)(((char*)data) + offset))
 #define get_field(data, field) invoke(cast, data, field)
@@ -50,9 +81,124 @@ enum {
 	VERTEX_HAS_JOINTS    = 1 << 3
 };
 
+/**
+ * Read the local space position of a vertex entry.
+ */
+static void
+read_position(const struct Mesh *m, const char *vertex, float pos[3])
+{
+	if (!m->packed) {
+		memcpy(pos, vertex, POSITION_ATTRIB_SIZE);
+		return;
+	}
+
+	// snorm16 to float conversion, as done by OpenGL for normalized
+	// attributes
+	int16_t q[3];
+	memcpy(q, vertex, sizeof(q));
+	for (int c = 0; c < 3; c++) {
+		float v = q[c] / 32767.0f;
+		v = v < -1.0f ? -1.0f : v;
+		pos[c] = v * m->position_scale.data[c] + m->position_offset.data[c];
+	}
+}
+
+static void
+compute_bounds(struct Mesh *m, const void *vdata)
+{
+	// positions come first in each vertex entry
+	const char *vertex = vdata;
+	float min[3], max[3];
+	read_position(m, vertex, min);
+	memcpy(max, min, sizeof(max));
+	for (size_t i = 1; i < m->vertex_count; i++) {
+		float pos[3];
+		read_position(m, vertex + i * m->vertex_size, pos);
+		for (int c = 0; c < 3; c++) {
+			min[c] = pos[c] < min[c] ? pos[c] : min[c];
+			max[c] = pos[c] > max[c] ? pos[c] : max[c];
+		}
+	}
+	m->bounds.min = vec(min[0], min[1], min[2], 1);
+	m->bounds.max = vec(max[0], max[1], max[2], 1);
+
+	// center the sphere on the box and fit its radius to the farthest
+	// vertex, which is tighter than the half diagonal
+	float center[3], radius_sqr = 0;
+	for (int c = 0; c < 3; c++) {
+		center[c] = (min[c] + max[c]) * 0.5f;
+	}
+	for (size_t i = 0; i < m->vertex_count; i++) {
+		float pos[3], d = 0;
+		read_position(m, vertex + i * m->vertex_size, pos);
+		for (int c = 0; c < 3; c++) {
+			d += (pos[c] - center[c]) * (pos[c] - center[c]);
+		}
+		radius_sqr = d > radius_sqr ? d : radius_sqr;
+	}
+	m->bounds.center = vec(center[0], center[1], center[2], 1);
+	m->bounds.radius = sqrtf(radius_sqr);
+}
+
+/**
+ * Narrow 32 bit indices to 16 bit ones.
+ *
+ * Returns NULL if any index does not fit or on allocation failure, in which
+ * case indices are better uploaded as they are.
+ */
+static uint16_t*
+narrow_indices(const void *idata, size_t count)
+{
+	uint16_t *narrow = malloc(count * sizeof(uint16_t));
+	if (!narrow) {
+		return NULL;
+	}
+	for (size_t i = 0; i < count; i++) {
+		// v1 files don't align the index section
+		uint32_t index;
+		memcpy(&index, (const char*)idata + i * INDEX_SIZE, INDEX_SIZE);
+		if (index > UINT16_MAX) {
+			free(narrow);
+			return NULL;
+		}
+		narrow[i] = index;
+	}
+	return narrow;
+}
+
+/**
+ * Vertex and index data of a mesh, as uploaded to its OpenGL buffers.
+ *
+ * Data points into the buffer the mesh was parsed from, or to copies made
+ * while processing it, which are owned and freed by `mesh_data_free()`.
+ */
+struct MeshData {
+	const void *vertices;
+	const void *indices;          // of the mesh index type
+	size_t vertex_bytes;
+	size_t index_bytes;
+	void *owned_vertices;
+	void *owned_indices;
+	void *narrow_indices;
+};
+
+static void
+mesh_data_free(struct MeshData *d)
+{
+	free(d->owned_vertices);
+	free(d->owned_indices);
+	free(d->narrow_indices);
+	memset(d, 0, sizeof(struct MeshData));
+}
 
+/**
+ * Create the OpenGL objects of a mesh.
+ *
+ * Buffers are initialized with the contents of `d` if `upload` is set, or
+ * just allocated otherwise, for the contents to be streamed in later.
+ */
 static int
-init_gl_objects(struct Mesh *m, void *vdata, void *idata)
+init_gl_objects(struct Mesh *m, const struct MeshData *d, int upload)
 {
 	int result = 1;
 
@@ -78,54 +224,58 @@ init_gl_objects(struct Mesh *m, void *vdata, void *idata)
 	glBindBuffer(GL_ARRAY_BUFFER, m->vbo);
 	glBufferData(
 		GL_ARRAY_BUFFER,
-		m->vertex_count * m->vertex_size,
-		vdata,
+		d->vertex_bytes,
+		upload ? d->vertices : NULL,
 		GL_STATIC_DRAW
 	);
 	if (glGetError() != GL_NO_ERROR) {
 		err(ERR_OPENGL);
 		goto error;
 	}
+	m->buffer_bytes += d->vertex_bytes;
+	mem_track(RENDER_MEMORY_MESH, MEM_GPU, d->vertex_bytes);
 
-	// enable coord attribute
+	// enable coord attribute; packed positions are snorm16, with 2 bytes of
+	// padding
 	glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
 	size_t offset = 0;
 	glVertexAttribPointer(
 		VERTEX_ATTRIB_POSITION,
 		3,
-		GL_FLOAT,
-		GL_FALSE,
+		m->packed ? GL_SHORT : GL_FLOAT,
+		m->packed ? GL_TRUE : GL_FALSE,
 		m->vertex_size,
 		(void*)(offset)
 	);
-	offset += 12;
+	offset += m->packed ? V2_POSITION_ATTRIB_SIZE : POSITION_ATTRIB_SIZE;
 
-	// enable normal attribute
+	// enable normal attribute; packed normals are two snorm16 octahedral
+	// coordinates, decoded by shaders
 	if (m->vertex_format & VERTEX_HAS_NORMAL) {
 		glEnableVertexAttribArray(VERTEX_ATTRIB_NORMAL);
 		glVertexAttribPointer(
 			VERTEX_ATTRIB_NORMAL,
-			3,
-			GL_FLOAT,
-			GL_FALSE,
+			m->packed ? 2 : 3,
+			m->packed ? GL_SHORT : GL_FLOAT,
+			m->packed ? GL_TRUE : GL_FALSE,
 			m->vertex_size,
 			(void*)(offset)
 		);
-		offset += 12;
+		offset += m->packed ? V2_NORMAL_ATTRIB_SIZE : NORMAL_ATTRIB_SIZE;
 	}
 
-	// enable UV attribute
+	// enable UV attribute; packed UVs are unorm16
 	if (m->vertex_format & VERTEX_HAS_UV) {
 		glEnableVertexAttribArray(VERTEX_ATTRIB_UV);
 		glVertexAttribPointer(
 			VERTEX_ATTRIB_UV,
 			2,
-			GL_FLOAT,
-			GL_FALSE,
+			m->packed ? GL_UNSIGNED_SHORT : GL_FLOAT,
+			m->packed ? GL_TRUE : GL_FALSE,
 			m->vertex_size,
 			(void*)(offset)
 		);
-		offset += 8;
+		offset += m->packed ? V2_UV_ATTRIB_SIZE : UV_ATTRIB_SIZE;
 	}
 
 	// initialize joint ID and weight attributes
@@ -156,15 +306,16 @@ init_gl_objects(struct Mesh *m, void *vdata, void *idata)
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->ibo);
 	glBufferData(
 		GL_ELEMENT_ARRAY_BUFFER,
-		m->index_count * 4,
-		idata,
+		d->index_bytes,
+		upload ? d->indices : NULL,
 		GL_STATIC_DRAW
 	);
-
 	if (glGetError() != GL_NO_ERROR) {
 		err(ERR_OPENGL);
 		goto error;
 	}
+	m->buffer_bytes += d->index_bytes;
+	mem_track(RENDER_MEMORY_MESH, MEM_GPU, d->index_bytes);
 
 cleanup:
 	// reset the context
@@ -181,12 +332,15 @@ error:
 struct Mesh*
 mesh_from_file(const char *filename)
 {
-	// read file contents into a buffer
-	char *data = NULL;
+	// map file contents, so that vertex and index data are uploaded straight
+	// from the page cache
+	const void *data = NULL;
 	size_t size = 0;
 	struct Mesh *mesh = NULL;
-	if ((size = file_read(filename, &data)) == 0) {
+	TRACE_BEGIN("load", "mesh_from_file");
+	if (!(data = file_map(filename, &size))) {
 		errf(ERR_INVALID_MESH, "%s", filename);
+		TRACE_END();
 		return NULL;
 	}
 
@@ -195,29 +349,43 @@ mesh_from_file(const char *filename)
 	mesh = mesh_from_buffer(data, size);
 
 	// cleanup
-	free(data);
+	file_unmap(data, size);
 
+	TRACE_END();
 	return mesh;
 }
 
 
-struct Mesh*
-mesh_from_buffer(const void *data, size_t size)
+/**
+ * Allocate skeleton or animation data of a mesh, accounting for it.
+ */
+static void*
+anim_alloc(struct Mesh *m, size_t size)
 {
-	struct Mesh *m = NULL;
-	void *vertex_data = NULL;
-	void *index_data = NULL;
-
-	// initialize mesh struct
-	if (!(m = malloc(sizeof(struct Mesh)))) {
-		err(ERR_NO_MEM);
-		goto error;
+	void *ptr = malloc(size);
+	if (ptr) {
+		m->anim_bytes += size;
+		mem_track(RENDER_MEMORY_ANIMATION, MEM_CPU, size);
 	}
-	memset(m, 0, sizeof(struct Mesh));
+	return ptr;
+}
+
+/**
+ * Parse the contents of a v1 mesh file.
+ */
+static int
+parse_v1(
+	struct Mesh *m,
+	const void *data,
+	size_t size,
+	const void **r_vertex_data,
+	const void **r_index_data
+) {
+	const void *vertex_data = NULL;
+	const void *index_data = NULL;
 
 	// header sanity check
-	if (size < HEADER_SIZE ||
-	    get_field(data, VERSION_FIELD) != MESH_VERSION) {
+	if (size < HEADER_SIZE) {
 		err(ERR_INVALID_MESH);
 		goto error;
 	}
@@ -251,30 +419,22 @@ mesh_from_buffer(const void *data, size_t size)
 
 	size_t offset = HEADER_SIZE;
 
-	// initialize vertex data buffer
+	// locate vertex data
 	size_t vsize = m->vertex_count * m->vertex_size;
 	if (size < offset + vsize) {
 		err(ERR_INVALID_MESH);
 		goto error;
 	}
-	if (!(vertex_data = malloc(vsize))) {
-		err(ERR_NO_MEM);
-		goto error;
-	}
-	memcpy(vertex_data, data + offset, vsize);
+	vertex_data = data + offset;
 	offset += vsize;
 
-	// initialize index data buffer
+	// locate index data
 	size_t isize = m->index_count * INDEX_SIZE;
 	if (size < offset + isize) {
 		err(ERR_INVALID_MESH);
 		goto error;
 	}
-	if (!(index_data = malloc(isize))) {
-		err(ERR_NO_MEM);
-		goto error;
-	}
-	memcpy(index_data, data + offset, isize);
+	index_data = data + offset;
 	offset += isize;
 
 	// build the skeleton
@@ -286,8 +446,8 @@ mesh_from_buffer(const void *data, size_t size)
 			goto error;
 		}
 
-		if (!(m->skeleton = malloc(sizeof(struct Skeleton))) ||
-		    !(m->skeleton->joints = malloc(sizeof(struct Joint) * joint_count))) {
+		if (!(m->skeleton = anim_alloc(m, sizeof(struct Skeleton))) ||
+		    !(m->skeleton->joints = anim_alloc(m, sizeof(struct Joint) * joint_count))) {
 			err(ERR_NO_MEM);
 			goto error;
 		}
@@ -307,7 +467,7 @@ mesh_from_buffer(const void *data, size_t size)
 	// initialize animations (if there's a skeleton)
 	m->anim_count = get_field(data, ACOUNT_FIELD);
 	if (m->skeleton && m->anim_count > 0) {
-		m->animations = malloc(sizeof(struct Animation) * m->anim_count);
+		m->animations = anim_alloc(m, sizeof(struct Animation) * m->anim_count);
 		if (!m->animations) {
 			err(ERR_NO_MEM);
 			goto error;
@@ -323,7 +483,7 @@ mesh_from_buffer(const void *data, size_t size)
 			offset += ANIM_SIZE;
 
 			// read timestamps
-			anim->timestamps = malloc(sizeof(float) * anim->pose_count);
+			anim->timestamps = anim_alloc(m, sizeof(float) * anim->pose_count);
 			if (!anim->timestamps) {
 				err(ERR_NO_MEM);
 				// TODO: free timestamp data
@@ -335,7 +495,7 @@ mesh_from_buffer(const void *data, size_t size)
 			}
 
 			// read skeleton poses
-			anim->poses = malloc(sizeof(struct SkeletonPose) * anim->pose_count);
+			anim->poses = anim_alloc(m, sizeof(struct SkeletonPose) * anim->pose_count);
 			if (!anim->poses) {
 				err(ERR_NO_MEM);
 				// TODO: free animation data
@@ -345,7 +505,8 @@ mesh_from_buffer(const void *data, size_t size)
 				struct SkeletonPose *sp = anim->poses + p;
 				sp->skeleton = m->skeleton;
 
-				sp->joint_poses = malloc(
+				sp->joint_poses = anim_alloc(
+					m,
 					sizeof(struct JointPose) * m->skeleton->joint_count
 				);
 				if (!sp->skeleton || !sp->joint_poses) {
@@ -386,19 +547,434 @@ mesh_from_buffer(const void *data, size_t size)
 		}
 	}
 
-	if (!init_gl_objects(m, vertex_data, index_data)) {
-		goto error;
+	*r_vertex_data = vertex_data;
+	*r_index_data = index_data;
+	return 1;
+
+error:
+	return 0;
+}
+
+/**
+ * Parse the contents of a v2 mesh file.
+ */
+static int
+parse_v2(
+	struct Mesh *m,
+	const void *data,
+	size_t size,
+	const void **r_vertex_data,
+	const void **r_index_data
+) {
+	// header sanity check
+	if (size < V2_HEADER_SIZE) {
+		err(ERR_INVALID_MESH);
+		return 0;
 	}
 
-cleanup:
-	free(index_data);
-	free(vertex_data);
+	// parse the header and check for vertices and indices
+	m->packed = 1;
+	m->vertex_format = get_field(data, V2_FORMAT_FIELD);
+	m->vertex_count = get_field(data, V2_VCOUNT_FIELD);
+	m->index_count = get_field(data, V2_ICOUNT_FIELD);
+	if (!(m->vertex_format & VERTEX_HAS_POSITION) ||
+	    m->vertex_count == 0 ||
+	    m->index_count == 0) {
+		err(ERR_INVALID_MESH);
+		return 0;
+	}
+	m->position_scale = get_field(data, V2_SCALE_FIELD);
+	m->position_offset = get_field(data, V2_OFFSET_FIELD);
+	m->transform = get_field(data, V2_TRANSFORM_FIELD);
+
+	m->vertex_size = V2_POSITION_ATTRIB_SIZE;
+	if (m->vertex_format & VERTEX_HAS_NORMAL) {
+		m->vertex_size += V2_NORMAL_ATTRIB_SIZE;
+	}
+	if (m->vertex_format & VERTEX_HAS_UV) {
+		m->vertex_size += V2_UV_ATTRIB_SIZE;
+	}
+	if (m->vertex_format & VERTEX_HAS_JOINTS) {
+		m->vertex_size += JOINT_ATTRIB_SIZE;
+	}
+
+	// locate vertex and index data, each section starts aligned
+	size_t offset = V2_HEADER_SIZE;
+	size_t vsize = m->vertex_count * m->vertex_size;
+	if (size < offset + vsize) {
+		err(ERR_INVALID_MESH);
+		return 0;
+	}
+	*r_vertex_data = data + offset;
+	offset = align(offset + vsize);
+
+	size_t isize = m->index_count * INDEX_SIZE;
+	if (size < offset + isize) {
+		err(ERR_INVALID_MESH);
+		return 0;
+	}
+	*r_index_data = data + offset;
+	offset = align(offset + isize);
+
+	// build the skeleton, joints are stored in ID order
+	if (m->vertex_format & VERTEX_HAS_JOINTS) {
+		size_t joint_count = get_field(data, V2_JCOUNT_FIELD);
+		if (size < offset + joint_count * V2_JOINT_SIZE) {
+			err(ERR_INVALID_MESH);
+			return 0;
+		}
+		if (!(m->skeleton = anim_alloc(m, sizeof(struct Skeleton))) ||
+		    !(m->skeleton->joints = anim_alloc(m, sizeof(struct Joint) * joint_count))) {
+			err(ERR_NO_MEM);
+			return 0;
+		}
+		m->skeleton->joint_count = joint_count;
+
+		for (size_t j = 0; j < joint_count; j++) {
+			struct Joint *joint = &m->skeleton->joints[j];
+			joint->inv_bind_pose = cast(data, Mat, offset);
+			joint->parent = cast(data, uint8_t, offset + 64);
+			offset += V2_JOINT_SIZE;
+		}
+	}
+
+	// initialize animations (if there's a skeleton)
+	size_t anim_count = get_field(data, V2_ACOUNT_FIELD);
+	if (!m->skeleton || anim_count == 0) {
+		return 1;
+	}
+	m->animations = anim_alloc(m, sizeof(struct Animation) * anim_count);
+	if (!m->animations) {
+		err(ERR_NO_MEM);
+		return 0;
+	}
+
+	size_t joint_count = m->skeleton->joint_count;
+	for (size_t a = 0; a < anim_count; a++) {
+		struct Animation *anim = &m->animations[a];
+		if (size < offset + V2_ANIM_SIZE) {
+			err(ERR_INVALID_MESH);
+			return 0;
+		}
+		anim->skeleton = m->skeleton;
+		anim->duration = cast(data, float, offset);
+		anim->speed = cast(data, float, offset + 4);
+		anim->pose_count = cast(data, uint32_t, offset + 8);
+		anim->timestamps = NULL;
+		anim->poses = NULL;
+		m->anim_count++;
+		offset += V2_ANIM_SIZE;
+
+		// check the whole animation is there, before allocating for it
+		size_t tsize = align(sizeof(float) * anim->pose_count);
+		size_t psize = anim->pose_count * joint_count * V2_POSE_SIZE;
+		if (size < offset + tsize + psize) {
+			err(ERR_INVALID_MESH);
+			return 0;
+		}
+
+		// timestamps are laid out as in memory
+		anim->timestamps = anim_alloc(m, sizeof(float) * anim->pose_count);
+		anim->poses = anim_alloc(m, sizeof(struct SkeletonPose) * anim->pose_count);
+		if (!anim->timestamps || !anim->poses) {
+			err(ERR_NO_MEM);
+			return 0;
+		}
+		memcpy(anim->timestamps, data + offset, sizeof(float) * anim->pose_count);
+		for (size_t p = 0; p < anim->pose_count; p++) {
+			anim->poses[p].skeleton = m->skeleton;
+			anim->poses[p].joint_poses = NULL;
+		}
+		offset += tsize;
+
+		// read skeleton poses, joint poses are stored in joint ID order
+		for (size_t p = 0; p < anim->pose_count; p++) {
+			struct SkeletonPose *sp = &anim->poses[p];
+			sp->joint_poses = anim_alloc(m, sizeof(struct JointPose) * joint_count);
+			if (!sp->joint_poses) {
+				err(ERR_NO_MEM);
+				return 0;
+			}
+			for (size_t j = 0; j < joint_count; j++) {
+				const float *t = &cast(data, float, offset);
+				const float *r = &cast(data, float, offset + 16);
+				const float *s = &cast(data, float, offset + 32);
+				struct JointPose *jp = &sp->joint_poses[j];
+				jp->trans = vec(t[0], t[1], t[2], 0);
+				jp->rot = qtr(r[0], r[1], r[2], r[3]);
+				jp->scale = vec(s[0], s[1], s[2], 0);
+				offset += V2_POSE_SIZE;
+			}
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Parse a mesh out of a buffer, without creating OpenGL objects.
+ *
+ * Vertex and index data are returned as pointers to their sections in the
+ * buffer, in the layout OpenGL expects them, thus they are valid as long as
+ * the buffer is. Joints and animations are decoded into mesh structs. Format
+ * v2 sections are aligned relative to the start of the buffer, which should
+ * be 16 byte aligned itself.
+ */
+struct Mesh*
+mesh_parse(const void *data, size_t size, const void **r_vertex_data, const void **r_index_data)
+{
+	struct Mesh *m = malloc(sizeof(struct Mesh));
+	if (!m) {
+		err(ERR_NO_MEM);
+		return NULL;
+	}
+	memset(m, 0, sizeof(struct Mesh));
+	mem_track(RENDER_MEMORY_MESH, MEM_CPU, sizeof(struct Mesh));
+	m->position_scale = vec(1, 1, 1, 0);
+	m->position_offset = vec(0, 0, 0, 0);
+
+	int ok = 0;
+	int version = size > 0 ? get_field(data, VERSION_FIELD) : 0;
+	if (version == MESH_VERSION(1, 0)) {
+		ok = parse_v1(m, data, size, r_vertex_data, r_index_data);
+	} else if (version == MESH_VERSION(2, 0)) {
+		ok = parse_v2(m, data, size, r_vertex_data, r_index_data);
+	} else {
+		err(ERR_INVALID_MESH);
+	}
+	if (!ok) {
+		mesh_free(m);
+		return NULL;
+	}
+
+	m->lods[0].index_count = m->index_count;
+	m->lod_count = 1;
+	compute_bounds(m, *r_vertex_data);
 	return m;
+}
 
-error:
-	mesh_free(m);
-	m = NULL;
-	goto cleanup;
+static void
+read_positions(const struct Mesh *m, const char *vertices, float (*positions)[3])
+{
+	for (size_t v = 0; v < m->vertex_count; v++) {
+		read_position(m, vertices + v * m->vertex_size, positions[v]);
+	}
+}
+
+/**
+ * Simplify each level of detail from the previous one, appending them to the
+ * index array, which must have room for MESH_MAX_LODS times the full mesh.
+ *
+ * Generation stops early at levels which would not save enough.
+ */
+static int
+generate_lods(
+	struct Mesh *m,
+	uint32_t *indices,
+	const float (*positions)[3],
+	size_t lod_count,
+	int optimize
+) {
+	for (size_t l = 1; l < lod_count; l++) {
+		size_t prev_offset = m->lods[l - 1].index_offset;
+		size_t prev_count = m->lods[l - 1].index_count;
+		size_t offset = prev_offset + prev_count;
+		size_t count;
+		float error;
+		int ok = simplify_mesh(
+			indices + offset,
+			indices + prev_offset,
+			prev_count,
+			positions,
+			m->vertex_count,
+			prev_count / 2 / 3 * 3,
+			&count,
+			&error
+		);
+		if (!ok) {
+			return 0;
+		} else if (count > prev_count * 3 / 4) {
+			break;
+		}
+		if (optimize && !optimize_vertex_cache(indices + offset, count, m->vertex_count)) {
+			return 0;
+		}
+
+		// errors add up as levels derive from each other
+		m->lods[l].index_offset = offset;
+		m->lods[l].index_count = count;
+		m->lods[l].error = m->lods[l - 1].error + error;
+		m->lod_count = l + 1;
+	}
+	return 1;
+}
+
+/**
+ * Weld duplicate vertices, reorder triangles for vertex cache hits and
+ * overdraw if `optimize` is set, and vertices for fetch locality, then
+ * generate up to `lod_count` levels of detail, into copies of mesh data.
+ *
+ * The vertex count of the mesh is updated to the welded one.
+ */
+static int
+optimize_mesh(
+	struct Mesh *m,
+	const void *vdata,
+	const void *idata,
+	int optimize,
+	size_t lod_count,
+	void **r_vertex_data,
+	uint32_t **r_index_data
+) {
+	int ok = 0;
+	float (*positions)[3] = malloc(m->vertex_count * sizeof(*positions));
+	char *vertices = malloc(m->vertex_count * m->vertex_size);
+	uint32_t *indices = malloc(m->index_count * MESH_MAX_LODS * sizeof(uint32_t));
+	if (!positions || !vertices || !indices) {
+		err(ERR_NO_MEM);
+		goto cleanup;
+	}
+	memcpy(vertices, vdata, m->vertex_count * m->vertex_size);
+	memcpy(indices, idata, m->index_count * sizeof(uint32_t));
+
+	// optimizers index vertex arrays, thus indices are trusted no further
+	for (size_t i = 0; i < m->index_count; i++) {
+		if (indices[i] >= m->vertex_count) {
+			err(ERR_INVALID_MESH);
+			goto cleanup;
+		}
+	}
+
+	if (!weld_vertices(vertices, m->vertex_size, m->vertex_count, indices, m->index_count)) {
+		goto cleanup;
+	}
+	if (optimize) {
+		read_positions(m, vertices, positions);
+		if (!optimize_vertex_cache(indices, m->index_count, m->vertex_count) ||
+		    !optimize_overdraw(indices, m->index_count, positions, m->vertex_count)) {
+			goto cleanup;
+		}
+	}
+	if (!optimize_vertex_fetch(vertices, m->vertex_size, &m->vertex_count, indices, m->index_count)) {
+		goto cleanup;
+	}
+
+	read_positions(m, vertices, positions);
+	if (!generate_lods(m, indices, positions, lod_count, optimize)) {
+		goto cleanup;
+	}
+	ok = 1;
+
+cleanup:
+	free(positions);
+	if (!ok) {
+		free(vertices);
+		free(indices);
+		return 0;
+	}
+	*r_vertex_data = vertices;
+	*r_index_data = indices;
+	return 1;
+}
+
+/**
+ * Process parsed vertex and index data into the buffer contents of a mesh.
+ *
+ * Meshes are optimized and given levels of detail as requested, then indices
+ * narrowed to 16 bits whenever they all fit. No OpenGL calls are made, thus
+ * this can run on any thread.
+ */
+static int
+prepare_mesh_data(
+	struct Mesh *m,
+	const void *vdata,
+	const void *idata,
+	int optimize,
+	int lod_count,
+	struct MeshData *d
+) {
+	memset(d, 0, sizeof(struct MeshData));
+
+	// optimized data replaces the parsed one, which stays in the buffer
+	if (optimize || lod_count > 1) {
+		TRACE_BEGIN("load", "optimize_mesh");
+		uint32_t *indices = NULL;
+		int ok = optimize_mesh(
+			m,
+			vdata,
+			idata,
+			optimize,
+			lod_count,
+			&d->owned_vertices,
+			&indices
+		);
+		TRACE_END();
+		if (!ok) {
+			return 0;
+		}
+		d->owned_indices = indices;
+		vdata = d->owned_vertices;
+		idata = indices;
+	}
+
+	// measured on the final index order of the full resolution mesh, only
+	// when optimizing as it costs a cache simulation pass over the indices
+	m->vertex_cache.acmr = m->vertex_cache.atvr = -1;
+	if (optimize) {
+		struct VertexCacheStats stats;
+		if (!vertex_cache_stats(idata, m->index_count, m->vertex_count, &stats)) {
+			mesh_data_free(d);
+			return 0;
+		}
+		m->vertex_cache.acmr = stats.acmr;
+		m->vertex_cache.atvr = stats.atvr;
+	}
+
+	// index data holds all levels of detail, with 16 bit indices whenever
+	// they all fit, which is the case of any mesh of up to 65536 vertices
+	size_t last = m->lod_count - 1;
+	size_t index_count = m->lods[last].index_offset + m->lods[last].index_count;
+	m->index_type = GL_UNSIGNED_INT;
+	d->index_bytes = index_count * INDEX_SIZE;
+	if (m->vertex_count <= UINT16_MAX + 1 &&
+	    (d->narrow_indices = narrow_indices(idata, index_count))) {
+		m->index_type = GL_UNSIGNED_SHORT;
+		d->index_bytes = index_count * sizeof(uint16_t);
+		idata = d->narrow_indices;
+	}
+	d->vertices = vdata;
+	d->indices = idata;
+	d->vertex_bytes = m->vertex_count * m->vertex_size;
+	return 1;
+}
+
+struct Mesh*
+mesh_from_buffer(const void *data, size_t size)
+{
+	const void *vertex_data = NULL;
+	const void *index_data = NULL;
+	TRACE_BEGIN("load", "mesh_from_buffer");
+	struct Mesh *m = mesh_parse(data, size, &vertex_data, &index_data);
+
+	if (m) {
+		struct MeshData d;
+		int ok = prepare_mesh_data(
+			m,
+			vertex_data,
+			index_data,
+			renderer_get_option(RENDER_OPTION_OPTIMIZE_MESHES),
+			renderer_get_option(RENDER_OPTION_MESH_LODS),
+			&d
+		);
+		ok = ok && init_gl_objects(m, &d, 1);
+		mesh_data_free(&d);
+		if (!ok) {
+			mesh_free(m);
+			m = NULL;
+		}
+	}
+	TRACE_END();
+	return m;
 }
 
 struct Mesh*
@@ -462,15 +1038,27 @@ mesh_new(
 		goto error;
 	}
 	memset(m, 0, sizeof(struct Mesh));
+	mem_track(RENDER_MEMORY_MESH, MEM_CPU, sizeof(struct Mesh));
 
 	m->vertex_format = vertex_format;
 	m->vertex_size = vertex_size;
 	m->vertex_count = vertex_count;
 	m->index_count = index_count;
+	m->lods[0].index_count = index_count;
+	m->lod_count = 1;
 	m->vertex_format = vertex_format;
+	m->position_scale = vec(1, 1, 1, 0);
+	m->position_offset = vec(0, 0, 0, 0);
 	mat_ident(&m->transform);
+	compute_bounds(m, vertex_data);
 
-	if (!init_gl_objects(m, vertex_data, indices)) {
+	struct MeshData d;
+	if (!prepare_mesh_data(m, vertex_data, indices, 0, 1, &d)) {
+		goto error;
+	}
+	int ok = init_gl_objects(m, &d, 1);
+	mesh_data_free(&d);
+	if (!ok) {
 		goto error;
 	}
 
@@ -485,15 +1073,22 @@ void
 mesh_free(struct Mesh *m)
 {
 	if (m) {
-		// destroy OpenGL objects
-		glDeleteVertexArrays(1, &m->vao);
-		glDeleteBuffers(1, &m->vbo);
-		glDeleteBuffers(1, &m->ibo);
+		// destroy OpenGL objects, if any were created
+		if (m->vao) {
+			glDeleteVertexArrays(1, &m->vao);
+		}
+		if (m->vbo) {
+			glDeleteBuffers(1, &m->vbo);
+		}
+		if (m->ibo) {
+			glDeleteBuffers(1, &m->ibo);
+		}
+		mem_track(RENDER_MEMORY_MESH, MEM_GPU, -(ptrdiff_t)m->buffer_bytes);
 
 		// free animations
-		for (size_t a = 0; a < m->anim_count; a++) {
+		for (size_t a = 0; m->animations && a < m->anim_count; a++) {
 			struct Animation anim = m->animations[a];
-			for (size_t p = 0; p < anim.pose_count; p++) {
+			for (size_t p = 0; anim.poses && p < anim.pose_count; p++) {
 				free(anim.poses[p].joint_poses);
 			}
 			free(anim.poses);
@@ -506,7 +1101,365 @@ mesh_free(struct Mesh *m)
 			free(m->skeleton->joints);
 			free(m->skeleton);
 		}
+		mem_track(RENDER_MEMORY_ANIMATION, MEM_CPU, -(ptrdiff_t)m->anim_bytes);
 
 		free(m);
+		mem_track(RENDER_MEMORY_MESH, MEM_CPU, -(ptrdiff_t)sizeof(struct Mesh));
+	}
+}
+
+/**
+ * Mesh loaded in the background.
+ *
+ * Loads go through the job queue, where workers read and process them, then
+ * the upload queue, drained by the render thread. Fields shared between
+ * threads are guarded by `load_lock`, the others belong to whichever thread
+ * holds the load.
+ */
+struct MeshLoad {
+	char *filename;
+	int optimize;                 // RENDER_OPTION_OPTIMIZE_MESHES at request
+	int lod_count;                // RENDER_OPTION_MESH_LODS at request
+	int status;                   // MESH_LOAD_*, shared
+	int cancelled;                // abandoned by `mesh_load_finish()`, shared
+	struct ErrorTraceback *errors;// errors of the worker
+
+	struct Mesh *mesh;
+	const void *file_data;        // file mapping, data may point into it
+	size_t file_size;
+	struct MeshData data;
+	size_t uploaded;              // bytes of vertices, then indices, uploaded
+
+	struct MeshLoad *next;
+};
+
+struct MeshLoadQueue {
+	struct MeshLoad *head;
+	struct MeshLoad *tail;
+};
+
+static pthread_mutex_t load_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t load_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t load_threads[MESH_LOAD_THREADS];
+static size_t load_thread_count = 0;
+static int load_stop = 0;
+static struct MeshLoadQueue load_jobs = { NULL, NULL };
+static struct MeshLoadQueue load_uploads = { NULL, NULL };
+
+static void
+load_queue_push(struct MeshLoadQueue *q, struct MeshLoad *load)
+{
+	load->next = NULL;
+	if (q->tail) {
+		q->tail->next = load;
+	} else {
+		q->head = load;
+	}
+	q->tail = load;
+}
+
+static struct MeshLoad*
+load_queue_pop(struct MeshLoadQueue *q)
+{
+	struct MeshLoad *load = q->head;
+	if (load) {
+		q->head = load->next;
+		if (!q->head) {
+			q->tail = NULL;
+		}
+	}
+	return load;
+}
+
+/**
+ * Release what a load holds on to besides the mesh.
+ */
+static void
+release_mesh_load(struct MeshLoad *load)
+{
+	mesh_data_free(&load->data);
+	file_unmap(load->file_data, load->file_size);
+	load->file_data = NULL;
+}
+
+static void
+free_mesh_load(struct MeshLoad *load)
+{
+	release_mesh_load(load);
+	mesh_free(load->mesh);
+	free(load->errors);
+	free(load->filename);
+	free(load);
+}
+
+/**
+ * Read, parse and process the mesh of a load, on a worker thread.
+ */
+static int
+read_mesh_load(struct MeshLoad *load)
+{
+	TRACE_BEGIN("load", "read_mesh_load");
+	const void *vertex_data = NULL;
+	const void *index_data = NULL;
+	int ok = (
+		(load->file_data = file_map(load->filename, &load->file_size)) &&
+		(load->mesh = mesh_parse(
+			load->file_data,
+			load->file_size,
+			&vertex_data,
+			&index_data
+		)) &&
+		prepare_mesh_data(
+			load->mesh,
+			vertex_data,
+			index_data,
+			load->optimize,
+			load->lod_count,
+			&load->data
+		)
+	);
+	TRACE_END();
+	return ok;
+}
+
+static void*
+load_worker(void *arg)
+{
+	pthread_mutex_lock(&load_lock);
+	for (;;) {
+		while (!load_stop && !load_jobs.head) {
+			pthread_cond_wait(&load_cond, &load_lock);
+		}
+		if (load_stop) {
+			break;
+		}
+		struct MeshLoad *load = load_queue_pop(&load_jobs);
+		int cancelled = load->cancelled;
+		pthread_mutex_unlock(&load_lock);
+
+		// no OpenGL objects are created by workers, thus failed and
+		// abandoned loads can be freed right here
+		int ok = !cancelled && read_mesh_load(load);
+		if (!ok) {
+			release_mesh_load(load);
+			mesh_free(load->mesh);
+			load->mesh = NULL;
+			load->errors = error_detach_traceback();
+		}
+
+		pthread_mutex_lock(&load_lock);
+		if (load->cancelled) {
+			free_mesh_load(load);
+		} else if (!ok) {
+			load->status = MESH_LOAD_FAILED;
+		} else {
+			load_queue_push(&load_uploads, load);
+		}
+	}
+	pthread_mutex_unlock(&load_lock);
+	return NULL;
+}
+
+struct MeshLoad*
+mesh_load_async(const char *filename)
+{
+	assert(filename != NULL);
+
+	struct MeshLoad *load = malloc(sizeof(struct MeshLoad));
+	if (!load) {
+		err(ERR_NO_MEM);
+		return NULL;
+	}
+	memset(load, 0, sizeof(struct MeshLoad));
+	if (!(load->filename = string_fmt("%s", filename))) {
+		err(ERR_NO_MEM);
+		free(load);
+		return NULL;
+	}
+	load->optimize = renderer_get_option(RENDER_OPTION_OPTIMIZE_MESHES);
+	load->lod_count = renderer_get_option(RENDER_OPTION_MESH_LODS);
+	load->status = MESH_LOAD_PENDING;
+
+	// workers are started on first use and run until renderer shutdown
+	pthread_mutex_lock(&load_lock);
+	while (load_thread_count < MESH_LOAD_THREADS &&
+	       pthread_create(&load_threads[load_thread_count], NULL, load_worker, NULL) == 0) {
+		load_thread_count++;
+	}
+	if (load_thread_count == 0) {
+		pthread_mutex_unlock(&load_lock);
+		errf(ERR_GENERIC, "failed to start mesh load threads");
+		free_mesh_load(load);
+		return NULL;
+	}
+	load_queue_push(&load_jobs, load);
+	pthread_cond_signal(&load_cond);
+	pthread_mutex_unlock(&load_lock);
+
+	return load;
+}
+
+int
+mesh_load_status(struct MeshLoad *load)
+{
+	assert(load != NULL);
+
+	pthread_mutex_lock(&load_lock);
+	int status = load->status;
+	pthread_mutex_unlock(&load_lock);
+	return status;
+}
+
+struct Mesh*
+mesh_load_finish(struct MeshLoad *load)
+{
+	assert(load != NULL);
+
+	// pending loads are freed by whichever thread holds them next
+	pthread_mutex_lock(&load_lock);
+	int status = load->status;
+	if (status == MESH_LOAD_PENDING) {
+		load->cancelled = 1;
+	}
+	pthread_mutex_unlock(&load_lock);
+	if (status == MESH_LOAD_PENDING) {
+		return NULL;
+	}
+
+	struct Mesh *m = load->mesh;
+	if (status == MESH_LOAD_FAILED) {
+		error_attach_traceback(load->errors);
+		load->errors = NULL;
+		errf(ERR_INVALID_MESH, "%s", load->filename);
+	}
+	load->mesh = NULL;
+	free_mesh_load(load);
+	return m;
+}
+
+/**
+ * Upload up to `budget` bytes of the buffers of a load.
+ *
+ * OpenGL objects are created on the first call, then vertices and indices
+ * copied in chunks through the copy target, which leaves vertex array state
+ * alone. Returns the number of bytes uploaded, or -1 on failure.
+ */
+static ptrdiff_t
+upload_mesh_load(struct MeshLoad *load, size_t budget)
+{
+	struct Mesh *m = load->mesh;
+	const struct MeshData *d = &load->data;
+	if (!m->vao && !init_gl_objects(m, d, 0)) {
+		return -1;
+	}
+
+	size_t start = load->uploaded;
+	while (budget > 0 && load->uploaded < d->vertex_bytes + d->index_bytes) {
+		GLuint buffer = m->vbo;
+		const char *data = d->vertices;
+		size_t offset = load->uploaded;
+		size_t size = d->vertex_bytes;
+		if (offset >= d->vertex_bytes) {
+			buffer = m->ibo;
+			data = d->indices;
+			offset -= d->vertex_bytes;
+			size = d->index_bytes;
+		}
+		size_t chunk = size - offset < budget ? size - offset : budget;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, chunk, data + offset);
+		load->uploaded += chunk;
+		budget -= chunk;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (glGetError() != GL_NO_ERROR) {
+		errf(ERR_OPENGL, "%s", load->filename);
+		return -1;
+	}
+	stats_add(bytes_uploaded, load->uploaded - start);
+	return load->uploaded - start;
+}
+
+/**
+ * Upload the buffers of background loads, in request order, up to `budget`
+ * bytes. Called by `renderer_present()` on the render thread; upload errors
+ * are pushed to its traceback and fail the load.
+ */
+void
+upload_mesh_loads(size_t budget)
+{
+	while (budget > 0) {
+		pthread_mutex_lock(&load_lock);
+		struct MeshLoad *load = load_uploads.head;
+		int cancelled = load && load->cancelled;
+		pthread_mutex_unlock(&load_lock);
+		if (!load) {
+			break;
+		}
+
+		int done = 0;
+		int status = MESH_LOAD_DONE;
+		if (cancelled) {
+			done = 1;
+		} else {
+			ptrdiff_t uploaded = upload_mesh_load(load, budget);
+			if (uploaded < 0) {
+				mesh_free(load->mesh);
+				load->mesh = NULL;
+				status = MESH_LOAD_FAILED;
+				done = 1;
+			} else {
+				budget -= uploaded;
+				done = load->uploaded == load->data.vertex_bytes + load->data.index_bytes;
+			}
+		}
+		if (!done) {
+			break;
+		}
+
+		release_mesh_load(load);
+		pthread_mutex_lock(&load_lock);
+		load_queue_pop(&load_uploads);
+		cancelled = load->cancelled;
+		load->status = status;
+		pthread_mutex_unlock(&load_lock);
+		if (cancelled) {
+			free_mesh_load(load);
+		}
+	}
+}
+
+/**
+ * Stop load workers and fail the loads not done yet, while OpenGL objects of
+ * partially uploaded meshes can still be freed. Called by
+ * `renderer_shutdown()`.
+ */
+void
+shutdown_mesh_loads(void)
+{
+	pthread_mutex_lock(&load_lock);
+	load_stop = 1;
+	pthread_cond_broadcast(&load_cond);
+	pthread_mutex_unlock(&load_lock);
+	for (size_t i = 0; i < load_thread_count; i++) {
+		pthread_join(load_threads[i], NULL);
+	}
+	load_thread_count = 0;
+	load_stop = 0;
+
+	struct MeshLoadQueue *queues[] = { &load_jobs, &load_uploads };
+	for (size_t q = 0; q < sizeof(queues) / sizeof(queues[0]); q++) {
+		struct MeshLoad *load;
+		while ((load = load_queue_pop(queues[q]))) {
+			if (load->cancelled) {
+				free_mesh_load(load);
+				continue;
+			}
+			release_mesh_load(load);
+			mesh_free(load->mesh);
+			load->mesh = NULL;
+			load->status = MESH_LOAD_FAILED;
+		}
 	}
 }
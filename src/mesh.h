@@ -4,6 +4,9 @@
 #include <matlib.h>
 #include <stddef.h>
 
+// maximum levels of detail of a mesh, the full resolution one included
+#define MESH_MAX_LODS 4
+
 struct Mesh {
 	GLuint vao;
 	GLuint vbo;
@@ -12,13 +15,50 @@ struct Mesh {
 	int vertex_format;
 	size_t vertex_size;
 	size_t vertex_count;
-	size_t index_count;
+	size_t index_count;           // indices of the full resolution mesh
+	GLenum index_type;            // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+
+	// levels of detail, as consecutive ranges of the index buffer over the
+	// shared vertices; level 0 is the full resolution mesh
+	struct {
+		size_t index_offset;  // first index of the level
+		size_t index_count;   // number of indices of the level
+		float error;          // local space distance to the full mesh
+	} lods[MESH_MAX_LODS];
+	size_t lod_count;
+
+	// packed vertex attributes, see MESH_FORMAT.md v2: positions are snorm16
+	// mapped back to local space as `p * position_scale + position_offset`,
+	// normals are octahedral-encoded and UVs unorm16
+	int packed;
+	Vec position_scale;
+	Vec position_offset;
 
 	Mat transform;
 
+	// local space bounds of vertex positions in bind pose
+	struct {
+		Vec min;              // bounding box minimum corner
+		Vec max;              // bounding box maximum corner
+		Vec center;           // bounding sphere center
+		float radius;         // bounding sphere radius
+	} bounds;
+
+	// post-transform vertex cache efficiency of the index order, for a
+	// 16 entries FIFO cache; measured on optimized meshes only, both are
+	// negative when not measured
+	struct {
+		float acmr;           // transformed vertices per triangle, 0.5-3
+		float atvr;           // transformed vertices per vertex, 1 at best
+	} vertex_cache;
+
 	struct Skeleton *skeleton;
 	struct Animation *animations;
 	size_t anim_count;
+
+	// bytes accounted to memory statistics
+	size_t anim_bytes;            // skeleton and animation data
+	size_t buffer_bytes;          // vertex and index buffers
 };
 
 struct Mesh*
@@ -41,3 +81,46 @@ mesh_new(
 
 void
 mesh_free(struct Mesh *m);
+
+/**
+ * Mesh loaded in the background, see `mesh_load_async()`.
+ */
+struct MeshLoad;
+
+/**
+ * Background load states.
+ */
+enum {
+	MESH_LOAD_PENDING,            // being read, processed or uploaded
+	MESH_LOAD_DONE,               // mesh ready
+	MESH_LOAD_FAILED              // failed, errors reported when finished
+};
+
+/**
+ * Load a mesh file in the background.
+ *
+ * The file is read, parsed and processed as by `mesh_from_file()` on worker
+ * threads, then its buffers are uploaded by `renderer_present()` under the
+ * per-frame RENDER_OPTION_UPLOAD_BUDGET, so that streaming meshes in does not
+ * stall frames. Loading options are those set at the time of the call.
+ * Returns a handle to pass to `mesh_load_finish()`, or NULL on failure.
+ */
+struct MeshLoad*
+mesh_load_async(const char *filename);
+
+/**
+ * Return the MESH_LOAD_* state of a background load.
+ */
+int
+mesh_load_status(struct MeshLoad *load);
+
+/**
+ * Finish a background load and free its handle.
+ *
+ * Returns the mesh of a done load. Failed loads return NULL and push their
+ * errors to the traceback of the calling thread. Pending loads are abandoned
+ * and return NULL, without errors. Loads still pending at
+ * `renderer_shutdown()` fail.
+ */
+struct Mesh*
+mesh_load_finish(struct MeshLoad *load);
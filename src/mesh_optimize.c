@@ -0,0 +1,939 @@
+#include "error.h"
+#include "mesh_optimize.h"
+#include "radix_sort.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Forsyth scoring parameters, from the original article
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_SCALE 2.0f
+#define FORSYTH_VALENCE_POWER 0.5f
+#define FORSYTH_MAX_VALENCE 64
+
+#define NO_TRIANGLE ((size_t)-1)
+
+// fraction of the cheapest collapse candidates considered by each pass of
+// mesh simplification
+#define PASS_CANDIDATES_RATIO 4
+
+static uint32_t
+read_index(const void *indices, size_t i)
+{
+	uint32_t index;
+	memcpy(&index, (const char*)indices + i * sizeof(uint32_t), sizeof(uint32_t));
+	return index;
+}
+
+/**
+ * FIFO cache simulation, with per vertex timestamps of insertion.
+ *
+ * A vertex is in cache if fewer than VERTEX_CACHE_SIZE misses happened since
+ * it was inserted.
+ */
+struct FIFOCache {
+	uint32_t *stamps;
+	uint32_t time;
+};
+
+static int
+fifo_init(struct FIFOCache *cache, size_t vertex_count)
+{
+	if (!(cache->stamps = calloc(vertex_count ? vertex_count : 1, sizeof(uint32_t)))) {
+		err(ERR_NO_MEM);
+		return 0;
+	}
+	cache->time = VERTEX_CACHE_SIZE + 1;
+	return 1;
+}
+
+/**
+ * Reference a vertex, returns 1 if it was missing.
+ */
+static int
+fifo_miss(struct FIFOCache *cache, uint32_t v)
+{
+	if (cache->time - cache->stamps[v] > VERTEX_CACHE_SIZE) {
+		cache->stamps[v] = cache->time++;
+		return 1;
+	}
+	return 0;
+}
+
+int
+vertex_cache_stats(
+	const void *indices,
+	size_t index_count,
+	size_t vertex_count,
+	struct VertexCacheStats *stats
+) {
+	assert(index_count == 0 || indices != NULL);
+	assert(stats != NULL);
+
+	struct FIFOCache cache;
+	if (!fifo_init(&cache, vertex_count)) {
+		return 0;
+	}
+
+	size_t misses = 0, unique = 0;
+	for (size_t i = 0; i < index_count; i++) {
+		uint32_t v = read_index(indices, i);
+		if (v >= vertex_count) {
+			misses++;
+			continue;
+		}
+		unique += cache.stamps[v] == 0;
+		misses += fifo_miss(&cache, v);
+	}
+	free(cache.stamps);
+
+	size_t triangle_count = index_count / 3;
+	stats->acmr = triangle_count ? (float)misses / triangle_count : 0;
+	stats->atvr = unique ? (float)misses / unique : 0;
+	return 1;
+}
+
+static uint32_t
+hash_vertex(const unsigned char *vertex, size_t size)
+{
+	// FNV-1a
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < size; i++) {
+		h = (h ^ vertex[i]) * 16777619u;
+	}
+	return h;
+}
+
+/**
+ * Map each item of an array to the first one which is bitwise identical.
+ */
+static int
+remap_duplicates(const void *items, size_t item_size, size_t count, uint32_t *remap)
+{
+	// open addressing table of item indices, at most half full
+	size_t table_size = 1;
+	while (table_size < count * 2) {
+		table_size *= 2;
+	}
+	uint32_t *table = malloc(table_size * sizeof(uint32_t));
+	if (!table) {
+		err(ERR_NO_MEM);
+		return 0;
+	}
+	memset(table, 0xff, table_size * sizeof(uint32_t));
+
+	const unsigned char *data = items;
+	for (size_t i = 0; i < count; i++) {
+		const unsigned char *item = data + i * item_size;
+		size_t slot = hash_vertex(item, item_size) & (table_size - 1);
+		while (
+			table[slot] != UINT32_MAX &&
+			memcmp(data + table[slot] * item_size, item, item_size) != 0
+		) {
+			slot = (slot + 1) & (table_size - 1);
+		}
+		if (table[slot] == UINT32_MAX) {
+			table[slot] = i;
+		}
+		remap[i] = table[slot];
+	}
+
+	free(table);
+	return 1;
+}
+
+int
+weld_vertices(
+	const void *vertices,
+	size_t vertex_size,
+	size_t vertex_count,
+	uint32_t *indices,
+	size_t index_count
+) {
+	assert(vertex_count == 0 || vertices != NULL);
+
+	uint32_t *remap = malloc((vertex_count ? vertex_count : 1) * sizeof(uint32_t));
+	if (!remap) {
+		err(ERR_NO_MEM);
+		return 0;
+	}
+	if (!remap_duplicates(vertices, vertex_size, vertex_count, remap)) {
+		free(remap);
+		return 0;
+	}
+
+	for (size_t i = 0; i < index_count; i++) {
+		assert(indices[i] < vertex_count);
+		indices[i] = remap[indices[i]];
+	}
+
+	free(remap);
+	return 1;
+}
+
+/**
+ * Vertex score lookup tables.
+ */
+struct ForsythScores {
+	float cache[FORSYTH_CACHE_SIZE];
+	float valence[FORSYTH_MAX_VALENCE];
+};
+
+static void
+init_scores(struct ForsythScores *scores)
+{
+	for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+		if (i < 3) {
+			// vertices of the last triangle get a fixed score, so that
+			// the next one does not simply reuse its edges
+			scores->cache[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+		} else {
+			float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			scores->cache[i] = powf(1.0f - (i - 3) * scale, FORSYTH_CACHE_DECAY);
+		}
+	}
+	scores->valence[0] = 0;
+	for (int i = 1; i < FORSYTH_MAX_VALENCE; i++) {
+		scores->valence[i] = FORSYTH_VALENCE_SCALE * powf(i, -FORSYTH_VALENCE_POWER);
+	}
+}
+
+static float
+vertex_score(const struct ForsythScores *scores, int cache_pos, uint32_t valence)
+{
+	if (valence == 0) {
+		// no triangles left to add
+		return -1.0f;
+	}
+
+	// vertices with few remaining triangles are boosted, to get rid of them
+	// instead of leaving lone triangles behind
+	float score = valence < FORSYTH_MAX_VALENCE ?
+		scores->valence[valence] :
+		FORSYTH_VALENCE_SCALE * powf(valence, -FORSYTH_VALENCE_POWER);
+	if (cache_pos >= 0) {
+		score += scores->cache[cache_pos];
+	}
+	return score;
+}
+
+int
+optimize_vertex_cache(uint32_t *indices, size_t index_count, size_t vertex_count)
+{
+	assert(index_count % 3 == 0);
+	assert(index_count == 0 || indices != NULL);
+
+	size_t triangle_count = index_count / 3;
+	if (triangle_count < 2) {
+		return 1;
+	}
+	struct ForsythScores scores;
+	init_scores(&scores);
+
+	int ok = 0;
+	size_t n = vertex_count;
+	uint32_t *valence = calloc(n, sizeof(uint32_t));
+	uint32_t *offsets = malloc(n * sizeof(uint32_t));
+	int *cache_pos = malloc(n * sizeof(int));
+	float *vscores = malloc(n * sizeof(float));
+	uint32_t *adjacency = malloc(index_count * sizeof(uint32_t));
+	float *tscores = malloc(triangle_count * sizeof(float));
+	char *emitted = calloc(triangle_count, 1);
+	uint32_t *output = malloc(index_count * sizeof(uint32_t));
+	if (
+		!valence || !offsets || !cache_pos || !vscores || !adjacency ||
+		!tscores || !emitted || !output
+	) {
+		err(ERR_NO_MEM);
+		goto cleanup;
+	}
+
+	// triangles adjacent to each vertex, the first `valence[v]` of the
+	// list at `offsets[v]` are the ones not yet added
+	for (size_t i = 0; i < index_count; i++) {
+		assert(indices[i] < vertex_count);
+		valence[indices[i]]++;
+	}
+	uint32_t offset = 0;
+	for (size_t v = 0; v < n; v++) {
+		offsets[v] = offset;
+		offset += valence[v];
+		valence[v] = 0;
+	}
+	for (size_t i = 0; i < index_count; i++) {
+		uint32_t v = indices[i];
+		adjacency[offsets[v] + valence[v]++] = i / 3;
+	}
+
+	for (size_t v = 0; v < n; v++) {
+		cache_pos[v] = -1;
+		vscores[v] = vertex_score(&scores, -1, valence[v]);
+	}
+	size_t best = NO_TRIANGLE;
+	for (size_t t = 0; t < triangle_count; t++) {
+		const uint32_t *tri = &indices[t * 3];
+		tscores[t] = vscores[tri[0]] + vscores[tri[1]] + vscores[tri[2]];
+		if (best == NO_TRIANGLE || tscores[t] > tscores[best]) {
+			best = t;
+		}
+	}
+
+	// LRU cache of vertices, with room for those pushed out by a triangle
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3], new_cache[FORSYTH_CACHE_SIZE + 3];
+	size_t cache_size = 0;
+	size_t next_unemitted = 0;
+
+	for (size_t i = 0; i < triangle_count; i++) {
+		if (best == NO_TRIANGLE) {
+			// no candidates in cache, restart from the next triangle
+			// not yet added
+			while (emitted[next_unemitted]) {
+				next_unemitted++;
+			}
+			best = next_unemitted;
+		}
+
+		const uint32_t *tri = &indices[best * 3];
+		memcpy(&output[i * 3], tri, 3 * sizeof(uint32_t));
+		emitted[best] = 1;
+
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = tri[k];
+			uint32_t *adj = &adjacency[offsets[v]];
+			for (uint32_t j = 0; j < valence[v]; j++) {
+				if (adj[j] == best) {
+					adj[j] = adj[--valence[v]];
+					break;
+				}
+			}
+		}
+
+		// move the triangle vertices to the front of the cache
+		size_t new_size = 0;
+		for (int k = 0; k < 3; k++) {
+			int repeated = 0;
+			for (int l = 0; l < k; l++) {
+				repeated |= tri[l] == tri[k];
+			}
+			if (!repeated) {
+				new_cache[new_size++] = tri[k];
+			}
+		}
+		for (size_t j = 0; j < cache_size; j++) {
+			uint32_t v = cache[j];
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				new_cache[new_size++] = v;
+			}
+		}
+
+		// update scores of vertices in cache or pushed out of it, and
+		// of their remaining triangles
+		for (size_t j = 0; j < new_size; j++) {
+			uint32_t v = new_cache[j];
+			cache_pos[v] = j < FORSYTH_CACHE_SIZE ? (int)j : -1;
+			float score = vertex_score(&scores, cache_pos[v], valence[v]);
+			float delta = score - vscores[v];
+			vscores[v] = score;
+			const uint32_t *adj = &adjacency[offsets[v]];
+			for (uint32_t a = 0; a < valence[v]; a++) {
+				tscores[adj[a]] += delta;
+			}
+		}
+		cache_size = new_size < FORSYTH_CACHE_SIZE ? new_size : FORSYTH_CACHE_SIZE;
+		memcpy(cache, new_cache, cache_size * sizeof(uint32_t));
+
+		// next triangle is the best scoring one using cached vertices
+		best = NO_TRIANGLE;
+		for (size_t j = 0; j < cache_size; j++) {
+			uint32_t v = cache[j];
+			const uint32_t *adj = &adjacency[offsets[v]];
+			for (uint32_t a = 0; a < valence[v]; a++) {
+				if (best == NO_TRIANGLE || tscores[adj[a]] > tscores[best]) {
+					best = adj[a];
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output, index_count * sizeof(uint32_t));
+	ok = 1;
+
+cleanup:
+	free(valence);
+	free(offsets);
+	free(cache_pos);
+	free(vscores);
+	free(adjacency);
+	free(tscores);
+	free(emitted);
+	free(output);
+	return ok;
+}
+
+/**
+ * Map a float to an unsigned key which sorts in the opposite order.
+ */
+static uint64_t
+descending_key(float f)
+{
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	bits = bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+	return ~bits & 0xffffffffu;
+}
+
+int
+optimize_overdraw(
+	uint32_t *indices,
+	size_t index_count,
+	const float (*positions)[3],
+	size_t vertex_count
+) {
+	assert(index_count % 3 == 0);
+	assert(index_count == 0 || (indices != NULL && positions != NULL));
+
+	size_t triangle_count = index_count / 3;
+	if (triangle_count < 2) {
+		return 1;
+	}
+
+	struct FIFOCache cache;
+	if (!fifo_init(&cache, vertex_count)) {
+		return 0;
+	}
+
+	int ok = 0;
+	uint32_t *starts = malloc((triangle_count + 1) * sizeof(uint32_t));
+	float (*centroids)[3] = malloc(triangle_count * sizeof(*centroids));
+	float (*normals)[3] = malloc(triangle_count * sizeof(*normals));
+	struct SortKey *keys = malloc(triangle_count * sizeof(struct SortKey));
+	struct SortKey *tmp = malloc(triangle_count * sizeof(struct SortKey));
+	uint32_t *output = malloc(index_count * sizeof(uint32_t));
+	if (!starts || !centroids || !normals || !keys || !tmp || !output) {
+		err(ERR_NO_MEM);
+		goto cleanup;
+	}
+
+	// split into clusters where all vertices of a triangle miss the cache
+	size_t cluster_count = 0;
+	for (size_t t = 0; t < triangle_count; t++) {
+		int misses = 0;
+		for (int k = 0; k < 3; k++) {
+			misses += fifo_miss(&cache, indices[t * 3 + k]);
+		}
+		if (t == 0 || misses == 3) {
+			starts[cluster_count++] = t;
+		}
+	}
+	starts[cluster_count] = triangle_count;
+
+	// area weighted centroid and normal of each cluster and of the mesh
+	float mesh_centroid[3] = { 0, 0, 0 }, mesh_area = 0;
+	for (size_t c = 0; c < cluster_count; c++) {
+		float *centroid = centroids[c], *normal = normals[c], area = 0;
+		memset(centroid, 0, sizeof(centroids[c]));
+		memset(normal, 0, sizeof(normals[c]));
+		for (size_t t = starts[c]; t < starts[c + 1]; t++) {
+			const float *p0 = positions[indices[t * 3 + 0]];
+			const float *p1 = positions[indices[t * 3 + 1]];
+			const float *p2 = positions[indices[t * 3 + 2]];
+			float e1[3], e2[3], n[3];
+			for (int k = 0; k < 3; k++) {
+				e1[k] = p1[k] - p0[k];
+				e2[k] = p2[k] - p0[k];
+			}
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+			float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; k++) {
+				centroid[k] += (p0[k] + p1[k] + p2[k]) / 3 * a;
+				normal[k] += n[k];
+			}
+			area += a;
+		}
+		for (int k = 0; k < 3; k++) {
+			mesh_centroid[k] += centroid[k];
+			centroid[k] = area > 0 ? centroid[k] / area : 0;
+		}
+		mesh_area += area;
+	}
+	for (int k = 0; k < 3; k++) {
+		mesh_centroid[k] = mesh_area > 0 ? mesh_centroid[k] / mesh_area : 0;
+	}
+
+	// clusters further out along their normal first
+	for (size_t c = 0; c < cluster_count; c++) {
+		const float *n = normals[c];
+		float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float dot = 0;
+		for (int k = 0; k < 3 && len > 0; k++) {
+			dot += (centroids[c][k] - mesh_centroid[k]) * n[k] / len;
+		}
+		keys[c].key = descending_key(dot);
+		keys[c].index = c;
+	}
+	struct SortKey *sorted = radix_sort(keys, tmp, cluster_count);
+
+	size_t out = 0;
+	for (size_t i = 0; i < cluster_count; i++) {
+		uint32_t c = sorted[i].index;
+		size_t count = (starts[c + 1] - starts[c]) * 3;
+		memcpy(&output[out], &indices[starts[c] * 3], count * sizeof(uint32_t));
+		out += count;
+	}
+	memcpy(indices, output, index_count * sizeof(uint32_t));
+	ok = 1;
+
+cleanup:
+	free(cache.stamps);
+	free(starts);
+	free(centroids);
+	free(normals);
+	free(keys);
+	free(tmp);
+	free(output);
+	return ok;
+}
+
+int
+optimize_vertex_fetch(
+	void *vertices,
+	size_t vertex_size,
+	size_t *vertex_count,
+	uint32_t *indices,
+	size_t index_count
+) {
+	assert(vertex_count != NULL);
+	assert(*vertex_count == 0 || vertices != NULL);
+
+	size_t n = *vertex_count;
+	uint32_t *remap = malloc((n ? n : 1) * sizeof(uint32_t));
+	unsigned char *output = malloc((n ? n : 1) * vertex_size);
+	if (!remap || !output) {
+		err(ERR_NO_MEM);
+		free(remap);
+		free(output);
+		return 0;
+	}
+	memset(remap, 0xff, n * sizeof(uint32_t));
+
+	// vertices numbered by first reference
+	uint32_t next = 0;
+	const unsigned char *data = vertices;
+	for (size_t i = 0; i < index_count; i++) {
+		uint32_t v = indices[i];
+		assert(v < n);
+		if (remap[v] == UINT32_MAX) {
+			memcpy(output + next * vertex_size, data + v * vertex_size, vertex_size);
+			remap[v] = next++;
+		}
+		indices[i] = remap[v];
+	}
+
+	memcpy(vertices, output, next * vertex_size);
+	*vertex_count = next;
+
+	free(remap);
+	free(output);
+	return 1;
+}
+
+/**
+ * Quadric error of a point, as a sum of squared distances to planes weighted
+ * by area.
+ */
+struct Quadric {
+	float a00, a11, a22;
+	float a10, a20, a21;
+	float b0, b1, b2;
+	float c;
+	float w;
+};
+
+enum {
+	VERTEX_MANIFOLD,     // interior vertex, free to collapse
+	VERTEX_LOCKED        // seam, border or non-manifold vertex, kept in place
+};
+
+static void
+quadric_from_triangle(struct Quadric *q, const float *p0, const float *p1, const float *p2)
+{
+	float e1[3], e2[3], n[3];
+	for (int k = 0; k < 3; k++) {
+		e1[k] = p1[k] - p0[k];
+		e2[k] = p2[k] - p0[k];
+	}
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+	memset(q, 0, sizeof(struct Quadric));
+	if (len == 0) {
+		return;
+	}
+	for (int k = 0; k < 3; k++) {
+		n[k] /= len;
+	}
+	float d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+	float w = len * 0.5f;
+	q->a00 = w * n[0] * n[0];
+	q->a11 = w * n[1] * n[1];
+	q->a22 = w * n[2] * n[2];
+	q->a10 = w * n[1] * n[0];
+	q->a20 = w * n[2] * n[0];
+	q->a21 = w * n[2] * n[1];
+	q->b0 = w * n[0] * d;
+	q->b1 = w * n[1] * d;
+	q->b2 = w * n[2] * d;
+	q->c = w * d * d;
+	q->w = w;
+}
+
+static void
+quadric_add(struct Quadric *q, const struct Quadric *r)
+{
+	q->a00 += r->a00;
+	q->a11 += r->a11;
+	q->a22 += r->a22;
+	q->a10 += r->a10;
+	q->a20 += r->a20;
+	q->a21 += r->a21;
+	q->b0 += r->b0;
+	q->b1 += r->b1;
+	q->b2 += r->b2;
+	q->c += r->c;
+	q->w += r->w;
+}
+
+/**
+ * Mean squared distance of a point to the planes of a quadric.
+ */
+static float
+quadric_error(const struct Quadric *q, const float *p)
+{
+	float x = p[0], y = p[1], z = p[2];
+	float r = (
+		q->a00 * x * x + q->a11 * y * y + q->a22 * z * z +
+		2 * (q->a10 * x * y + q->a20 * x * z + q->a21 * y * z) +
+		2 * (q->b0 * x + q->b1 * y + q->b2 * z) +
+		q->c
+	);
+	return fabsf(r) / (q->w > 0 ? q->w : 1);
+}
+
+/**
+ * Open addressing set of directed edges, with use counts.
+ */
+struct EdgeSet {
+	uint64_t *edges;
+	uint32_t *counts;
+	size_t size;
+};
+
+static uint32_t*
+edge_count(struct EdgeSet *set, uint32_t a, uint32_t b)
+{
+	uint64_t key = (uint64_t)a << 32 | b;
+	size_t slot = (key * 0x9e3779b97f4a7c15ull) >> 32 & (set->size - 1);
+	while (set->counts[slot] != 0 && set->edges[slot] != key) {
+		slot = (slot + 1) & (set->size - 1);
+	}
+	set->edges[slot] = key;
+	return &set->counts[slot];
+}
+
+/**
+ * Lock vertices on open borders or non-manifold edges, that is edges which
+ * are not matched by exactly one edge in the opposite direction.
+ */
+static int
+lock_borders(const uint32_t *indices, size_t index_count, const uint32_t *canon, char *kinds)
+{
+	struct EdgeSet set = { .size = 1 };
+	while (set.size < index_count * 2) {
+		set.size *= 2;
+	}
+	set.edges = malloc(set.size * sizeof(uint64_t));
+	set.counts = calloc(set.size, sizeof(uint32_t));
+	if (!set.edges || !set.counts) {
+		err(ERR_NO_MEM);
+		free(set.edges);
+		free(set.counts);
+		return 0;
+	}
+
+	for (size_t i = 0; i < index_count; i++) {
+		uint32_t a = canon[indices[i]];
+		uint32_t b = canon[indices[i - i % 3 + (i + 1) % 3]];
+		(*edge_count(&set, a, b))++;
+	}
+	for (size_t i = 0; i < index_count; i++) {
+		uint32_t a = canon[indices[i]];
+		uint32_t b = canon[indices[i - i % 3 + (i + 1) % 3]];
+		if (*edge_count(&set, a, b) != 1 || *edge_count(&set, b, a) != 1) {
+			kinds[a] = kinds[b] = VERTEX_LOCKED;
+		}
+	}
+
+	free(set.edges);
+	free(set.counts);
+	return 1;
+}
+
+/**
+ * Tell whether moving a vertex onto another flips any of the triangles around
+ * it which do not collapse.
+ */
+static int
+collapse_flips(
+	const uint32_t *indices,
+	const uint32_t *triangles,
+	size_t triangle_count,
+	const uint32_t *canon,
+	const float (*positions)[3],
+	uint32_t from,
+	uint32_t to
+) {
+	for (size_t i = 0; i < triangle_count; i++) {
+		const uint32_t *tri = &indices[triangles[i] * 3];
+		const float *p[3], *q[3];
+		int collapses = 0;
+		for (int k = 0; k < 3; k++) {
+			uint32_t c = canon[tri[k]];
+			collapses |= c == to;
+			p[k] = positions[c];
+			q[k] = c == from ? positions[to] : positions[c];
+		}
+		if (collapses) {
+			continue;
+		}
+
+		float n0[3], n1[3];
+		for (int pass = 0; pass < 2; pass++) {
+			const float **v = pass == 0 ? p : q;
+			float *n = pass == 0 ? n0 : n1;
+			float e1[3], e2[3];
+			for (int k = 0; k < 3; k++) {
+				e1[k] = v[1][k] - v[0][k];
+				e2[k] = v[2][k] - v[0][k];
+			}
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		}
+		if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int
+simplify_mesh(
+	uint32_t *dst,
+	const uint32_t *indices,
+	size_t index_count,
+	const float (*positions)[3],
+	size_t vertex_count,
+	size_t target_count,
+	size_t *r_count,
+	float *r_error
+) {
+	assert(index_count % 3 == 0);
+	assert(index_count == 0 || (dst != NULL && indices != NULL && positions != NULL));
+	assert(r_count != NULL && r_error != NULL);
+
+	memcpy(dst, indices, index_count * sizeof(uint32_t));
+	*r_count = index_count;
+	*r_error = 0;
+	if (index_count <= target_count) {
+		return 1;
+	}
+
+	int ok = 0;
+	size_t n = vertex_count;
+	uint32_t *canon = malloc(n * sizeof(uint32_t));
+	uint32_t *wedges = malloc(n * sizeof(uint32_t));
+	char *kinds = calloc(n, 1);
+	char *touched = malloc(n);
+	uint32_t *collapse = malloc(n * sizeof(uint32_t));
+	struct Quadric *quadrics = calloc(n, sizeof(struct Quadric));
+	uint32_t *offsets = malloc((n + 1) * sizeof(uint32_t));
+	uint32_t *triangles = malloc(index_count * sizeof(uint32_t));
+	uint32_t (*candidates)[2] = malloc(index_count * sizeof(*candidates));
+	struct SortKey *keys = malloc(index_count * sizeof(struct SortKey));
+	struct SortKey *tmp = malloc(index_count * sizeof(struct SortKey));
+	if (
+		!canon || !wedges || !kinds || !touched || !collapse ||
+		!quadrics || !offsets || !triangles || !candidates || !keys || !tmp
+	) {
+		err(ERR_NO_MEM);
+		goto cleanup;
+	}
+
+	// vertices at the same position share topology, those with distinct
+	// attributes there are seams
+	if (!remap_duplicates(positions, sizeof(positions[0]), n, canon)) {
+		goto cleanup;
+	}
+	memset(wedges, 0xff, n * sizeof(uint32_t));
+	for (size_t i = 0; i < index_count; i++) {
+		uint32_t v = indices[i], c = canon[v];
+		if (wedges[c] == UINT32_MAX) {
+			wedges[c] = v;
+		} else if (wedges[c] != v) {
+			kinds[c] = VERTEX_LOCKED;
+		}
+	}
+	if (!lock_borders(indices, index_count, canon, kinds)) {
+		goto cleanup;
+	}
+
+	for (size_t t = 0; t < index_count / 3; t++) {
+		const uint32_t *tri = &indices[t * 3];
+		struct Quadric q;
+		quadric_from_triangle(
+			&q,
+			positions[canon[tri[0]]],
+			positions[canon[tri[1]]],
+			positions[canon[tri[2]]]
+		);
+		for (int k = 0; k < 3; k++) {
+			quadric_add(&quadrics[canon[tri[k]]], &q);
+		}
+	}
+
+	size_t count = index_count;
+	float max_error = 0;
+	while (count > target_count) {
+		// triangles around each position
+		memset(offsets, 0, (n + 1) * sizeof(uint32_t));
+		for (size_t i = 0; i < count; i++) {
+			offsets[canon[dst[i]] + 1]++;
+		}
+		for (size_t v = 0; v < n; v++) {
+			offsets[v + 1] += offsets[v];
+		}
+		for (size_t i = 0; i < count; i++) {
+			triangles[offsets[canon[dst[i]]]++] = i / 3;
+		}
+		for (size_t v = n; v > 0; v--) {
+			offsets[v] = offsets[v - 1];
+		}
+		offsets[0] = 0;
+
+		// collapse candidates, from a free vertex onto the other end of
+		// each edge, cheapest first
+		size_t candidate_count = 0;
+		for (size_t i = 0; i < count; i++) {
+			uint32_t from = dst[i];
+			uint32_t to = dst[i - i % 3 + (i + 1) % 3];
+			for (int dir = 0; dir < 2; dir++) {
+				uint32_t cf = canon[from], ct = canon[to];
+				if (kinds[cf] == VERTEX_MANIFOLD && cf != ct) {
+					struct Quadric q = quadrics[cf];
+					quadric_add(&q, &quadrics[ct]);
+					float cost = quadric_error(&q, positions[ct]);
+					uint32_t bits;
+					memcpy(&bits, &cost, sizeof(bits));
+					keys[candidate_count].key = bits;
+					keys[candidate_count].index = candidate_count;
+					candidates[candidate_count][0] = from;
+					candidates[candidate_count][1] = to;
+					candidate_count++;
+					break;
+				}
+				uint32_t swap = from;
+				from = to;
+				to = swap;
+			}
+		}
+		struct SortKey *sorted = radix_sort(keys, tmp, candidate_count);
+
+		// collapse vertices whose neighborhood is left untouched by
+		// other collapses of the pass; costlier candidates wait for the
+		// next passes, which may have cheaper ones to offer
+		uint64_t max_key = candidate_count ?
+			sorted[candidate_count / PASS_CANDIDATES_RATIO].key : 0;
+		for (size_t v = 0; v < n; v++) {
+			collapse[v] = v;
+		}
+		memset(touched, 0, n);
+		size_t removed = 0, collapsed = 0;
+		for (size_t i = 0; i < candidate_count && count - removed > target_count; i++) {
+			uint32_t from = candidates[sorted[i].index][0];
+			uint32_t to = candidates[sorted[i].index][1];
+			uint32_t cf = canon[from], ct = canon[to];
+			const uint32_t *around = &triangles[offsets[cf]];
+			size_t around_count = offsets[cf + 1] - offsets[cf];
+			if (sorted[i].key > max_key && collapsed > 0) {
+				break;
+			}
+			if (
+				touched[cf] ||
+				touched[ct] ||
+				collapse_flips(dst, around, around_count, canon, positions, cf, ct)
+			) {
+				continue;
+			}
+
+			collapse[from] = to;
+			quadric_add(&quadrics[ct], &quadrics[cf]);
+			for (size_t t = 0; t < around_count; t++) {
+				const uint32_t *tri = &dst[around[t] * 3];
+				int degenerate = 0;
+				for (int k = 0; k < 3; k++) {
+					touched[canon[tri[k]]] = 1;
+					degenerate |= canon[tri[k]] == ct;
+				}
+				removed += degenerate ? 3 : 0;
+			}
+
+			float cost;
+			uint32_t bits = sorted[i].key;
+			memcpy(&cost, &bits, sizeof(cost));
+			max_error = cost > max_error ? cost : max_error;
+			collapsed++;
+		}
+		if (collapsed == 0) {
+			break;
+		}
+
+		// rewrite triangles, dropping the degenerate ones
+		size_t written = 0;
+		for (size_t i = 0; i < count; i += 3) {
+			uint32_t a = collapse[dst[i]];
+			uint32_t b = collapse[dst[i + 1]];
+			uint32_t c = collapse[dst[i + 2]];
+			if (canon[a] != canon[b] && canon[b] != canon[c] && canon[a] != canon[c]) {
+				dst[written++] = a;
+				dst[written++] = b;
+				dst[written++] = c;
+			}
+		}
+		count = written;
+	}
+
+	*r_count = count;
+	*r_error = sqrtf(max_error);
+	ok = 1;
+
+cleanup:
+	free(canon);
+	free(wedges);
+	free(kinds);
+	free(touched);
+	free(collapse);
+	free(quadrics);
+	free(offsets);
+	free(triangles);
+	free(candidates);
+	free(keys);
+	free(tmp);
+	return ok;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// entries of the FIFO post-transform cache simulated for metrics and overdraw
+// clustering, typical of current hardware
+#define VERTEX_CACHE_SIZE 16
+
+/**
+ * Post-transform vertex cache efficiency of an index sequence.
+ */
+struct VertexCacheStats {
+	float acmr;      // average cache miss ratio, transforms per triangle
+	float atvr;      // average transform to vertex ratio, 1 at best
+};
+
+/**
+ * Measure the vertex cache efficiency of triangle list indices.
+ *
+ * Indices need not be aligned, those out of range count as misses. Returns 0
+ * if out of memory.
+ */
+int
+vertex_cache_stats(
+	const void *indices,
+	size_t index_count,
+	size_t vertex_count,
+	struct VertexCacheStats *stats
+);
+
+/**
+ * Make indices of bitwise identical vertices refer to the first of them.
+ *
+ * Vertices are left untouched, duplicates become unreferenced and are dropped
+ * by `optimize_vertex_fetch()`.
+ */
+int
+weld_vertices(
+	const void *vertices,
+	size_t vertex_size,
+	size_t vertex_count,
+	uint32_t *indices,
+	size_t index_count
+);
+
+/**
+ * Reorder triangles for post-transform vertex cache hits, with Tom Forsyth's
+ * linear-speed algorithm.
+ */
+int
+optimize_vertex_cache(uint32_t *indices, size_t index_count, size_t vertex_count);
+
+/**
+ * Reorder clusters of triangles so that the outer ones come first.
+ *
+ * Clusters are runs of triangles of a cache optimized sequence, split where
+ * the cache restarts from scratch, thus vertex cache efficiency is mostly
+ * preserved. Clusters facing away from the mesh center are likely to occlude
+ * the others, drawing them first reduces overdraw.
+ */
+int
+optimize_overdraw(
+	uint32_t *indices,
+	size_t index_count,
+	const float (*positions)[3],
+	size_t vertex_count
+);
+
+/**
+ * Reorder vertices by first use in index order, for vertex fetch locality.
+ *
+ * Unreferenced vertices are dropped and `vertex_count` updated.
+ */
+int
+optimize_vertex_fetch(
+	void *vertices,
+	size_t vertex_size,
+	size_t *vertex_count,
+	uint32_t *indices,
+	size_t index_count
+);
+
+/**
+ * Simplify a triangle mesh with quadric error metrics.
+ *
+ *   dst           Output indices, with room for `index_count` ones.
+ *   indices       Input indices.
+ *   index_count   Number of input indices.
+ *   positions     Vertex positions.
+ *   vertex_count  Number of vertices.
+ *   target_count  Number of indices to reduce to.
+ *   r_count       Number of indices written.
+ *   r_error       Largest distance of the result to the input surface, as
+ *                 estimated by the quadrics.
+ *
+ * Edges are collapsed onto existing vertices, thus the result indexes the same
+ * vertex array. Vertices on open borders and attribute seams stay in place,
+ * which may leave the result above target.
+ */
+int
+simplify_mesh(
+	uint32_t *dst,
+	const uint32_t *indices,
+	size_t index_count,
+	const float (*positions)[3],
+	size_t vertex_count,
+	size_t target_count,
+	size_t *r_count,
+	float *r_error
+);
@@ -0,0 +1,59 @@
+#include "radix_sort.h"
+#include <assert.h>
+#include <string.h>
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+#define digit(key, pass) (((key) >> ((pass) * RADIX_BITS)) & (RADIX_BUCKETS - 1))
+
+struct SortKey*
+radix_sort(struct SortKey *keys, struct SortKey *tmp, size_t count)
+{
+	assert(count == 0 || (keys != NULL && tmp != NULL));
+
+	if (count < 2) {
+		return keys;
+	}
+
+	// build the histograms of all digits in a single sweep
+	size_t histograms[RADIX_PASSES][RADIX_BUCKETS];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; i++) {
+		uint64_t key = keys[i].key;
+		for (int p = 0; p < RADIX_PASSES; p++) {
+			histograms[p][digit(key, p)]++;
+		}
+	}
+
+	struct SortKey *src = keys, *dst = tmp;
+	for (int p = 0; p < RADIX_PASSES; p++) {
+		size_t *histogram = histograms[p];
+
+		// skip the pass when all keys share the same digit, which is
+		// the case for most of the unused or constant key bits
+		if (histogram[digit(src[0].key, p)] == count) {
+			continue;
+		}
+
+		// turn digit counts into bucket offsets
+		size_t offset = 0;
+		for (int b = 0; b < RADIX_BUCKETS; b++) {
+			size_t n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+
+		// scatter keys into buckets preserving their relative order
+		for (size_t i = 0; i < count; i++) {
+			dst[histogram[digit(src[i].key, p)]++] = src[i];
+		}
+
+		struct SortKey *swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	return src;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Sort key entry which refers to an item of an external array.
+ */
+struct SortKey {
+	uint64_t key;    // sort key
+	uint32_t index;  // index of the keyed item
+};
+
+/**
+ * Sort an array of keys in ascending order with a stable LSD radix sort.
+ *
+ *   keys   Keys to sort.
+ *   tmp    Scratch array with room for `count` keys.
+ *   count  Number of keys.
+ *
+ * Returns the array holding the sorted sequence, which is either `keys` or
+ * `tmp`.
+ */
+struct SortKey*
+radix_sort(struct SortKey *keys, struct SortKey *tmp, size_t count);
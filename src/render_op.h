@@ -0,0 +1,64 @@
+#pragma once
+
+#include "renderlib.h"
+#include <stdint.h>
+
+enum {
+	MESH_OP = 1,
+	TEXT_OP,
+	QUAD_OP
+};
+
+enum {
+	SHADOW_PASS = 1,
+	RENDER_PASS,
+	DEPTH_PASS,
+};
+
+/**
+ * Queues operations are submitted to, as recorded in frame captures.
+ *
+ * Depth pre-pass operations are derived from render queue ones and are not
+ * listed.
+ */
+enum {
+	SHADOW_QUEUE,
+	RENDER_QUEUE,
+	OVERLAY_QUEUE,
+	QUEUE_COUNT
+};
+
+struct RenderOp {
+	int pass;
+	int type;
+	Vec position;
+	struct Transform transform;
+	union {
+		struct {
+			struct Mesh *mesh;
+			struct MeshProps props;
+			size_t palette;  // skinning palette index
+			size_t lod;      // level of detail
+			struct Light light;
+			Vec eye;
+			int is_lit;
+		} mesh;
+		struct {
+			struct Text *text;
+			struct TextProps props;
+		} text;
+		struct {
+			struct Quad *quad;
+			struct QuadProps props;
+		} quad;
+	};
+	int (*exec)(struct RenderOp **ops, size_t count);
+};
+
+/**
+ * Computes the key render queues are sorted by.
+ *
+ * Depends on the operation view-space position and the current sort mode.
+ */
+uint64_t
+render_op_key(const struct RenderOp *op);
@@ -1,23 +1,65 @@
+// use open source standard library features
+#define _XOPEN_SOURCE 700
+
+#include "arena.h"
+#include "gl_api.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
+#include "radix_sort.h"
+#include "render_op.h"
 #include "renderlib.h"
 #include "shadow_map.h"
-#include <GL/glew.h>
+#include "stats.h"
+#include "trace.h"
 #include <assert.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RENDER_ARENA_BLOCK_SIZE 65536
+#define RENDER_QUEUE_MIN_CAPACITY 64
+
+// largest simplification error of the levels of detail selected for drawing,
+// as a fraction of viewport height, about a pixel at 1080p
+#define LOD_SCREEN_ERROR 0.001f
+
+// defined in draw_common.c
+int
+init_draw_common(void);
+
+void
+shutdown_draw_common(void);
+
+int
+update_skinning_palettes(struct AnimationInstance **instances, size_t count);
+
+int
+configure_frame(
+	const Mat *view,
+	const Mat *projection,
+	const struct Light *light,
+	const Vec *eye
+);
 
-#define RENDER_QUEUE_SIZE 1000
+void
+invalidate_frame(void);
 
 // defined in draw_mesh.c
 int
-init_mesh_pipeline(void);
+init_mesh_pipeline(GLint shadow_unit);
 
 int
 draw_mesh(
 	struct Mesh *mesh,
 	struct MeshProps *props,
-	struct Transform *transform,
+	size_t palette,
+	size_t lod,
+	const Mat *models,
+	size_t count,
 	struct Light *light,
-	Vec *eye,
-	int shadow_map
+	Vec *eye
 );
 
 // defined in draw_shadow.c
@@ -28,8 +70,20 @@ int
 draw_mesh_shadow(
 	struct Mesh *mesh,
 	struct MeshProps *props,
-	struct Transform *transform,
-	struct Light *light
+	size_t palette,
+	size_t lod,
+	const Mat *models,
+	size_t count
+);
+
+int
+draw_mesh_depth(
+	struct Mesh *mesh,
+	struct MeshProps *props,
+	size_t palette,
+	size_t lod,
+	const Mat *models,
+	size_t count
 );
 
 // defined in draw_text.c
@@ -46,88 +100,193 @@ init_quad_pipeline(void);
 int
 draw_quad(struct Quad *quad, struct QuadProps *props, struct Transform *transform);
 
-enum {
-	MESH_OP = 1,
-	TEXT_OP,
-	QUAD_OP
-};
+// defined in headless.c
+void
+shutdown_headless(void);
 
-enum {
-	SHADOW_PASS = 1,
-	RENDER_PASS,
-};
+// defined in capture.c
+int
+write_frame_capture(
+	const char *filename,
+	struct RenderOp **queues[QUEUE_COUNT],
+	const size_t lens[QUEUE_COUNT]
+);
 
-struct RenderOp {
-	int pass;
-	int type;
-	Vec position;
-	struct Transform transform;
-	union {
-		struct {
-			struct Mesh *mesh;
-			struct MeshProps props;
-			struct Light light;
-			Vec eye;
-			int is_lit;
-		} mesh;
-		struct {
-			struct Text *text;
-			struct TextProps props;
-		} text;
-		struct {
-			struct Quad *quad;
-			struct QuadProps props;
-		} quad;
-	};
-	int (*exec)(struct RenderOp *op);
+void
+shutdown_capture(void);
+
+// defined in mesh.c
+void
+upload_mesh_loads(size_t budget);
+
+void
+shutdown_mesh_loads(void);
+
+// GPU timestamps taken in each frame, at the beginning and after each pass
+enum {
+	MARK_BEGIN,
+	MARK_SHADOW,
+	MARK_DEPTH,
+	MARK_RENDER,
+	MARK_OVERLAY,
+	MARK_COUNT
 };
 
+// render queues hold pointers to operations, both of which live in the
+// per-frame arena and are discarded at the end of `renderer_present()`
 static struct RenderQueue {
-	struct RenderOp queue[RENDER_QUEUE_SIZE];
+	struct RenderOp **queue;
 	size_t len;
-} shadow_queue = { .len = 0 }, render_queue = { .len = 0 }, overlay_queue = { .len = 0 };
+	size_t capacity;
+} shadow_queue = { NULL, 0, 0 },
+  depth_queue = { NULL, 0, 0 },
+  render_queue = { NULL, 0, 0 },
+  overlay_queue = { NULL, 0, 0 };
 
+static int sort_mode = RENDER_SORT_STATE;
+static int depth_prepass = 0;
+static int optimize_meshes = 0;
+static int mesh_lods = 1;
+static int shadow_lod_bias = 0;
+static int upload_budget = 4 * 1024 * 1024;
+static struct {
+	size_t visible;
+	size_t culled;
+	size_t shadow_visible;
+	size_t shadow_culled;
+} cull_stats;  // counters of meshes submitted since last frame
+static struct RenderStats last_stats;
+static struct RenderFrameTimings timings;
+static struct RenderFrameTimings last_timings;
+static struct GpuTimer *gpu_timer = NULL;
+static struct Arena *frame_arena = NULL;
 static struct ShadowMap *shadow_map = NULL;
 static int shadow_map_tu = -1;
+static GLuint target_fbo = 0;  // framebuffer passes render to, 0 = window
+static char *capture_filename = NULL;  // pending frame capture, if any
+
+static double
+clock_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
 
 static int
 render_queue_push(struct RenderQueue *q, const struct RenderOp *op)
 {
-	if (q->len == RENDER_QUEUE_SIZE) {
-		err(ERR_RENDER_QUEUE_FULL);
+	assert(frame_arena != NULL);
+
+	// grow the queue by doubling its capacity; the old array is left in
+	// the arena and reclaimed with the rest of the frame
+	if (q->len == q->capacity) {
+		size_t capacity = (
+			q->capacity
+			? q->capacity * 2
+			: RENDER_QUEUE_MIN_CAPACITY
+		);
+		struct RenderOp **queue = arena_alloc(
+			frame_arena,
+			sizeof(struct RenderOp*) * capacity
+		);
+		if (!queue) {
+			return 0;
+		}
+		if (q->len > 0) {
+			memcpy(queue, q->queue, sizeof(struct RenderOp*) * q->len);
+		}
+		q->queue = queue;
+		q->capacity = capacity;
+	}
+
+	struct RenderOp *dst = arena_alloc(frame_arena, sizeof(struct RenderOp));
+	if (!dst) {
 		return 0;
 	}
-	q->queue[q->len++] = *op;
+	*dst = *op;
+	q->queue[q->len++] = dst;
 	return 1;
 }
 
 static void
 render_queue_flush(struct RenderQueue *q)
 {
+	q->queue = NULL;
 	q->len = 0;
+	q->capacity = 0;
 }
 
 static int
-exec_mesh_op(struct RenderOp *op)
+exec_mesh_op(struct RenderOp **ops, size_t count)
 {
+	// all ops in the batch share everything but the model transform, see
+	// `render_op_batchable()`
+	struct RenderOp *op = ops[0];
+	Mat *models = arena_alloc(frame_arena, sizeof(Mat) * count);
+	if (!models) {
+		return 0;
+	}
+	for (size_t i = 0; i < count; i++) {
+		models[i] = ops[i]->transform.model;
+	}
+
 	int ok = 1;
 	switch (op->pass) {
 	case SHADOW_PASS:
-		ok &= draw_mesh_shadow(
-			op->mesh.mesh,
-			&op->mesh.props,
-			&op->transform,
-			&op->mesh.light
+		ok &= (
+			configure_frame(
+				&op->transform.view,
+				&op->transform.projection,
+				&op->mesh.light,
+				NULL
+			) &&
+			draw_mesh_shadow(
+				op->mesh.mesh,
+				&op->mesh.props,
+				op->mesh.palette,
+				op->mesh.lod,
+				models,
+				count
+			)
+		);
+		break;
+	case DEPTH_PASS:
+		ok &= (
+			configure_frame(
+				&op->transform.view,
+				&op->transform.projection,
+				NULL,
+				NULL
+			) &&
+			draw_mesh_depth(
+				op->mesh.mesh,
+				&op->mesh.props,
+				op->mesh.palette,
+				op->mesh.lod,
+				models,
+				count
+			)
 		);
 		break;
 	case RENDER_PASS:
-		ok &= draw_mesh(
-			op->mesh.mesh,
-			&op->mesh.props,
-			&op->transform,
-			op->mesh.is_lit ? &op->mesh.light : NULL,
-			op->mesh.is_lit ? &op->mesh.eye : NULL,
-			shadow_map_tu
+		ok &= (
+			configure_frame(
+				&op->transform.view,
+				&op->transform.projection,
+				op->mesh.is_lit ? &op->mesh.light : NULL,
+				op->mesh.is_lit ? &op->mesh.eye : NULL
+			) &&
+			draw_mesh(
+				op->mesh.mesh,
+				&op->mesh.props,
+				op->mesh.palette,
+				op->mesh.lod,
+				models,
+				count,
+				op->mesh.is_lit ? &op->mesh.light : NULL,
+				op->mesh.is_lit ? &op->mesh.eye : NULL
+			)
 		);
 		break;
 	}
@@ -135,46 +294,206 @@ exec_mesh_op(struct RenderOp *op)
 }
 
 static int
-exec_text_op(struct RenderOp *op)
+exec_text_op(struct RenderOp **ops, size_t count)
 {
-	return draw_text(op->text.text, &op->text.props, &op->transform);
+	int ok = 1;
+	for (size_t i = 0; i < count; i++) {
+		struct RenderOp *op = ops[i];
+		ok &= (
+			configure_frame(&op->transform.view, &op->transform.projection, NULL, NULL) &&
+			draw_text(op->text.text, &op->text.props, &op->transform)
+		);
+	}
+	return ok;
 }
 
 static int
-exec_quad_op(struct RenderOp *op)
+exec_quad_op(struct RenderOp **ops, size_t count)
 {
-	return draw_quad(op->quad.quad, &op->quad.props, &op->transform);
+	int ok = 1;
+	for (size_t i = 0; i < count; i++) {
+		struct RenderOp *op = ops[i];
+		ok &= (
+			configure_frame(&op->transform.view, &op->transform.projection, NULL, NULL) &&
+			draw_quad(op->quad.quad, &op->quad.props, &op->transform)
+		);
+	}
+	return ok;
 }
 
+/**
+ * Tell whether two render operations can be executed with a single instanced
+ * draw call.
+ *
+ * Only mesh operations with the same mesh, level of detail and identical
+ * properties and camera/light setup qualify; animated meshes carry per-instance skinning
+ * data and are never batched.
+ */
 static int
-render_op_cmp(const void *ptr1, const void *ptr2)
+render_op_batchable(const struct RenderOp *op1, const struct RenderOp *op2)
+{
+	if (op1->type != MESH_OP ||
+	    op2->type != MESH_OP ||
+	    op1->pass != op2->pass ||
+	    op1->mesh.mesh != op2->mesh.mesh ||
+	    op1->mesh.lod != op2->mesh.lod ||
+	    op1->mesh.props.animation ||
+	    op2->mesh.props.animation) {
+		return 0;
+	}
+
+	// shadow pipeline only depends on light-space transform
+	if (op1->pass == SHADOW_PASS) {
+		return memcmp(
+			&op1->mesh.light.projection,
+			&op2->mesh.light.projection,
+			sizeof(Mat)
+		) == 0;
+	}
+
+	// depth pre-pass only depends on camera transforms
+	if (op1->pass == DEPTH_PASS) {
+		return (
+			memcmp(&op1->transform.view, &op2->transform.view, sizeof(Mat)) == 0 &&
+			memcmp(&op1->transform.projection, &op2->transform.projection, sizeof(Mat)) == 0
+		);
+	}
+
+	if (op1->mesh.props.material != op2->mesh.props.material ||
+	    op1->mesh.props.receive_shadows != op2->mesh.props.receive_shadows ||
+	    op1->mesh.is_lit != op2->mesh.is_lit) {
+		return 0;
+	}
+
+	// lights of unlit operations are zeroed, thus comparable as well
+	const struct Light *l1 = &op1->mesh.light, *l2 = &op2->mesh.light;
+	return (
+		memcmp(&l1->projection, &l2->projection, sizeof(Mat)) == 0 &&
+		memcmp(&l1->direction, &l2->direction, sizeof(Vec)) == 0 &&
+		memcmp(&l1->color, &l2->color, sizeof(Vec)) == 0 &&
+		l1->ambient_intensity == l2->ambient_intensity &&
+		l1->diffuse_intensity == l2->diffuse_intensity &&
+		memcmp(&op1->mesh.eye, &op2->mesh.eye, sizeof(Vec)) == 0 &&
+		memcmp(&op1->transform.view, &op2->transform.view, sizeof(Mat)) == 0 &&
+		memcmp(&op1->transform.projection, &op2->transform.projection, sizeof(Mat)) == 0
+	);
+}
+
+/*
+ * Render operation sort key layout, from the most significant bit:
+ *
+ *   63..62  pass
+ *   61..60  layer (opaque or translucent)
+ *
+ * Opaque layer, grouped by pipeline state in order of switch cost:
+ *   59..56  pipeline
+ *   55..40  material
+ *
+ *   with RENDER_SORT_STATE:
+ *   39..24  mesh
+ *   23..20  level of detail
+ *   19..0   unused
+ *
+ *   with RENDER_SORT_FRONT_TO_BACK, render and depth passes only:
+ *   39..24  view-space distance, coarse
+ *   23..8   mesh
+ *   7..4    level of detail
+ *   3..0    unused
+ *
+ * Translucent layer, ordered back to front:
+ *   59..28  view-space depth
+ *   27..24  pipeline
+ *   23..8   texture
+ *   7..0    unused
+ *
+ * Material, mesh and texture are folded pointers: distinct objects may
+ * collide and end up interleaved, which costs state changes but not
+ * correctness. The sort is stable, thus operations with equal keys are
+ * executed in submission order.
+ *
+ * The coarse distance keeps only the upper half of its float bits, i.e. the
+ * exponent and a few mantissa bits, so that operations within a few percent
+ * of the same distance still cluster by mesh and get batched together.
+ */
+enum {
+	LAYER_OPAQUE,
+	LAYER_TRANSLUCENT
+};
+
+#define KEY_PASS_SHIFT 62
+#define KEY_LAYER_SHIFT 60
+#define KEY_OPAQUE_PIPELINE_SHIFT 56
+#define KEY_OPAQUE_MATERIAL_SHIFT 40
+#define KEY_OPAQUE_MESH_SHIFT 24
+#define KEY_OPAQUE_LOD_SHIFT 20
+#define KEY_OPAQUE_DISTANCE_SHIFT 24
+#define KEY_OPAQUE_SORTED_MESH_SHIFT 8
+#define KEY_OPAQUE_SORTED_LOD_SHIFT 4
+#define KEY_TRANSLUCENT_DEPTH_SHIFT 28
+#define KEY_TRANSLUCENT_PIPELINE_SHIFT 24
+#define KEY_TRANSLUCENT_TEXTURE_SHIFT 8
+
+static uint64_t
+key_ptr(const void *ptr)
 {
-	const struct RenderOp *op1 = ptr1, *op2 = ptr2;
+	// fold the address bits above allocation alignment into 16 bits
+	uint64_t v = (uintptr_t)ptr >> 4;
+	v ^= v >> 16;
+	v ^= v >> 32;
+	return v & 0xffff;
+}
+
+static uint64_t
+key_depth(float z)
+{
+	// map the float onto an unsigned integer with the same ordering
+	uint32_t bits;
+	memcpy(&bits, &z, sizeof(bits));
+	bits = bits & 0x80000000 ? ~bits : bits | 0x80000000;
+	return bits;
+}
+
+uint64_t
+render_op_key(const struct RenderOp *op)
+{
+	uint64_t key = (uint64_t)op->pass << KEY_PASS_SHIFT;
 
 	// meshes come first as they are non-transparent non-translucent opaque
 	// objects by definition
-	if (op1->type == MESH_OP && op2->type == MESH_OP) {
-		if (op1->mesh.mesh < op2->mesh.mesh) {
-			return -1;
-		} else if (op1->mesh.mesh == op2->mesh.mesh) {
-			return 0;
+	if (op->type == MESH_OP) {
+		const struct Material *material = op->mesh.props.material;
+		key |= (uint64_t)LAYER_OPAQUE << KEY_LAYER_SHIFT;
+		key |= (uint64_t)op->type << KEY_OPAQUE_PIPELINE_SHIFT;
+		if (op->pass == RENDER_PASS) {
+			key |= key_ptr(material) << KEY_OPAQUE_MATERIAL_SHIFT;
 		}
-		return 1;
-	} else if (op1->type == MESH_OP) {
-		return -1;
-	} else if (op2->type == MESH_OP) {
-		return 1;
+		if (op->pass != SHADOW_PASS &&
+		    sort_mode == RENDER_SORT_FRONT_TO_BACK) {
+			// camera looks down negative Z axis
+			uint64_t distance = key_depth(-op->position.data[2]) >> 16;
+			key |= distance << KEY_OPAQUE_DISTANCE_SHIFT;
+			key |= key_ptr(op->mesh.mesh) << KEY_OPAQUE_SORTED_MESH_SHIFT;
+			key |= (uint64_t)op->mesh.lod << KEY_OPAQUE_SORTED_LOD_SHIFT;
+		} else {
+			key |= key_ptr(op->mesh.mesh) << KEY_OPAQUE_MESH_SHIFT;
+			key |= (uint64_t)op->mesh.lod << KEY_OPAQUE_LOD_SHIFT;
+		}
+		return key;
 	}
 
 	// TODO: this is a simple Z-based sort, which works only for text and
 	// quads which are rendered using a non-rotated orthographic projection
 	// volume
-	if (op1->position.data[2] < op2->position.data[2]) {
-		return -1;
-	} else if (fabs(op1->position.data[2] - op2->position.data[2]) < 1e-6) {
-		return 0;
-	}
-	return 1;
+	const void *texture = (
+		op->type == TEXT_OP
+		? (const void*)op->text.text->font
+		: (const void*)op->quad.props.texture
+	);
+	key |= (uint64_t)LAYER_TRANSLUCENT << KEY_LAYER_SHIFT;
+	key |= key_depth(op->position.data[2]) << KEY_TRANSLUCENT_DEPTH_SHIFT;
+	key |= (uint64_t)op->type << KEY_TRANSLUCENT_PIPELINE_SHIFT;
+	key |= key_ptr(texture) << KEY_TRANSLUCENT_TEXTURE_SHIFT;
+	return key;
 }
 
 static int
@@ -182,69 +501,238 @@ render_queue_exec(struct RenderQueue *q)
 {
 	int ok = 1;
 
-	// compute op target position in world coordinates
+	if (q->len == 0) {
+		return 1;
+	}
+
+	double start = clock_ms();
+	TRACE_BEGIN("render", "sort");
+
+	// allocate key arrays for the queue and its sorting scratch space, and
+	// the array of sorted operations
+	struct SortKey *keys = arena_alloc(
+		frame_arena,
+		sizeof(struct SortKey) * q->len * 2
+	);
+	struct RenderOp **ops = arena_alloc(
+		frame_arena,
+		sizeof(struct RenderOp*) * q->len
+	);
+	if (!keys || !ops) {
+		TRACE_END();
+		return 0;
+	}
+
+	// compute op target position in world coordinates and its sort key
 	Mat modelview;
 	Vec origin = vec(0, 0, 0, 1);
 	for (size_t i = 0; i < q->len; i++) {
-		mat_mul(
-			&q->queue[i].transform.view,
-			&q->queue[i].transform.model,
-			&modelview
-		);
-		mat_mulv(&modelview, &origin, &q->queue[i].position);
+		struct RenderOp *op = q->queue[i];
+		mat_mul(&op->transform.view, &op->transform.model, &modelview);
+		mat_mulv(&modelview, &origin, &op->position);
+		keys[i].key = render_op_key(op);
+		keys[i].index = i;
+	}
+
+	// sort operations in render queue as specified by `render_op_key()`
+	keys = radix_sort(keys, keys + q->len, q->len);
+
+	for (size_t i = 0; i < q->len; i++) {
+		ops[i] = q->queue[keys[i].index];
 	}
 
-	// sort operations in render queue as specified by `render_op_cmp()`
-	qsort(q->queue, q->len, sizeof(struct RenderOp), render_op_cmp);
+	TRACE_END();
+	double sorted = clock_ms();
+	timings.cpu_sort += sorted - start;
 
-	// execute render operations
-	for (int i = 0; i < q->len; i++) {
-		struct RenderOp *op = &q->queue[i];
-		ok &= op->exec(op);
+	// execute render operations, merging runs of batchable ones; frame
+	// constants are streamed anew at the beginning of each pass and
+	// whenever camera or light setup changes within it
+	TRACE_BEGIN("render", "exec");
+	invalidate_frame();
+	for (size_t i = 0, n; i < q->len; i += n) {
+		for (n = 1; i + n < q->len; n++) {
+			if (!render_op_batchable(ops[i], ops[i + n])) {
+				break;
+			}
+		}
+		ok &= ops[i]->exec(ops + i, n);
 	}
+	TRACE_END();
+
+	timings.cpu_exec += clock_ms() - sorted;
 	return ok;
 }
 
-int
-renderer_init(void)
+static size_t
+collect_animated_ops(struct RenderQueue *q, struct RenderOp **ops)
 {
-	// initialize GLEW
-	glewExperimental = GL_TRUE;
-	if (glewInit() != 0) {
-		err(ERR_GLEW);
+	size_t count = 0;
+	for (size_t i = 0; i < q->len; i++) {
+		struct RenderOp *op = q->queue[i];
+		if (op->type == MESH_OP && op->mesh.props.animation) {
+			ops[count++] = op;
+		}
+	}
+	return count;
+}
+
+/**
+ * Computes skinning palettes of all animation instances referenced by queued
+ * operations.
+ *
+ * Each unique animation instance is evaluated once and gets its own palette in
+ * the shared palette buffer, whose index is stored in every operation which
+ * refers to it, so that shadow and render passes of the same mesh only bind
+ * the palette range.
+ */
+static int
+prepare_skinning(void)
+{
+	size_t len = (
+		shadow_queue.len +
+		depth_queue.len +
+		render_queue.len +
+		overlay_queue.len
+	);
+	if (len == 0) {
+		return 1;
+	}
+
+	struct RenderOp **ops = arena_alloc(
+		frame_arena,
+		sizeof(struct RenderOp*) * len
+	);
+	if (!ops) {
 		return 0;
 	}
-	// silence any errors produced during GLEW initialization
-	glGetError();
+	size_t count = 0;
+	count += collect_animated_ops(&shadow_queue, ops + count);
+	count += collect_animated_ops(&depth_queue, ops + count);
+	count += collect_animated_ops(&render_queue, ops + count);
+	count += collect_animated_ops(&overlay_queue, ops + count);
+	if (count == 0) {
+		return 1;
+	}
+
+	// group operations by animation instance
+	struct SortKey *keys = arena_alloc(
+		frame_arena,
+		sizeof(struct SortKey) * count * 2
+	);
+	struct AnimationInstance **instances = arena_alloc(
+		frame_arena,
+		sizeof(struct AnimationInstance*) * count
+	);
+	if (!keys || !instances) {
+		return 0;
+	}
+	for (size_t i = 0; i < count; i++) {
+		keys[i].key = (uintptr_t)ops[i]->mesh.props.animation;
+		keys[i].index = i;
+	}
+	keys = radix_sort(keys, keys + count, count);
 
+	// assign a palette to each unique instance
+	size_t palette_count = 0;
+	for (size_t i = 0; i < count; i++) {
+		struct RenderOp *op = ops[keys[i].index];
+		if (i == 0 || keys[i].key != keys[i - 1].key) {
+			instances[palette_count++] = op->mesh.props.animation;
+		}
+		op->mesh.palette = palette_count - 1;
+	}
+
+	return update_skinning_palettes(instances, palette_count);
+}
+
+/**
+ * Initialize the renderer, once OpenGL entry points are loaded.
+ *
+ * On failure, everything is released with `renderer_shutdown()`.
+ */
+static int
+init(void)
+{
 	// one-off OpenGL initializations
 	glClearColor(0.3, 0.3, 0.3, 1.0);
 	glEnable(GL_DEPTH_TEST);
 
+	// reserve a texture unit for shadow map, which the mesh pipeline
+	// samples from
+	glGetIntegerv(
+		GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS,
+		&shadow_map_tu
+	);
+	shadow_map_tu -= 1;
+
 	// initialize pipelines
-	if (!init_mesh_pipeline() ||
+	if (!init_draw_common() ||
+	    !init_mesh_pipeline(shadow_map_tu) ||
 	    !init_shadow_pipeline() ||
 	    !init_text_pipeline() ||
 	    !init_quad_pipeline()) {
 		errf(ERR_GENERIC, "pipelines initialization failed");
-		renderer_shutdown();
-		return 0;
+		goto error;
 	}
 
 	// create shadow map
 	if (!(shadow_map = shadow_map_new(1024, 1024))) {
 		errf(ERR_GENERIC, "shadow map creation failed");
-		return 0;
+		goto error;
 	}
 
-	// reserve a texture unit for shadow map
-	glGetIntegerv(
-		GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS,
-		&shadow_map_tu
-	);
-	shadow_map_tu -= 1;
+	// create the arena render queues are allocated from
+	if (!(frame_arena = arena_new(RENDER_ARENA_BLOCK_SIZE))) {
+		errf(ERR_GENERIC, "render queue arena creation failed");
+		goto error;
+	}
+
+	// create the timer for GPU pass timings
+	if (!(gpu_timer = gpu_timer_new(MARK_COUNT))) {
+		errf(ERR_GENERIC, "GPU timer creation failed");
+		goto error;
+	}
 
 	return 1;
+
+error:
+	renderer_shutdown();
+	return 0;
+}
+
+int
+renderer_init(void)
+{
+	// initialize GLEW
+	glewExperimental = GL_TRUE;
+	GLenum glew_status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// GLX-enabled GLEW fails on its window system bindings when the
+	// context is not bound to an X display (headless mode), after having
+	// already loaded the core entry points
+	if (glew_status == GLEW_ERROR_NO_GLX_DISPLAY) {
+		glew_status = GLEW_OK;
+	}
+#endif
+	if (glew_status != GLEW_OK) {
+		err(ERR_GLEW);
+		renderer_shutdown();
+		return 0;
+	}
+	gl_api_init();
+
+	// silence any errors produced during GLEW initialization
+	glGetError();
+
+	return init();
+}
+
+int
+renderer_init_null(void)
+{
+	gl_api_init_null();
+	return init();
 }
 
 void
@@ -257,46 +745,173 @@ int
 renderer_present(void)
 {
 	int ok = 1;
+	double start = clock_ms();
+	TRACE_BEGIN("render", "renderer_present");
+
+	memset(&render_stats, 0, sizeof(render_stats));
+
+	// meshes loaded in the background; their buffer setup binds vertex
+	// arrays directly, thus it goes before the state tracker is reset
+	TRACE_BEGIN("render", "mesh uploads");
+	upload_mesh_loads(upload_budget);
+	TRACE_END();
+	timings.cpu_upload = clock_ms() - start;
+
+	// state might have been changed by OpenGL calls made out of the
+	// renderer since last frame
+	gl_state_invalidate();
+	last_stats.shadow_ops = shadow_queue.len;
+	last_stats.depth_ops = depth_queue.len;
+	last_stats.render_ops = render_queue.len;
+	last_stats.overlay_ops = overlay_queue.len;
+
+	// frame capture, of queues as submitted
+	if (capture_filename) {
+		struct RenderOp **queues[QUEUE_COUNT] = {
+			[SHADOW_QUEUE] = shadow_queue.queue,
+			[RENDER_QUEUE] = render_queue.queue,
+			[OVERLAY_QUEUE] = overlay_queue.queue
+		};
+		size_t lens[QUEUE_COUNT] = {
+			[SHADOW_QUEUE] = shadow_queue.len,
+			[RENDER_QUEUE] = render_queue.len,
+			[OVERLAY_QUEUE] = overlay_queue.len
+		};
+		// a failed capture is reported but does not drop the frame
+		if (!write_frame_capture(capture_filename, queues, lens)) {
+			errf(ERR_GENERIC, "frame capture failed");
+		}
+		free(capture_filename);
+		capture_filename = NULL;
+	}
+
+	// skinning stage
+	double skinning = clock_ms();
+	TRACE_BEGIN("render", "skinning");
+	ok = prepare_skinning();
+	TRACE_END();
+	timings.cpu_skinning = clock_ms() - skinning;
+	if (!ok) {
+		errf(ERR_GENERIC, "skinning failed");
+		goto cleanup;
+	}
+
+	gpu_timer_mark(gpu_timer, MARK_BEGIN);
 
 	// shadows pass
+	TRACE_BEGIN("render", "shadow pass");
 	int viewport[4];
 	glGetIntegerv(GL_VIEWPORT, viewport);
 	glViewport(0, 0, shadow_map->width, shadow_map->height);
 	glBindFramebuffer(GL_FRAMEBUFFER, shadow_map->fbo);
 	glClear(GL_DEPTH_BUFFER_BIT);
 	ok = render_queue_exec(&shadow_queue);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gpu_timer_mark(gpu_timer, MARK_SHADOW);
+	glBindFramebuffer(GL_FRAMEBUFFER, target_fbo);
 	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	TRACE_END();
 	if (!ok) {
 		errf(ERR_GENERIC, "shadow pass failed");
 		goto cleanup;
 	}
 
-	// render pass
-	glActiveTexture(GL_TEXTURE0 + shadow_map_tu);
-	glBindTexture(GL_TEXTURE_2D, shadow_map->texture);
+	// depth pre-pass; fills the depth buffer with opaque meshes, so that
+	// the render pass shades only visible fragments
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	int prepassed = depth_queue.len > 0;
+	if (prepassed) {
+		TRACE_BEGIN("render", "depth pre-pass");
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		ok = render_queue_exec(&depth_queue);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		TRACE_END();
+		if (!ok) {
+			errf(ERR_GENERIC, "depth pre-pass failed");
+			goto cleanup;
+		}
+		gl_state_depth_func(GL_LEQUAL);
+		gl_state_depth_mask(GL_FALSE);
+	}
+	gpu_timer_mark(gpu_timer, MARK_DEPTH);
+
+	// render pass
+	TRACE_BEGIN("render", "render pass");
+	gl_state_bind_texture(shadow_map_tu, GL_TEXTURE_2D, shadow_map->texture);
 	ok = render_queue_exec(&render_queue);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	gpu_timer_mark(gpu_timer, MARK_RENDER);
+	gl_state_bind_texture(shadow_map_tu, GL_TEXTURE_2D, 0);
+	if (prepassed) {
+		gl_state_depth_func(GL_LESS);
+		gl_state_depth_mask(GL_TRUE);
+	}
+	TRACE_END();
 	if (!ok) {
 		errf(ERR_GENERIC, "render pass failed");
 		goto cleanup;
 	}
 
 	// overlay pass
+	TRACE_BEGIN("render", "overlay pass");
 	glClear(GL_DEPTH_BUFFER_BIT);
-	glDisable(GL_DEPTH_TEST);
+	gl_state_enable(GL_DEPTH_TEST, 0);
 	ok = render_queue_exec(&overlay_queue);
-	glEnable(GL_DEPTH_TEST);
+	gpu_timer_mark(gpu_timer, MARK_OVERLAY);
+	gl_state_enable(GL_DEPTH_TEST, 1);
+	TRACE_END();
 	if (!ok) {
 		errf(ERR_GENERIC, "overlay pass failed");
 		goto cleanup;
 	}
 
 cleanup:
+	// leave blending disabled as it was before the frame
+	gl_state_enable(GL_BLEND, 0);
+
+	last_stats.draw_calls = render_stats.draw_calls;
+	last_stats.triangles = render_stats.triangles;
+	last_stats.program_binds = render_stats.program_binds;
+	last_stats.vertex_array_binds = render_stats.vertex_array_binds;
+	last_stats.texture_binds = render_stats.texture_binds;
+	last_stats.uniform_calls = render_stats.uniform_calls;
+	last_stats.bytes_uploaded = render_stats.bytes_uploaded;
+	last_stats.gl_calls = render_stats.gl_calls;
+	last_stats.state_changes = render_stats.state_changes;
+	last_stats.state_changes_skipped = render_stats.state_changes_skipped;
+
 	render_queue_flush(&shadow_queue);
+	render_queue_flush(&depth_queue);
 	render_queue_flush(&render_queue);
 	render_queue_flush(&overlay_queue);
+	arena_reset(frame_arena);
+
+	// culling happens as meshes are submitted, thus counters cover the
+	// operations rendered in this frame
+	last_stats.visible = cull_stats.visible;
+	last_stats.culled = cull_stats.culled;
+	last_stats.shadow_visible = cull_stats.shadow_visible;
+	last_stats.shadow_culled = cull_stats.shadow_culled;
+	memset(&cull_stats, 0, sizeof(cull_stats));
+
+	// collect GPU timings of an earlier frame, if available, or carry on
+	// the last known ones
+	GLuint64 ts[MARK_COUNT];
+	if (gpu_timer_end_frame(gpu_timer, ts)) {
+		timings.gpu_shadow = (ts[MARK_SHADOW] - ts[MARK_BEGIN]) / 1e6;
+		timings.gpu_depth = (ts[MARK_DEPTH] - ts[MARK_SHADOW]) / 1e6;
+		timings.gpu_render = (ts[MARK_RENDER] - ts[MARK_DEPTH]) / 1e6;
+		timings.gpu_overlay = (ts[MARK_OVERLAY] - ts[MARK_RENDER]) / 1e6;
+		timings.gpu_total = (ts[MARK_OVERLAY] - ts[MARK_BEGIN]) / 1e6;
+	} else {
+		timings.gpu_shadow = last_timings.gpu_shadow;
+		timings.gpu_depth = last_timings.gpu_depth;
+		timings.gpu_render = last_timings.gpu_render;
+		timings.gpu_overlay = last_timings.gpu_overlay;
+		timings.gpu_total = last_timings.gpu_total;
+	}
+	timings.cpu_total = clock_ms() - start;
+	last_timings = timings;
+	memset(&timings, 0, sizeof(timings));
+	TRACE_END();
 
 	return ok;
 }
@@ -306,6 +921,257 @@ renderer_shutdown(void)
 {
 	shadow_map_free(shadow_map);
 	shadow_map = NULL;
+
+	render_queue_flush(&shadow_queue);
+	render_queue_flush(&depth_queue);
+	render_queue_flush(&render_queue);
+	render_queue_flush(&overlay_queue);
+	arena_free(frame_arena);
+	frame_arena = NULL;
+
+	memset(&cull_stats, 0, sizeof(cull_stats));
+
+	gpu_timer_free(gpu_timer);
+	gpu_timer = NULL;
+	memset(&last_stats, 0, sizeof(last_stats));
+	memset(&timings, 0, sizeof(timings));
+	memset(&last_timings, 0, sizeof(last_timings));
+
+	free(capture_filename);
+	capture_filename = NULL;
+	shutdown_capture();
+	shutdown_mesh_loads();
+	shutdown_draw_common();
+
+	// the headless context, if any, goes last
+	shutdown_headless();
+	gl_api_shutdown();
+}
+
+/**
+ * Set the framebuffer the render and overlay passes draw to.
+ */
+void
+set_target_framebuffer(GLuint fbo)
+{
+	target_fbo = fbo;
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+int
+renderer_read_pixels(unsigned width, unsigned height, void *pixels)
+{
+	assert(pixels != NULL);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target_fbo);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	if (glGetError() != GL_NO_ERROR) {
+		errf(ERR_OPENGL, "framebuffer readback failed");
+		return 0;
+	}
+	return 1;
+}
+
+int
+renderer_capture_frame(const char *filename)
+{
+	assert(filename != NULL);
+
+	char *copy = string_fmt("%s", filename);
+	if (!copy) {
+		err(ERR_NO_MEM);
+		return 0;
+	}
+	free(capture_filename);
+	capture_filename = copy;
+	return 1;
+}
+
+int
+renderer_set_option(int option, int value)
+{
+	switch (option) {
+	case RENDER_OPTION_SORT_MODE:
+		if (value != RENDER_SORT_STATE &&
+		    value != RENDER_SORT_FRONT_TO_BACK) {
+			errf(ERR_GENERIC, "invalid sort mode %d", value);
+			return 0;
+		}
+		sort_mode = value;
+		return 1;
+	case RENDER_OPTION_DEPTH_PREPASS:
+		depth_prepass = value != 0;
+		return 1;
+	case RENDER_OPTION_OPTIMIZE_MESHES:
+		optimize_meshes = value != 0;
+		return 1;
+	case RENDER_OPTION_MESH_LODS:
+		if (value < 1 || value > MESH_MAX_LODS) {
+			errf(ERR_GENERIC, "invalid mesh LOD count %d", value);
+			return 0;
+		}
+		mesh_lods = value;
+		return 1;
+	case RENDER_OPTION_SHADOW_LOD_BIAS:
+		if (value < 0) {
+			errf(ERR_GENERIC, "invalid shadow LOD bias %d", value);
+			return 0;
+		}
+		shadow_lod_bias = value;
+		return 1;
+	case RENDER_OPTION_UPLOAD_BUDGET:
+		if (value < 1) {
+			errf(ERR_GENERIC, "invalid upload budget %d", value);
+			return 0;
+		}
+		upload_budget = value;
+		return 1;
+	}
+	errf(ERR_GENERIC, "unknown renderer option %d", option);
+	return 0;
+}
+
+int
+renderer_get_option(int option)
+{
+	switch (option) {
+	case RENDER_OPTION_SORT_MODE:
+		return sort_mode;
+	case RENDER_OPTION_DEPTH_PREPASS:
+		return depth_prepass;
+	case RENDER_OPTION_OPTIMIZE_MESHES:
+		return optimize_meshes;
+	case RENDER_OPTION_MESH_LODS:
+		return mesh_lods;
+	case RENDER_OPTION_SHADOW_LOD_BIAS:
+		return shadow_lod_bias;
+	case RENDER_OPTION_UPLOAD_BUDGET:
+		return upload_budget;
+	}
+	return -1;
+}
+
+void
+renderer_get_stats(struct RenderStats *s)
+{
+	assert(s != NULL);
+	*s = last_stats;
+}
+
+void
+renderer_get_frame_timings(struct RenderFrameTimings *t)
+{
+	assert(t != NULL);
+	*t = last_timings;
+}
+
+size_t
+renderer_get_queue_memory_peak(void)
+{
+	return frame_arena ? arena_peak(frame_arena) : 0;
+}
+
+/**
+ * Tell whether a mesh lies entirely outside of the clip volume.
+ *
+ * Clip volume planes are extracted from the local-to-clip transform, so that
+ * they are expressed in mesh local space, where the bounding sphere is tested
+ * first and the bounding box only when the sphere straddles a plane. Works
+ * with both perspective and orthographic projections.
+ */
+static int
+mesh_culled(const struct Mesh *mesh, const Mat *mvp)
+{
+	const float *m = mvp->data;
+	const float *min = mesh->bounds.min.data;
+	const float *max = mesh->bounds.max.data;
+	const float *center = mesh->bounds.center.data;
+	float radius = mesh->bounds.radius;
+
+	// planes are `w + x`, `w - x`, `w + y`, `w - y`, `w + z`, `w - z`
+	// clip coordinates, i.e. sums of the last row with the others
+	for (int p = 0; p < 6; p++) {
+		float sign = p % 2 ? -1.0f : 1.0f;
+		const float *row = m + (p / 2) * 4;
+		float plane[4];
+		for (int c = 0; c < 4; c++) {
+			plane[c] = m[12 + c] + sign * row[c];
+		}
+		float len = sqrtf(
+			plane[0] * plane[0] +
+			plane[1] * plane[1] +
+			plane[2] * plane[2]
+		);
+		if (len == 0) {
+			continue;
+		}
+
+		float dist = (
+			plane[0] * center[0] +
+			plane[1] * center[1] +
+			plane[2] * center[2] +
+			plane[3]
+		) / len;
+		if (dist < -radius) {
+			return 1;
+		} else if (dist < radius) {
+			// test the box corner farthest along plane normal
+			float corner = plane[3];
+			for (int c = 0; c < 3; c++) {
+				corner += plane[c] * (plane[c] >= 0 ? max[c] : min[c]);
+			}
+			if (corner < 0) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * Select the coarsest level of detail of a mesh whose error, projected on
+ * screen at the distance of the mesh, stays within LOD_SCREEN_ERROR.
+ */
+static size_t
+mesh_lod(const struct Mesh *mesh, const Mat *mv, const Mat *projection)
+{
+	if (mesh->lod_count < 2) {
+		return 0;
+	}
+
+	// largest scale along model-view axes
+	const float *m = mv->data;
+	float scale = 0;
+	for (int c = 0; c < 3; c++) {
+		float len = sqrtf(m[c] * m[c] + m[4 + c] * m[4 + c] + m[8 + c] * m[8 + c]);
+		scale = len > scale ? len : scale;
+	}
+
+	// clip space W of the bounds center, which is the view distance for
+	// perspective projections and 1 for orthographic ones
+	const float *center = mesh->bounds.center.data;
+	float view[4];
+	for (int r = 0; r < 3; r++) {
+		const float *row = m + r * 4;
+		view[r] = row[0] * center[0] + row[1] * center[1] + row[2] * center[2] + row[3];
+	}
+	view[3] = 1;
+	const float *p = projection->data;
+	float w = p[12] * view[0] + p[13] * view[1] + p[14] * view[2] + p[15];
+	if (w <= mesh->bounds.radius * scale * fabsf(p[14])) {
+		// camera within the bounding sphere
+		return 0;
+	}
+
+	// viewport height fractions per local space unit
+	float size = scale * fabsf(p[5]) / w * 0.5f;
+	for (size_t l = mesh->lod_count - 1; l > 0; l--) {
+		if (mesh->lods[l].error * size <= LOD_SCREEN_ERROR) {
+			return l;
+		}
+	}
+	return 0;
 }
 
 int
@@ -333,6 +1199,13 @@ render_mesh(
 		.exec = exec_mesh_op
 	};
 
+	// skinning can move vertices out of bind pose bounds, thus animated
+	// meshes are never culled
+	int cull = props->animation == NULL;
+	Mat mv, mvp;
+	mat_mul(&t->view, &t->model, &mv);
+	size_t lod = mesh_lod(mesh, &mv, &t->projection);
+
 	// enable lighting and shadow casting only if light parameters are
 	// specified
 	if (light && eye && render_target == RENDER_TARGET_FRAMEBUFFER) {
@@ -340,14 +1213,35 @@ render_mesh(
 		op.mesh.light = *light;
 		op.mesh.eye = *eye;
 
-		// shadow pass
+		// shadow pass, culled against light volume
 		if (props->cast_shadows) {
-			op.pass = SHADOW_PASS;
-			ok &= render_queue_push(&shadow_queue, &op);
+			mat_mul(&light->projection, &t->model, &mvp);
+			if (cull && mesh_culled(mesh, &mvp)) {
+				cull_stats.shadow_culled++;
+			} else {
+				cull_stats.shadow_visible++;
+				op.pass = SHADOW_PASS;
+				op.mesh.lod = lod + shadow_lod_bias;
+				if (op.mesh.lod >= mesh->lod_count) {
+					op.mesh.lod = mesh->lod_count - 1;
+				}
+				ok &= render_queue_push(&shadow_queue, &op);
+			}
 		}
 	}
 
-	// render pass
+	// render pass, culled against camera frustum
+	op.mesh.lod = lod;
+	mat_mul(&t->projection, &mv, &mvp);
+	if (cull && mesh_culled(mesh, &mvp)) {
+		cull_stats.culled++;
+		return ok;
+	}
+	cull_stats.visible++;
+	if (depth_prepass && render_target == RENDER_TARGET_FRAMEBUFFER) {
+		op.pass = DEPTH_PASS;
+		ok &= render_queue_push(&depth_queue, &op);
+	}
 	op.pass = RENDER_PASS;
 	if (render_target == RENDER_TARGET_FRAMEBUFFER) {
 		ok &= render_queue_push(&render_queue, &op);
@@ -402,4 +1296,51 @@ render_quad(
 		return render_queue_push(&render_queue, &op);
 	}
 	return render_queue_push(&overlay_queue, &op);
-}
\ No newline at end of file
+}
+
+/**
+ * Push an operation to a queue as is, bypassing culling.
+ *
+ * Used by frame replay. Render queue meshes get their depth pre-pass
+ * operation as in `render_mesh()`, thus replays honor current options.
+ */
+int
+submit_render_op(int queue, const struct RenderOp *op)
+{
+	assert(op != NULL);
+
+	struct RenderOp dst = *op;
+	switch (dst.type) {
+	case MESH_OP:
+		dst.exec = exec_mesh_op;
+		break;
+	case TEXT_OP:
+		dst.exec = exec_text_op;
+		break;
+	case QUAD_OP:
+		dst.exec = exec_quad_op;
+		break;
+	default:
+		errf(ERR_GENERIC, "unknown render op type %d", dst.type);
+		return 0;
+	}
+
+	int ok = 1;
+	switch (queue) {
+	case SHADOW_QUEUE:
+		dst.pass = SHADOW_PASS;
+		return render_queue_push(&shadow_queue, &dst);
+	case RENDER_QUEUE:
+		if (depth_prepass && dst.type == MESH_OP) {
+			dst.pass = DEPTH_PASS;
+			ok &= render_queue_push(&depth_queue, &dst);
+		}
+		dst.pass = RENDER_PASS;
+		return ok && render_queue_push(&render_queue, &dst);
+	case OVERLAY_QUEUE:
+		dst.pass = RENDER_PASS;
+		return render_queue_push(&overlay_queue, &dst);
+	}
+	errf(ERR_GENERIC, "unknown render queue %d", queue);
+	return 0;
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 // renderlib
 #include "anim.h"
 #include "camera.h"
@@ -73,17 +75,138 @@ struct QuadProps {
 	float opacity;                // opacity; 0 = transparent, 1 = opaque
 };
 
+/**
+ * Frame statistics.
+ */
+struct RenderStats {
+	size_t draw_calls;            // draw calls issued
+	size_t triangles;             // triangles drawn, all instances included
+	size_t program_binds;         // shader program switches
+	size_t vertex_array_binds;    // vertex array switches
+	size_t texture_binds;         // texture binds
+	size_t uniform_calls;         // `glUniform*()` calls
+	size_t bytes_uploaded;        // bytes written to mapped buffers or
+	                              // uploaded by background mesh loads
+	size_t gl_calls;              // OpenGL calls, counted by null backend only
+	size_t state_changes;         // state changes submitted to OpenGL
+	size_t state_changes_skipped; // redundant state changes filtered out
+	size_t visible;               // meshes queued for render pass
+	size_t culled;                // meshes outside of camera frustum
+	size_t shadow_visible;        // meshes queued for shadow pass
+	size_t shadow_culled;         // meshes outside of light volume
+	size_t shadow_ops;            // shadow pass queue length
+	size_t depth_ops;             // depth pre-pass queue length
+	size_t render_ops;            // render pass queue length
+	size_t overlay_ops;           // overlay pass queue length
+};
+
+/**
+ * Memory accounting categories, see `renderer_get_memory_stats()`.
+ */
+enum {
+	RENDER_MEMORY_MESH,           // meshes, vertex and index buffers
+	RENDER_MEMORY_ANIMATION,      // skeletons, animations and their instances
+	RENDER_MEMORY_TEXTURE,        // textures and shadow map
+	RENDER_MEMORY_FONT,           // fonts, glyph and atlas textures
+	RENDER_MEMORY_TEXT,           // texts, strings and vertex buffers
+	RENDER_MEMORY_UNIFORM,        // uniform buffers
+	RENDER_MEMORY_SCENE,          // scenes and their objects
+	RENDER_MEMORY_CATEGORY_COUNT
+};
+
+/**
+ * Memory usage of a category, in bytes.
+ */
+struct RenderMemoryStats {
+	size_t cpu;                   // heap memory in use
+	size_t cpu_peak;              // high-water mark of `cpu`
+	size_t gpu;                   // buffer and texture storage in use
+	size_t gpu_peak;              // high-water mark of `gpu`
+};
+
+/**
+ * Frame timings in milliseconds.
+ *
+ * CPU timings refer to the last presented frame, GPU ones to the most recent
+ * frame whose timer queries have completed, which lags a few frames behind.
+ */
+struct RenderFrameTimings {
+	double cpu_total;             // whole `renderer_present()` call
+	double cpu_upload;            // background mesh loads uploads
+	double cpu_skinning;          // skinning palettes evaluation
+	double cpu_sort;              // render queues sorting
+	double cpu_exec;              // render operations execution
+	double gpu_shadow;            // shadow pass
+	double gpu_depth;             // depth pre-pass
+	double gpu_render;            // render pass
+	double gpu_overlay;           // overlay pass
+	double gpu_total;             // all passes
+};
+
 enum {
 	RENDER_TARGET_FRAMEBUFFER,
 	RENDER_TARGET_OVERLAY
 };
 
+/**
+ * Renderer options, see `renderer_set_option()`.
+ */
+enum {
+	RENDER_OPTION_SORT_MODE,      // opaque mesh ordering, RENDER_SORT_*
+	RENDER_OPTION_DEPTH_PREPASS,  // 1 = draw opaque meshes depth-only first
+	RENDER_OPTION_OPTIMIZE_MESHES,// 1 = reorder mesh data for GPU caches at load
+	RENDER_OPTION_MESH_LODS,      // levels of detail generated at mesh load,
+	                              // 1 (default) to MESH_MAX_LODS
+	RENDER_OPTION_SHADOW_LOD_BIAS,// levels of detail coarser in shadow pass
+	RENDER_OPTION_UPLOAD_BUDGET   // bytes of mesh data uploaded per frame by
+	                              // background loads, 4 MiB by default
+};
+
+/**
+ * Opaque mesh ordering modes.
+ */
+enum {
+	RENDER_SORT_STATE,            // group by pipeline state only (default)
+	RENDER_SORT_FRONT_TO_BACK     // group by state, then front to back
+};
+
 /**
  * Initialize renderer library.
+ *
+ * Releases whatever was initialized on failure.
  */
 int
 renderer_init(void);
 
+/**
+ * Initialize renderer library without a window.
+ *
+ * Creates a surfaceless EGL context (e.g. Mesa llvmpipe) and an offscreen
+ * framebuffer of given size which frames are rendered to, so that the renderer
+ * can run on machines without display or GPU. Requires EGL support at build
+ * time. Shut down with `renderer_shutdown()` as usual.
+ */
+int
+renderer_init_headless(unsigned width, unsigned height);
+
+/**
+ * Initialize renderer library with the null OpenGL backend.
+ *
+ * No OpenGL context is needed: OpenGL calls are counted and discarded, so that
+ * the CPU side of the renderer (sorting, uniforms marshalling, state changes)
+ * can run and be measured apart from driver cost, see `RenderStats.gl_calls`.
+ */
+int
+renderer_init_null(void);
+
+/**
+ * Read back the contents of the framebuffer being rendered to.
+ *
+ * Pixels are written as tightly packed RGBA8, bottom row first.
+ */
+int
+renderer_read_pixels(unsigned width, unsigned height, void *pixels);
+
 /**
  * Clear render buffers.
  */
@@ -102,6 +225,74 @@ renderer_present(void);
 void
 renderer_shutdown(void);
 
+/**
+ * Set a renderer option.
+ *
+ * Options take effect from the next presented frame, or for meshes loaded
+ * afterwards in the case of RENDER_OPTION_OPTIMIZE_MESHES and
+ * RENDER_OPTION_MESH_LODS, and persist across renderer initializations.
+ * Returns 0 on unknown option or invalid value.
+ */
+int
+renderer_set_option(int option, int value);
+
+/**
+ * Return the value of a renderer option.
+ */
+int
+renderer_get_option(int option);
+
+/**
+ * Retrieve the statistics of the last presented frame.
+ */
+void
+renderer_get_stats(struct RenderStats *stats);
+
+/**
+ * Retrieve the CPU and GPU timings of recent frames.
+ */
+void
+renderer_get_frame_timings(struct RenderFrameTimings *timings);
+
+/**
+ * Return the peak amount of memory in bytes used by render queues in a single
+ * frame.
+ */
+size_t
+renderer_get_queue_memory_peak(void);
+
+/**
+ * Retrieve the memory usage of a `RENDER_MEMORY_*` category.
+ *
+ * GPU figures are computed from the sizes passed to OpenGL, the actual driver
+ * footprint may differ because of padding and alignment.
+ */
+void
+renderer_get_memory_stats(int category, struct RenderMemoryStats *stats);
+
+/**
+ * Reset memory high-water marks to current usage.
+ */
+void
+renderer_reset_memory_peaks(void);
+
+/**
+ * Write the events traced so far as Chrome trace JSON.
+ *
+ * The file can be opened with chrome://tracing or Perfetto, showing per-thread
+ * timelines of renderer passes, scene traversals, animations, asset loading
+ * and shader compilation. Each thread keeps its last 65536 events. Fails
+ * unless built with tracing enabled (`--with-trace`).
+ */
+int
+renderer_trace_dump(const char *filename);
+
+/**
+ * Discard the events traced so far.
+ */
+void
+renderer_trace_clear(void);
+
 /**
  * Render a mesh.
  */
@@ -136,3 +327,73 @@ render_quad(
 	struct QuadProps *props,
 	struct Transform *t
 );
+
+/**
+ * Asset types, as handed to frame replay asset loaders.
+ */
+enum {
+	RENDER_ASSET_MESH = 1,        // `struct Mesh`
+	RENDER_ASSET_TEXTURE,         // `struct Texture`
+	RENDER_ASSET_FONT             // `struct Font`
+};
+
+/**
+ * Associate an asset with an ID, e.g. the file it was loaded from.
+ *
+ * Frame captures refer to meshes, textures and fonts by ID, thus every asset
+ * referenced by a captured frame must be registered. Registering an asset
+ * again replaces its ID. Registrations are dropped by `renderer_shutdown()`.
+ */
+int
+renderer_register_asset(const void *asset, const char *id);
+
+/**
+ * Forget the ID of an asset, to be called before the asset is freed.
+ */
+void
+renderer_unregister_asset(const void *asset);
+
+/**
+ * Capture the next presented frame to a file.
+ *
+ * The operations of shadow, render and overlay queues are written as
+ * submitted, before sorting and batching, so that replays exercise the same
+ * paths as the original frame. Failing to write the capture is reported
+ * without affecting the frame itself.
+ */
+int
+renderer_capture_frame(const char *filename);
+
+/**
+ * Frame capture loaded for replay.
+ */
+struct RenderCapture;
+
+/**
+ * Load a frame capture.
+ *
+ * `load_asset` is called once for each asset referenced by the capture, with
+ * the asset type and the ID it was registered with, and returns the asset or
+ * NULL on failure. Loaded assets are owned by the caller and must outlive the
+ * capture.
+ */
+struct RenderCapture*
+render_capture_load(
+	const char *filename,
+	void *(*load_asset)(int type, const char *id, void *userdata),
+	void *userdata
+);
+
+/**
+ * Submit the operations of a frame capture to render queues.
+ *
+ * Operations bypass culling, as they were culled when captured.
+ */
+int
+render_capture_submit(struct RenderCapture *capture);
+
+/**
+ * Free a frame capture.
+ */
+void
+render_capture_free(struct RenderCapture *capture);
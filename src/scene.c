@@ -1,6 +1,8 @@
 #include "error.h"
 #include "renderlib.h"
 #include "scene.h"
+#include "stats.h"
+#include "trace.h"
 #include <datalib.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -22,6 +24,9 @@ struct ObjectInfo {
 	void *props;
 };
 
+// bytes allocated per scene object, accounted to memory statistics
+#define OBJECT_SIZE (sizeof(struct Object) + sizeof(struct ObjectInfo))
+
 typedef int (*RenderFunc)(
 	const struct Object*,
 	const struct ObjectInfo*,
@@ -119,6 +124,7 @@ scene_new(void)
 		free(scene);
 		return NULL;
 	}
+	mem_track(RENDER_MEMORY_SCENE, MEM_CPU, sizeof(struct Scene));
 
 	return scene;
 }
@@ -149,6 +155,7 @@ add_new_object(struct Scene *scene, int type, void *ptr, void *props)
 		free(info);
 		return NULL;
 	}
+	mem_track(RENDER_MEMORY_SCENE, MEM_CPU, OBJECT_SIZE);
 
 	return obj;
 }
@@ -177,6 +184,7 @@ scene_remove_object(struct Scene *scene, struct Object *object)
 	struct ObjectInfo *info = hash_table_pop(scene->objects, object);
 	free(object);
 	free(info);
+	mem_track(RENDER_MEMORY_SCENE, MEM_CPU, -(ptrdiff_t)OBJECT_SIZE);
 }
 
 size_t
@@ -195,9 +203,11 @@ scene_free(struct Scene *scene)
 		while (hash_table_iter_next(&iter, (const void**)&k, &v)) {
 			free(k);
 			free(v);
+			mem_track(RENDER_MEMORY_SCENE, MEM_CPU, -(ptrdiff_t)OBJECT_SIZE);
 		}
 		hash_table_free(scene->objects);
 		free(scene);
+		mem_track(RENDER_MEMORY_SCENE, MEM_CPU, -(ptrdiff_t)sizeof(struct Scene));
 	}
 }
 
@@ -211,9 +221,11 @@ scene_render(
 	const struct Object *obj = NULL;
 	struct ObjectInfo *info = NULL;
 
+	int ok = 1;
 	struct HashTableIter iter;
 	hash_table_iter_init(scene->objects, &iter);
 
+	TRACE_BEGIN("scene", "scene_render");
 	if (light) {
 		light_update_projection(light, camera);
 	}
@@ -223,8 +235,10 @@ scene_render(
 			continue;
 		}
 		if (!renderers[info->type](obj, info, camera, light, render_target)) {
-			return 0;
+			ok = 0;
+			break;
 		}
 	}
-	return 1;
+	TRACE_END();
+	return ok;
 }
\ No newline at end of file
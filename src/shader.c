@@ -1,7 +1,11 @@
 #include "error.h"
 #include "file_utils.h"
+#include "gl_api.h"
+#include "gl_state.h"
 #include "shader.h"
+#include "stats.h"
 #include "string_utils.h"
+#include "trace.h"
 #include <assert.h>
 #include <matlib.h>
 #include <stdarg.h>
@@ -61,11 +65,14 @@ shader_source_from_string(const char *source, GLenum type)
 		goto error;
 	}
 
-	// set shader source and compile it
+	// set shader source and compile it; the status query waits for the
+	// compilation to complete
+	TRACE_BEGIN("shader", "shader compile");
 	glShaderSource(ss->src, 1, (const char**)&source, NULL);
 	glCompileShader(ss->src);
 	GLint status;
 	glGetShaderiv(ss->src, GL_COMPILE_STATUS, &status);
+	TRACE_END();
 	if (status == GL_FALSE) {
 		// fetch compile log
 		int log_len;
@@ -385,11 +392,13 @@ shader_new(struct ShaderSource **sources, unsigned count)
 		assert(sources[i]->src != 0);
 		glAttachShader(prog, sources[i]->src);
 	}
+	TRACE_BEGIN("shader", "shader link");
 	glLinkProgram(prog);
 
 	// retrieve link status
 	int status = GL_FALSE;
 	glGetProgramiv(prog, GL_LINK_STATUS, &status);
+	TRACE_END();
 	if (status == GL_FALSE) {
 		// retrieve link log
 		int log_len;
@@ -502,7 +511,7 @@ shader_bind(struct Shader *s)
 {
 	assert(s != NULL);
 
-	glUseProgram(s->prog);
+	gl_state_use_program(s->prog);
 
 #ifdef DEBUG
 	if (glGetError() != GL_NO_ERROR) {
@@ -608,6 +617,8 @@ shader_uniform_set(const struct ShaderUniform *uniform, size_t count, ...)
 	va_list ap;
 	va_start(ap, count);
 
+	stats_add(uniform_calls, 1);
+
 	switch (uniform->type) {
 	case GL_INT:
 	case GL_BOOL:
@@ -6,21 +6,45 @@ in vec2 uv;
 
 out vec4 color;
 
+// per-frame constants, see `struct FrameConstants` in draw_common.c
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 light_space_transform;
+	vec3 eye;
+	float light_ambient_intensity;
+	vec3 light_direction;
+	float light_diffuse_intensity;
+	vec3 light_color;
+};
+
+// per-draw constants, see `struct DrawConstants` in draw_mesh.c
+layout(std140) uniform Draw {
+	vec4 material_color;
+	vec3 position_scale;
+	bool packed_normals;
+	vec3 position_offset;
+	float material_specular_intensity;
+	float material_specular_power;
+	bool enable_lighting;
+	bool enable_texture_mapping;
+	bool enable_shadow_mapping;
+	bool enable_skinning;
+};
+
 /*** LIGTHING ***/
-uniform bool enable_lighting = false;
-uniform vec3 eye;
-uniform struct Light {
+struct Light {
 	vec3 direction;
 	vec3 color;
 	float ambient_intensity;
 	float diffuse_intensity;
-} light;
+};
 
-uniform struct Material {
-    vec4 color;
+struct Material {
+	vec4 color;
 	float specular_intensity;
 	float specular_power;
-} material;
+};
 
 void apply_lighting(
 	inout vec4 color,
@@ -59,11 +83,9 @@ void apply_lighting(
 }
 
 /*** TEXTURE MAPPING ***/
-uniform bool enable_texture_mapping = false;
 uniform sampler2D texture_map_sampler;
 
 /*** SHADOW MAPPING ***/
-uniform bool enable_shadow_mapping = false;
 in vec4 light_space_position;
 uniform sampler2D shadow_map_sampler;
 
@@ -79,13 +101,24 @@ void apply_shadow(inout vec4 color, sampler2D shadow_map_sampler, vec4 position)
 
 void main()
 {
-	color = material.color;
+	color = material_color;
 
 	if (enable_texture_mapping) {
 		color = texture(texture_map_sampler, vec2(uv.x, 1 - uv.y));
 	}
 
 	if (enable_lighting) {
+		Light light = Light(
+			light_direction,
+			light_color,
+			light_ambient_intensity,
+			light_diffuse_intensity
+		);
+		Material material = Material(
+			material_color,
+			material_specular_intensity,
+			material_specular_power
+		);
 		apply_lighting(color, light, material, eye, position, normal);
 	}
 
@@ -5,16 +5,40 @@ layout(location = 1) in vec3  in_normal;
 layout(location = 2) in vec2  in_uv;
 layout(location = 3) in ivec4 in_joints;
 layout(location = 4) in vec4  in_weights;
+layout(location = 5) in mat4  in_model;
+
+invariant gl_Position;
 
 out vec3 position;
 out vec3 normal;
 out vec2 uv;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-frame constants, see `struct FrameConstants` in draw_common.c
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 light_space_transform;
+	vec3 eye;
+	float light_ambient_intensity;
+	vec3 light_direction;
+	float light_diffuse_intensity;
+	vec3 light_color;
+};
+
+// per-draw constants, see `struct DrawConstants` in draw_mesh.c
+layout(std140) uniform Draw {
+	vec4 material_color;
+	vec3 position_scale;
+	bool packed_normals;
+	vec3 position_offset;
+	float material_specular_intensity;
+	float material_specular_power;
+	bool enable_lighting;
+	bool enable_texture_mapping;
+	bool enable_shadow_mapping;
+	bool enable_skinning;
+};
 
-uniform bool enable_skinning = false;
 layout(shared) uniform Animation {
 	mat4 skin_transforms[100];
 };
@@ -37,15 +61,22 @@ void apply_anim(inout vec3 pos, inout vec3 normal, ivec4 joints, vec4 weights)
 	}
 }
 
-uniform bool enable_shadow_mapping = false;
-uniform mat4 light_space_transform;
 out vec4 light_space_position;
 
+vec3 octahedral_decode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main()
 {
 	// local space
-	position = in_position;
-	normal = in_normal;
+	position = in_position * position_scale + position_offset;
+	normal = packed_normals ? octahedral_decode(in_normal.xy) : in_normal;
 	uv = in_uv;
 
 	if (enable_skinning) {
@@ -53,7 +84,7 @@ void main()
 	}
 
 	// model space
-	position = (model * vec4(position, 1.0)).xyz;
+	position = (in_model * vec4(position, 1.0)).xyz;
 
 	if (enable_shadow_mapping) {
 		light_space_position = light_space_transform * vec4(position, 1.0);
@@ -61,7 +92,7 @@ void main()
 
 	// view space
 	position = (view * vec4(position, 1.0)).xyz;
-	normal = normalize((view * model * vec4(normal, 0.0)).xyz);
+	normal = normalize((view * in_model * vec4(normal, 0.0)).xyz);
 
 	// clip space
 	gl_Position = projection * vec4(position, 1.0);
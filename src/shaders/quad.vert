@@ -1,7 +1,19 @@
 #version 330 core
 
+// per-frame constants, see `struct FrameConstants` in draw_common.c
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 light_space_transform;
+	vec3 eye;
+	float light_ambient_intensity;
+	vec3 light_direction;
+	float light_diffuse_intensity;
+	vec3 light_color;
+};
+
 uniform vec2 size;
-uniform mat4 mvp;
+uniform mat4 model;
 
 out vec2 uv;
 
@@ -27,7 +39,7 @@ void
 main()
 {
 	// compute vertex coordinate
-	gl_Position = mvp * vec4(positions[gl_VertexID] * size, 0, 1);
+	gl_Position = projection * view * model * vec4(positions[gl_VertexID] * size, 0, 1);
 
 	// compute texture coordinate
 	uv = uvs[gl_VertexID] * size;
@@ -3,13 +3,35 @@
 layout(location = 0) in vec3  in_position;
 layout(location = 3) in ivec4 in_joints;
 layout(location = 4) in vec4  in_weights;
+layout(location = 5) in mat4  in_model;
+
+// per-frame constants, see `struct FrameConstants` in draw_common.c
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 light_space_transform;
+	vec3 eye;
+	float light_ambient_intensity;
+	vec3 light_direction;
+	float light_diffuse_intensity;
+	vec3 light_color;
+};
+
+// per-draw constants, see `struct DrawConstants` in draw_shadow.c; depth
+// pre-pass renders from the camera instead of the light
+layout(std140) uniform Draw {
+	vec3 position_scale;
+	bool depth_prepass;
+	vec3 position_offset;
+	bool enable_skinning;
+};
 
-uniform mat4 mvp;
-uniform bool enable_skinning = false;
 layout(shared) uniform Animation {
 	mat4 skin_transforms[100];
 };
 
+invariant gl_Position;
+
 void apply_anim(inout vec3 pos, ivec4 joints, vec4 weights)
 {
 	mat4 t = mat4(0);
@@ -28,9 +50,16 @@ void apply_anim(inout vec3 pos, ivec4 joints, vec4 weights)
 
 void main()
 {
-	vec3 position = in_position;
+	vec3 position = in_position * position_scale + position_offset;
 	if (enable_skinning) {
 		apply_anim(position, in_joints, in_weights);
 	}
-	gl_Position = mvp * vec4(position, 1.0);
+	if (depth_prepass) {
+		// same operations as in mesh.vert, so that depths match exactly
+		position = (in_model * vec4(position, 1.0)).xyz;
+		position = (view * vec4(position, 1.0)).xyz;
+		gl_Position = projection * vec4(position, 1.0);
+	} else {
+		gl_Position = light_space_transform * (in_model * vec4(position, 1.0));
+	}
 }
@@ -3,7 +3,19 @@
 layout(location=0) in vec2 in_coord;
 layout(location=1) in uint in_char;
 
-uniform mat4 mvp;
+// per-frame constants, see `struct FrameConstants` in draw_common.c
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 light_space_transform;
+	vec3 eye;
+	float light_ambient_intensity;
+	vec3 light_direction;
+	float light_diffuse_intensity;
+	vec3 light_color;
+};
+
+uniform mat4 model;
 uniform usampler1D glyph_map_sampler;
 
 out vec2 uv;
@@ -24,5 +36,5 @@ void main()
 	uv.t = y;
 
 	// compute position
-	gl_Position = mvp * vec4(in_coord.x + x, in_coord.y + y, 0, 1);
+	gl_Position = projection * view * model * vec4(in_coord.x + x, in_coord.y + y, 0, 1);
 }
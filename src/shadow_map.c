@@ -1,7 +1,19 @@
 #include "error.h"
+#include "gl_api.h"
+#include "renderlib.h"
 #include "shadow_map.h"
+#include "stats.h"
 #include <stdlib.h>
 
+/**
+ * Return the bytes of 16 bit depth texture storage of a shadow map.
+ */
+static size_t
+shadow_map_size(const struct ShadowMap *map)
+{
+	return (size_t)map->width * map->height * 2;
+}
+
 struct ShadowMap*
 shadow_map_new(unsigned width, unsigned height)
 {
@@ -11,6 +23,8 @@ shadow_map_new(unsigned width, unsigned height)
 	}
 	map->width = width;
 	map->height = height;
+	mem_track(RENDER_MEMORY_TEXTURE, MEM_CPU, sizeof(struct ShadowMap));
+	mem_track(RENDER_MEMORY_TEXTURE, MEM_GPU, shadow_map_size(map));
 
 	// create a texture which will contain depth values
 	glGenTextures(1, &map->texture);
@@ -76,6 +90,8 @@ shadow_map_free(struct ShadowMap *map)
 	if (map) {
 		glDeleteFramebuffers(1, &map->fbo);
 		glDeleteTextures(1, &map->texture);
+		mem_track(RENDER_MEMORY_TEXTURE, MEM_GPU, -(ptrdiff_t)shadow_map_size(map));
+		mem_track(RENDER_MEMORY_TEXTURE, MEM_CPU, -(ptrdiff_t)sizeof(struct ShadowMap));
 		free(map);
 	}
 }
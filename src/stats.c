@@ -0,0 +1,56 @@
+#include "renderlib.h"
+#include "stats.h"
+#include <assert.h>
+
+struct Stats render_stats;
+
+// bytes in use and high-water marks, indexed by category and device
+static size_t mem_usage[RENDER_MEMORY_CATEGORY_COUNT][2];
+static size_t mem_peak[RENDER_MEMORY_CATEGORY_COUNT][2];
+
+void
+mem_track(int category, int device, ptrdiff_t bytes)
+{
+	assert(category >= 0 && category < RENDER_MEMORY_CATEGORY_COUNT);
+	assert(device == MEM_CPU || device == MEM_GPU);
+
+	size_t usage = __atomic_add_fetch(
+		&mem_usage[category][device],
+		(size_t)bytes,
+		__ATOMIC_RELAXED
+	);
+
+	size_t *peak = &mem_peak[category][device];
+	size_t prev = __atomic_load_n(peak, __ATOMIC_RELAXED);
+	while (bytes > 0 && usage > prev && !__atomic_compare_exchange_n(
+		peak,
+		&prev,
+		usage,
+		1,
+		__ATOMIC_RELAXED,
+		__ATOMIC_RELAXED
+	));
+}
+
+void
+renderer_get_memory_stats(int category, struct RenderMemoryStats *stats)
+{
+	assert(category >= 0 && category < RENDER_MEMORY_CATEGORY_COUNT);
+	assert(stats != NULL);
+
+	stats->cpu = __atomic_load_n(&mem_usage[category][MEM_CPU], __ATOMIC_RELAXED);
+	stats->cpu_peak = __atomic_load_n(&mem_peak[category][MEM_CPU], __ATOMIC_RELAXED);
+	stats->gpu = __atomic_load_n(&mem_usage[category][MEM_GPU], __ATOMIC_RELAXED);
+	stats->gpu_peak = __atomic_load_n(&mem_peak[category][MEM_GPU], __ATOMIC_RELAXED);
+}
+
+void
+renderer_reset_memory_peaks(void)
+{
+	for (int c = 0; c < RENDER_MEMORY_CATEGORY_COUNT; c++) {
+		for (int d = 0; d < 2; d++) {
+			size_t usage = __atomic_load_n(&mem_usage[c][d], __ATOMIC_RELAXED);
+			__atomic_store_n(&mem_peak[c][d], usage, __ATOMIC_RELAXED);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Frame statistics counters.
+ *
+ * Updated by renderer modules as work is submitted to OpenGL and reset by
+ * `renderer_present()` at the beginning of each frame.
+ */
+struct Stats {
+	size_t draw_calls;
+	size_t triangles;
+	size_t program_binds;
+	size_t vertex_array_binds;
+	size_t texture_binds;
+	size_t uniform_calls;
+	size_t bytes_uploaded;
+	size_t gl_calls;
+	size_t state_changes;
+	size_t state_changes_skipped;
+};
+
+extern struct Stats render_stats;
+
+#define stats_add(counter, n) (render_stats.counter += (n))
+
+enum {
+	MEM_CPU,
+	MEM_GPU
+};
+
+/**
+ * Account memory to a `RENDER_MEMORY_*` category.
+ *
+ * `bytes` is positive on allocation and negative on release; modules keep
+ * track of what they accounted, so that releases match allocations exactly.
+ * Safe to call from any thread.
+ */
+void
+mem_track(int category, int device, ptrdiff_t bytes);
@@ -0,0 +1,186 @@
+#include "error.h"
+#include "gl_api.h"
+#include "renderlib.h"
+#include "stats.h"
+#include "stream_buffer.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/**
+ * Account the storage of a stream buffer; `sign` is 1 to add, -1 to remove.
+ *
+ * Uniform buffers count as such, others hold per-instance vertex data.
+ */
+static void
+track_storage(const struct StreamBuffer *sb, int sign)
+{
+	int category = (
+		sb->target == GL_UNIFORM_BUFFER
+		? RENDER_MEMORY_UNIFORM
+		: RENDER_MEMORY_MESH
+	);
+	mem_track(category, MEM_GPU, sign * (ptrdiff_t)(sb->size * STREAM_BUFFER_SEGMENTS));
+}
+
+struct StreamBuffer*
+stream_buffer_new(GLenum target, size_t size)
+{
+	assert(size > 0);
+
+	struct StreamBuffer *sb = malloc(sizeof(struct StreamBuffer));
+	if (!sb) {
+		err(ERR_NO_MEM);
+		return NULL;
+	}
+	sb->target = target;
+	sb->size = size;
+	sb->segment = 0;
+	sb->offset = 0;
+	sb->generation = 0;
+	for (int i = 0; i < STREAM_BUFFER_SEGMENTS; i++) {
+		sb->fences[i] = NULL;
+	}
+
+	// create the buffer and initialize its storage
+	glGenBuffers(1, &sb->buffer);
+	if (!sb->buffer) {
+		err(ERR_OPENGL);
+		goto error;
+	}
+	track_storage(sb, 1);
+	glBindBuffer(target, sb->buffer);
+	glBufferData(target, size * STREAM_BUFFER_SEGMENTS, NULL, GL_STREAM_DRAW);
+	glBindBuffer(target, 0);
+
+	if (glGetError() != GL_NO_ERROR) {
+		err(ERR_OPENGL);
+		goto error;
+	}
+
+	return sb;
+
+error:
+	stream_buffer_free(sb);
+	return NULL;
+}
+
+static int
+next_segment(struct StreamBuffer *sb)
+{
+	// fence the commands issued so far, which include all those reading
+	// from current segment
+	sb->fences[sb->segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!sb->fences[sb->segment]) {
+		err(ERR_OPENGL);
+		return 0;
+	}
+	sb->segment = (sb->segment + 1) % STREAM_BUFFER_SEGMENTS;
+	sb->offset = 0;
+	sb->generation++;
+
+	// wait until the GPU is done with the next segment; this blocks only
+	// when the CPU runs a whole ring ahead
+	GLsync fence = sb->fences[sb->segment];
+	if (fence) {
+		GLenum status;
+		do {
+			status = glClientWaitSync(
+				fence,
+				GL_SYNC_FLUSH_COMMANDS_BIT,
+				1000000000
+			);
+		} while (status == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+		sb->fences[sb->segment] = NULL;
+		if (status == GL_WAIT_FAILED) {
+			err(ERR_OPENGL);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Map a region of the buffer for writing.
+ *
+ *   sb         Stream buffer.
+ *   size       Size of the region in bytes; must not exceed segment size.
+ *   alignment  Required alignment of region offset.
+ *   r_offset   Pointer to offset of the region within the buffer.
+ *
+ * The buffer is left bound to its target and must be unmapped with
+ * `stream_buffer_unmap()` before being used in a draw call.
+ */
+void*
+stream_buffer_map(
+	struct StreamBuffer *sb,
+	size_t size,
+	size_t alignment,
+	size_t *r_offset
+) {
+	assert(sb != NULL);
+	assert(size > 0 && size <= sb->size);
+	assert(alignment > 0 && sb->size % alignment == 0);
+
+	// move to the next segment if there's no more room left in current
+	size_t offset = (sb->offset + alignment - 1) / alignment * alignment;
+	if (offset + size > sb->size) {
+		if (!next_segment(sb)) {
+			return NULL;
+		}
+		offset = 0;
+	}
+	sb->offset = offset + size;
+	offset += sb->segment * sb->size;
+
+	// the region is not referenced by any pending command, thus there's
+	// no need for the driver to synchronize with the GPU
+	glBindBuffer(sb->target, sb->buffer);
+	void *ptr = glMapBufferRange(
+		sb->target,
+		offset,
+		size,
+		GL_MAP_WRITE_BIT |
+		GL_MAP_INVALIDATE_RANGE_BIT |
+		GL_MAP_UNSYNCHRONIZED_BIT
+	);
+	if (!ptr) {
+		glBindBuffer(sb->target, 0);
+		err(ERR_OPENGL);
+		return NULL;
+	}
+
+	stats_add(bytes_uploaded, size);
+	*r_offset = offset;
+	return ptr;
+}
+
+int
+stream_buffer_unmap(struct StreamBuffer *sb)
+{
+	assert(sb != NULL);
+
+	int ok = glUnmapBuffer(sb->target) == GL_TRUE;
+	glBindBuffer(sb->target, 0);
+	if (!ok) {
+		err(ERR_OPENGL);
+	}
+	return ok;
+}
+
+void
+stream_buffer_free(struct StreamBuffer *sb)
+{
+	if (sb) {
+		for (int i = 0; i < STREAM_BUFFER_SEGMENTS; i++) {
+			if (sb->fences[i]) {
+				glDeleteSync(sb->fences[i]);
+			}
+		}
+		if (sb->buffer) {
+			glDeleteBuffers(1, &sb->buffer);
+			track_storage(sb, -1);
+		}
+		free(sb);
+	}
+}
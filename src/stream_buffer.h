@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <stddef.h>
+
+// number of segments a stream buffer is split into
+#define STREAM_BUFFER_SEGMENTS 3
+
+/**
+ * Streaming buffer.
+ *
+ * OpenGL buffer which is filled sequentially with data consumed by the GPU
+ * once. The buffer is a ring of segments: when the current segment is full, a
+ * fence is inserted after the commands which read from it and writing moves on
+ * to the next one, waiting for its fence first, so that data still in use by
+ * pending draw calls is never overwritten and the buffer can be mapped without
+ * driver synchronization.
+ */
+struct StreamBuffer {
+	GLuint buffer;
+	GLenum target;
+	size_t size;     // size of a segment
+	size_t segment;  // current segment
+	size_t offset;   // offset of the first free byte in current segment
+	size_t generation;  // number of segment switches so far
+	GLsync fences[STREAM_BUFFER_SEGMENTS];
+};
+
+struct StreamBuffer*
+stream_buffer_new(GLenum target, size_t size);
+
+void*
+stream_buffer_map(
+	struct StreamBuffer *sb,
+	size_t size,
+	size_t alignment,
+	size_t *r_offset
+);
+
+int
+stream_buffer_unmap(struct StreamBuffer *sb);
+
+void
+stream_buffer_free(struct StreamBuffer *sb);
@@ -1,13 +1,27 @@
 #include "error.h"
 #include "font.h"
+#include "gl_api.h"
+#include "renderlib.h"
+#include "stats.h"
 #include "text.h"
-#include <GL/glew.h>
 #include <assert.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Account a text to memory statistics; `sign` is 1 to add, -1 to remove.
+ */
+static void
+track_text(const struct Text *text, int sign)
+{
+	size_t cpu = sizeof(struct Text) + (text->str ? text->len + 1 : 0);
+	size_t gpu = text->len * (1 + 2 * sizeof(float));
+	mem_track(RENDER_MEMORY_TEXT, MEM_CPU, sign * (ptrdiff_t)cpu);
+	mem_track(RENDER_MEMORY_TEXT, MEM_GPU, sign * (ptrdiff_t)gpu);
+}
+
 struct Text*
 text_new(struct Font *font)
 {
@@ -19,10 +33,12 @@ text_new(struct Font *font)
 		return NULL;
 	}
 	text->len = 0;
+	text->str = NULL;
 	text->width = 0;
 	text->height = 0;
 	text->vao = text->coords = text->chars = 0;
 	text->font = font;
+	track_text(text, 1);
 
 	// generate vertex array
 	glGenVertexArrays(1, &text->vao);
@@ -66,7 +82,19 @@ text_set_string(struct Text *text, const char *str)
 	assert(text != NULL);
 	assert(str != NULL);
 
-	text->len = strlen(str);
+	// keep a copy of the string, so that frame captures can record it
+	size_t len = strlen(str);
+	char *copy = malloc(len + 1);
+	if (!copy) {
+		err(ERR_NO_MEM);
+		return 0;
+	}
+	memcpy(copy, str, len + 1);
+	track_text(text, -1);
+	free(text->str);
+	text->str = copy;
+	text->len = len;
+	track_text(text, 1);
 
 	// setup the buffer of character indices, which in turn are character
 	// themselves
@@ -153,6 +181,8 @@ text_free(struct Text *text)
 		glDeleteBuffers(1, &text->chars);
 		glDeleteBuffers(1, &text->coords);
 		glDeleteVertexArrays(1, &text->vao);
+		track_text(text, -1);
+		free(text->str);
 		free(text);
 	}
 }
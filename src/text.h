@@ -4,6 +4,7 @@
 
 struct Text {
 	size_t len;
+	char *str;
 	GLuint vao;
 	GLuint coords;
 	GLuint chars;
@@ -1,5 +1,8 @@
 #include "error.h"
+#include "gl_api.h"
 #include "image.h"
+#include "renderlib.h"
+#include "stats.h"
 #include "texture.h"
 #include <assert.h>
 #include <stdlib.h>
@@ -12,14 +15,17 @@ texture_from_image(struct Image *image, GLenum type)
 
 	// determine OpenGL pixel formats
 	GLenum internal_format, format = 0;
+	size_t pixel_size;
 	switch (image->format) {
 	case IMAGE_FORMAT_RGB:
 		internal_format = GL_RGB8;
 		format = GL_RGB;
+		pixel_size = 3;
 		break;
 	case IMAGE_FORMAT_RGBA:
 		internal_format = GL_RGBA8;
 		format = GL_RGBA;
+		pixel_size = 4;
 		break;
 	default:
 		err(ERR_TEXTURE_FORMAT);
@@ -33,6 +39,8 @@ texture_from_image(struct Image *image, GLenum type)
 		goto error;
 	}
 	tex->type = type;
+	tex->bytes = 0;
+	mem_track(RENDER_MEMORY_TEXTURE, MEM_CPU, sizeof(struct Texture));
 
 	// create OpenGL texture object
 	glGenTextures(1, &tex->id);
@@ -68,6 +76,8 @@ texture_from_image(struct Image *image, GLenum type)
 		err(ERR_OPENGL);
 		goto error;
 	}
+	tex->bytes = pixel_size * image->width * image->height;
+	mem_track(RENDER_MEMORY_TEXTURE, MEM_GPU, tex->bytes);
 
 cleanup:
 	glBindTexture(type, 0);
@@ -85,6 +95,8 @@ texture_free(struct Texture *tex)
 {
 	if (tex) {
 		glDeleteTextures(1, &tex->id);
+		mem_track(RENDER_MEMORY_TEXTURE, MEM_GPU, -(ptrdiff_t)tex->bytes);
+		mem_track(RENDER_MEMORY_TEXTURE, MEM_CPU, -(ptrdiff_t)sizeof(struct Texture));
 		free(tex);
 	}
 }
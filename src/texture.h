@@ -7,6 +7,7 @@ struct Image;
 struct Texture {
 	GLuint id;
 	GLenum type;
+	size_t bytes;                 // texel storage, accounted to statistics
 };
 
 struct Texture*
@@ -0,0 +1,188 @@
+// use open source standard library features
+#define _XOPEN_SOURCE 700
+
+#include "error.h"
+#include "renderlib.h"
+#include "trace.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef ENABLE_TRACE
+
+#include <time.h>
+
+struct TraceEvent {
+	const char *category;
+	const char *name;
+	uint64_t start;     // ns
+	uint64_t duration;  // ns
+};
+
+/**
+ * Per-thread event ring.
+ *
+ * Only the owner thread writes events and publishes them by advancing `head`;
+ * dumps read events between `tail` and `head`. Rings are linked into a global
+ * list on first use and outlive their threads, so that events of finished
+ * threads can still be dumped.
+ */
+struct TraceRing {
+	struct TraceEvent events[TRACE_RING_SIZE];
+	uint64_t head;      // events written so far
+	uint64_t tail;      // events discarded by `renderer_trace_clear()`
+	unsigned tid;
+	struct TraceRing *next;
+
+	// open scopes
+	struct TraceEvent scopes[TRACE_MAX_DEPTH];
+	unsigned depth;
+};
+
+static __thread struct TraceRing *ring = NULL;
+static struct TraceRing *rings = NULL;
+static unsigned thread_count = 0;
+
+static uint64_t
+clock_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static struct TraceRing*
+get_ring(void)
+{
+	if (!ring && (ring = calloc(1, sizeof(struct TraceRing)))) {
+		ring->tid = __atomic_add_fetch(&thread_count, 1, __ATOMIC_RELAXED);
+
+		// push the ring onto the global list
+		ring->next = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+		while (!__atomic_compare_exchange_n(
+			&rings,
+			&ring->next,
+			ring,
+			0,
+			__ATOMIC_RELEASE,
+			__ATOMIC_ACQUIRE
+		));
+	}
+	return ring;
+}
+
+void
+trace_begin(const char *category, const char *name)
+{
+	struct TraceRing *r = get_ring();
+	if (!r) {
+		return;
+	}
+	if (r->depth < TRACE_MAX_DEPTH) {
+		struct TraceEvent *scope = &r->scopes[r->depth];
+		scope->category = category;
+		scope->name = name;
+		scope->start = clock_ns();
+	}
+	r->depth++;
+}
+
+void
+trace_end(void)
+{
+	struct TraceRing *r = ring;
+	if (!r || r->depth == 0) {
+		return;
+	}
+	if (--r->depth < TRACE_MAX_DEPTH) {
+		uint64_t head = r->head;
+		struct TraceEvent *evt = &r->events[head % TRACE_RING_SIZE];
+		*evt = r->scopes[r->depth];
+		evt->duration = clock_ns() - evt->start;
+		__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+	}
+}
+
+int
+renderer_trace_dump(const char *filename)
+{
+	assert(filename != NULL);
+
+	FILE *fp = fopen(filename, "w");
+	if (!fp) {
+		errf(ERR_IO, "%s", filename);
+		return 0;
+	}
+
+	// events being overwritten by threads still tracing while the dump
+	// runs may come out torn, thus dumps are best taken between frames
+	fprintf(fp, "{\"traceEvents\":[");
+	const char *sep = "\n";
+	struct TraceRing *r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+	for (; r; r = r->next) {
+		fprintf(
+			fp,
+			"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+			"\"args\":{\"name\":\"thread %u\"}}",
+			sep,
+			r->tid,
+			r->tid
+		);
+		sep = ",\n";
+
+		uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+		if (first < r->tail) {
+			first = r->tail;
+		}
+		for (uint64_t i = first; i < head; i++) {
+			const struct TraceEvent *evt = &r->events[i % TRACE_RING_SIZE];
+			fprintf(
+				fp,
+				"%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+				"\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				sep,
+				evt->name,
+				evt->category,
+				evt->start / 1e3,
+				evt->duration / 1e3,
+				r->tid
+			);
+		}
+	}
+	fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	int failed = ferror(fp);
+	failed |= fclose(fp) != 0;
+	if (failed) {
+		errf(ERR_IO, "%s", filename);
+		return 0;
+	}
+	return 1;
+}
+
+void
+renderer_trace_clear(void)
+{
+	struct TraceRing *r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+	for (; r; r = r->next) {
+		r->tail = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	}
+}
+
+#else
+
+int
+renderer_trace_dump(const char *filename)
+{
+	errf(ERR_GENERIC, "tracing not built in, configure with --with-trace");
+	return 0;
+}
+
+void
+renderer_trace_clear(void)
+{
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+// number of events each thread ring holds before overwriting the oldest
+#define TRACE_RING_SIZE 65536
+
+// maximum nesting of scopes tracked per thread; deeper ones are dropped
+#define TRACE_MAX_DEPTH 32
+
+/**
+ * Scoped event tracer.
+ *
+ * A scope opened by `TRACE_BEGIN()` and closed by the matching `TRACE_END()`
+ * in the same thread is recorded as a complete event into a ring owned by
+ * that thread, thus without locks. Rings are dumped as Chrome trace JSON by
+ * `renderer_trace_dump()`.
+ *
+ * Category and name must be string literals. Unless built with ENABLE_TRACE
+ * defined (`--with-trace`), both macros expand to nothing.
+ */
+#ifdef ENABLE_TRACE
+
+void
+trace_begin(const char *category, const char *name);
+
+void
+trace_end(void);
+
+#define TRACE_BEGIN(category, name) trace_begin(category, name)
+#define TRACE_END() trace_end()
+
+#else
+
+#define TRACE_BEGIN(category, name) ((void)0)
+#define TRACE_END() ((void)0)
+
+#endif
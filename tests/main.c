@@ -1,15 +1,29 @@
 #include <check.h>
 #include <stdlib.h>
 
+Suite*
+capture_suite(void);
+
 Suite*
 font_suite(void);
 
+#ifdef HAVE_EGL
+Suite*
+headless_suite(void);
+#endif
+
 Suite*
 image_suite(void);
 
+Suite*
+memory_suite(void);
+
 Suite*
 mesh_suite(void);
 
+Suite*
+null_suite(void);
+
 Suite*
 render_suite(void);
 
@@ -22,6 +36,9 @@ shader_suite(void);
 Suite*
 texture_suite(void);
 
+Suite*
+trace_suite(void);
+
 int
 main(int argc, char *argv[])
 {
@@ -30,13 +47,20 @@ main(int argc, char *argv[])
 	SRunner *sr = srunner_create(s);
 
 	// add external suites
+	srunner_add_suite(sr, capture_suite());
 	srunner_add_suite(sr, font_suite());
+#ifdef HAVE_EGL
+	srunner_add_suite(sr, headless_suite());
+#endif
 	srunner_add_suite(sr, image_suite());
+	srunner_add_suite(sr, memory_suite());
 	srunner_add_suite(sr, mesh_suite());
+	srunner_add_suite(sr, null_suite());
 	srunner_add_suite(sr, render_suite());
 	srunner_add_suite(sr, scene_suite());
 	srunner_add_suite(sr, shader_suite());
 	srunner_add_suite(sr, texture_suite());
+	srunner_add_suite(sr, trace_suite());
 
 	// execute all suites
 	srunner_run_all(sr, CK_NORMAL);
@@ -0,0 +1,156 @@
+#include <renderlib.h>
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAPTURE_FILE "test_capture.rcap"
+
+static struct Mesh *mesh = NULL;
+static struct Font *font = NULL;
+static struct Text *text = NULL;
+static struct AnimationInstance *inst = NULL;
+
+static void*
+load_asset(int type, const char *id, void *userdata)
+{
+	// hand back the very same assets, checking they were recorded by ID
+	if (type == RENDER_ASSET_MESH && strcmp(id, "tests/data/zombie.mesh") == 0) {
+		return mesh;
+	} else if (type == RENDER_ASSET_FONT && strcmp(id, "tests/data/courier.ttf:12") == 0) {
+		return font;
+	}
+	return NULL;
+}
+
+static void
+submit_frame(void)
+{
+	Mat identity;
+	mat_ident(&identity);
+	struct Transform transform = {
+		.model = identity,
+		.view = identity,
+		.projection = identity
+	};
+	struct Light light = {
+		.projection = identity
+	};
+	Vec eye = vec(0, 0, 1, 0);
+
+	struct MeshProps static_props = {
+		.cast_shadows = 1,
+		.receive_shadows = 1,
+		.animation = NULL,
+		.material = NULL
+	};
+	struct MeshProps animated_props = {
+		.cast_shadows = 1,
+		.receive_shadows = 1,
+		.animation = inst,
+		.material = NULL
+	};
+	struct TextProps text_props = {
+		.color = vec(1, 1, 1, 1),
+		.opacity = 1
+	};
+
+	for (int i = 0; i < 3; i++) {
+		ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &static_props, &transform, &light, &eye));
+	}
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &animated_props, &transform, &light, &eye));
+	ck_assert(render_text(RENDER_TARGET_OVERLAY, text, &text_props, &transform));
+}
+
+START_TEST(test_capture_replay)
+{
+	ck_assert(renderer_register_asset(mesh, "tests/data/zombie.mesh"));
+	ck_assert(renderer_register_asset(font, "tests/data/courier.ttf:12"));
+
+	submit_frame();
+	ck_assert(renderer_capture_frame(CAPTURE_FILE));
+	ck_assert(renderer_present());
+	struct RenderStats captured;
+	renderer_get_stats(&captured);
+
+	struct RenderCapture *capture = render_capture_load(CAPTURE_FILE, load_asset, NULL);
+	ck_assert(capture != NULL);
+
+	// replayed frames match the captured one, each time
+	for (int i = 0; i < 2; i++) {
+		ck_assert(render_capture_submit(capture));
+		ck_assert(renderer_present());
+		struct RenderStats replayed;
+		renderer_get_stats(&replayed);
+		ck_assert_uint_eq(replayed.shadow_ops, captured.shadow_ops);
+		ck_assert_uint_eq(replayed.render_ops, captured.render_ops);
+		ck_assert_uint_eq(replayed.overlay_ops, captured.overlay_ops);
+		ck_assert_uint_eq(replayed.draw_calls, captured.draw_calls);
+		ck_assert_uint_eq(replayed.triangles, captured.triangles);
+	}
+
+	render_capture_free(capture);
+	remove(CAPTURE_FILE);
+}
+END_TEST
+
+START_TEST(test_capture_unregistered)
+{
+	// captures fail as a whole and leave no file behind, while the frame
+	// is rendered anyway
+	submit_frame();
+	ck_assert(renderer_capture_frame(CAPTURE_FILE));
+	ck_assert(renderer_present());
+	FILE *fp = fopen(CAPTURE_FILE, "rb");
+	ck_assert(fp == NULL);
+
+	// the next frame is not captured
+	submit_frame();
+	ck_assert(renderer_present());
+}
+END_TEST
+
+static void
+suite_setup(void)
+{
+	ck_assert(renderer_init_null());
+	mesh = mesh_from_file("tests/data/zombie.mesh");
+	ck_assert(mesh != NULL);
+	font = font_from_file("tests/data/courier.ttf", 12);
+	ck_assert(font != NULL);
+	text = text_new(font);
+	ck_assert(text != NULL);
+	ck_assert(text_set_string(text, "captured"));
+	inst = animation_instance_new(&mesh->animations[0]);
+	ck_assert(inst != NULL);
+	ck_assert(animation_instance_play(inst, 0.5));
+}
+
+static void
+suite_teardown(void)
+{
+	animation_instance_free(inst);
+	inst = NULL;
+	text_free(text);
+	text = NULL;
+	font_free(font);
+	font = NULL;
+	mesh_free(mesh);
+	mesh = NULL;
+	renderer_shutdown();
+}
+
+Suite*
+capture_suite(void)
+{
+	Suite *s = suite_create("capture");
+
+	TCase *tc_core = tcase_create("core");
+	tcase_add_checked_fixture(tc_core, suite_setup, suite_teardown);
+	tcase_add_test(tc_core, test_capture_replay);
+	tcase_add_test(tc_core, test_capture_unregistered);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
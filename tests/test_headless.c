@@ -0,0 +1,83 @@
+#include <renderlib.h>
+#include <check.h>
+#include <stdlib.h>
+
+#define WIDTH 64
+#define HEIGHT 64
+
+static struct Mesh *mesh = NULL;
+
+START_TEST(test_headless_render)
+{
+	Mat identity, model;
+	mat_ident(&identity);
+
+	Vec offset = vec(0, -0.7, 0, 0);
+	Vec scale = vec(0.01, 0.01, 0.01, 0);
+	mat_ident(&model);
+	mat_translatev(&model, &offset);
+	mat_scalev(&model, &scale);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct MeshProps props = {
+		.cast_shadows = 0,
+		.receive_shadows = 0,
+		.animation = NULL,
+		.material = NULL
+	};
+
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, NULL, NULL));
+	ck_assert(renderer_present());
+
+	unsigned char *pixels = malloc(WIDTH * HEIGHT * 4);
+	ck_assert(pixels != NULL);
+	ck_assert(renderer_read_pixels(WIDTH, HEIGHT, pixels));
+
+	// corners are left at clear color, while the mesh covers some pixels
+	// in between
+	ck_assert_uint_eq(pixels[0], pixels[(WIDTH * HEIGHT - 1) * 4]);
+	int covered = 0;
+	for (int i = 0; i < WIDTH * HEIGHT; i++) {
+		if (pixels[i * 4] != pixels[0]) {
+			covered++;
+		}
+	}
+	ck_assert_int_gt(covered, 0);
+	free(pixels);
+}
+END_TEST
+
+static void
+suite_setup(void)
+{
+	ck_assert(renderer_init_headless(WIDTH, HEIGHT));
+	mesh = mesh_from_file("tests/data/zombie.mesh");
+	ck_assert(mesh != NULL);
+}
+
+static void
+suite_teardown(void)
+{
+	mesh_free(mesh);
+	mesh = NULL;
+	renderer_shutdown();
+}
+
+Suite*
+headless_suite(void)
+{
+	Suite *s = suite_create("headless");
+
+	TCase *tc_core = tcase_create("core");
+	tcase_add_checked_fixture(tc_core, suite_setup, suite_teardown);
+	tcase_add_test(tc_core, test_headless_render);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
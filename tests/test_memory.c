@@ -0,0 +1,175 @@
+#include <renderlib.h>
+#include <check.h>
+
+START_TEST(test_memory_mesh)
+{
+	struct RenderMemoryStats before, anim_before, loaded, anim_loaded, after, anim_after;
+	renderer_get_memory_stats(RENDER_MEMORY_MESH, &before);
+	renderer_get_memory_stats(RENDER_MEMORY_ANIMATION, &anim_before);
+
+	struct Mesh *mesh = mesh_from_file("tests/data/zombie.mesh");
+	ck_assert(mesh != NULL);
+	struct AnimationInstance *inst = animation_instance_new(&mesh->animations[0]);
+	ck_assert(inst != NULL);
+
+	// vertex and index buffers are accounted to meshes, joint poses and
+	// instances to animations
+	renderer_get_memory_stats(RENDER_MEMORY_MESH, &loaded);
+	renderer_get_memory_stats(RENDER_MEMORY_ANIMATION, &anim_loaded);
+	size_t index_size = mesh->index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+	ck_assert_uint_ge(
+		loaded.gpu - before.gpu,
+		mesh->vertex_count * mesh->vertex_size + mesh->index_count * index_size
+	);
+	ck_assert_uint_gt(loaded.cpu, before.cpu);
+	ck_assert_uint_gt(anim_loaded.cpu, anim_before.cpu);
+	ck_assert_uint_eq(anim_loaded.gpu, anim_before.gpu);
+
+	animation_instance_free(inst);
+	mesh_free(mesh);
+
+	// all memory is given back, high-water marks stay
+	renderer_get_memory_stats(RENDER_MEMORY_MESH, &after);
+	renderer_get_memory_stats(RENDER_MEMORY_ANIMATION, &anim_after);
+	ck_assert_uint_eq(after.cpu, before.cpu);
+	ck_assert_uint_eq(after.gpu, before.gpu);
+	ck_assert_uint_eq(anim_after.cpu, anim_before.cpu);
+	ck_assert_uint_ge(after.gpu_peak, loaded.gpu);
+	ck_assert_uint_ge(anim_after.cpu_peak, anim_loaded.cpu);
+
+	// peaks can be reset for measuring a new phase
+	renderer_reset_memory_peaks();
+	renderer_get_memory_stats(RENDER_MEMORY_MESH, &after);
+	ck_assert_uint_eq(after.gpu_peak, after.gpu);
+}
+END_TEST
+
+START_TEST(test_memory_texture)
+{
+	struct RenderMemoryStats before, loaded, after;
+	renderer_get_memory_stats(RENDER_MEMORY_TEXTURE, &before);
+
+	struct Image *image = image_from_file("tests/data/star.png");
+	ck_assert(image != NULL);
+	struct Texture *tex = texture_from_image(image, GL_TEXTURE_2D);
+	ck_assert(tex != NULL);
+
+	renderer_get_memory_stats(RENDER_MEMORY_TEXTURE, &loaded);
+	ck_assert_uint_ge(loaded.gpu - before.gpu, image->width * image->height * 3);
+
+	texture_free(tex);
+	image_free(image);
+
+	renderer_get_memory_stats(RENDER_MEMORY_TEXTURE, &after);
+	ck_assert_uint_eq(after.gpu, before.gpu);
+	ck_assert_uint_eq(after.cpu, before.cpu);
+}
+END_TEST
+
+START_TEST(test_memory_text)
+{
+	struct RenderMemoryStats font_before, before, short_text, long_text, after;
+	renderer_get_memory_stats(RENDER_MEMORY_FONT, &font_before);
+	renderer_get_memory_stats(RENDER_MEMORY_TEXT, &before);
+
+	struct Font *font = font_from_file("tests/data/courier.ttf", 12);
+	ck_assert(font != NULL);
+	struct RenderMemoryStats font_loaded;
+	renderer_get_memory_stats(RENDER_MEMORY_FONT, &font_loaded);
+	ck_assert_uint_gt(font_loaded.gpu, font_before.gpu);
+
+	// text buffers follow string length
+	struct Text *text = text_new(font);
+	ck_assert(text != NULL);
+	ck_assert(text_set_string(text, "long string of text"));
+	renderer_get_memory_stats(RENDER_MEMORY_TEXT, &long_text);
+	ck_assert(text_set_string(text, "short"));
+	renderer_get_memory_stats(RENDER_MEMORY_TEXT, &short_text);
+	ck_assert_uint_lt(short_text.gpu, long_text.gpu);
+	ck_assert_uint_lt(short_text.cpu, long_text.cpu);
+	ck_assert_uint_ge(short_text.gpu_peak, long_text.gpu);
+
+	text_free(text);
+	font_free(font);
+
+	renderer_get_memory_stats(RENDER_MEMORY_TEXT, &after);
+	ck_assert_uint_eq(after.cpu, before.cpu);
+	ck_assert_uint_eq(after.gpu, before.gpu);
+	renderer_get_memory_stats(RENDER_MEMORY_FONT, &after);
+	ck_assert_uint_eq(after.cpu, font_before.cpu);
+	ck_assert_uint_eq(after.gpu, font_before.gpu);
+}
+END_TEST
+
+START_TEST(test_memory_scene)
+{
+	struct RenderMemoryStats before, populated, after;
+	renderer_get_memory_stats(RENDER_MEMORY_SCENE, &before);
+
+	struct Scene *scene = scene_new();
+	ck_assert(scene != NULL);
+	struct MeshProps props;
+	struct Object *objects[3];
+	for (int i = 0; i < 3; i++) {
+		objects[i] = scene_add_mesh(scene, NULL, &props);
+		ck_assert(objects[i] != NULL);
+	}
+	renderer_get_memory_stats(RENDER_MEMORY_SCENE, &populated);
+	ck_assert_uint_gt(populated.cpu, before.cpu);
+
+	scene_remove_object(scene, objects[0]);
+	scene_free(scene);
+
+	renderer_get_memory_stats(RENDER_MEMORY_SCENE, &after);
+	ck_assert_uint_eq(after.cpu, before.cpu);
+	ck_assert_uint_ge(after.cpu_peak, populated.cpu);
+}
+END_TEST
+
+START_TEST(test_memory_reinit)
+{
+	struct RenderMemoryStats uniform_before, mesh_before, uniform_after, mesh_after;
+	renderer_get_memory_stats(RENDER_MEMORY_UNIFORM, &uniform_before);
+	renderer_get_memory_stats(RENDER_MEMORY_MESH, &mesh_before);
+	ck_assert_uint_gt(uniform_before.gpu, 0);
+
+	// shared stream buffers are released on shutdown and allocated anew
+	renderer_shutdown();
+	ck_assert(renderer_init_null());
+
+	renderer_get_memory_stats(RENDER_MEMORY_UNIFORM, &uniform_after);
+	renderer_get_memory_stats(RENDER_MEMORY_MESH, &mesh_after);
+	ck_assert_uint_eq(uniform_after.gpu, uniform_before.gpu);
+	ck_assert_uint_eq(mesh_after.gpu, mesh_before.gpu);
+}
+END_TEST
+
+static void
+suite_setup(void)
+{
+	ck_assert(renderer_init_null());
+}
+
+static void
+suite_teardown(void)
+{
+	renderer_shutdown();
+}
+
+Suite*
+memory_suite(void)
+{
+	Suite *s = suite_create("memory");
+
+	TCase *tc_core = tcase_create("core");
+	tcase_add_checked_fixture(tc_core, suite_setup, suite_teardown);
+	tcase_add_test(tc_core, test_memory_mesh);
+	tcase_add_test(tc_core, test_memory_texture);
+	tcase_add_test(tc_core, test_memory_text);
+	tcase_add_test(tc_core, test_memory_scene);
+	tcase_add_test(tc_core, test_memory_reinit);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -1,9 +1,15 @@
+// use open source standard library features
+#define _XOPEN_SOURCE 700
+
 #include "fixture.h"
 #include <check.h>
+#include <math.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "anim.h"
 #include "mesh.h"
+#include "renderlib.h"
 
 START_TEST(test_create_simple)
 {
@@ -35,6 +41,29 @@ START_TEST(test_create_simple)
 	ck_assert_int_eq(mesh->vertex_count, 3);
 	ck_assert_int_eq(mesh->index_count, 3);
 	ck_assert_int_eq(mesh->anim_count, 0);
+	ck_assert_int_eq(mesh->index_type, GL_UNSIGNED_SHORT);
+	mesh_free(mesh);
+}
+END_TEST
+
+START_TEST(test_create_wide_indices)
+{
+	// one vertex too many for 16 bit indices
+	static float vertices[65537][3];
+	uint32_t indices[] = { 0, 1, 65536 };
+
+	struct Mesh *mesh = mesh_new(
+		vertices,
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+		65537,
+		indices,
+		3
+	);
+	ck_assert(mesh != NULL);
+	ck_assert_int_eq(mesh->index_type, GL_UNSIGNED_INT);
 	mesh_free(mesh);
 }
 END_TEST
@@ -47,7 +76,143 @@ START_TEST(test_create_from_file)
 	ck_assert_int_eq(mesh->index_count, 37368);
 	ck_assert_int_eq(mesh->anim_count, 1);
 	ck_assert_int_eq(mesh->skeleton->joint_count, 27);
+	ck_assert_int_eq(mesh->index_type, GL_UNSIGNED_SHORT);
+	mesh_free(mesh);
+}
+END_TEST
+
+START_TEST(test_create_from_file_v2)
+{
+	// same plane stored in both formats, v2 with quantized attributes
+	struct Mesh *v1 = mesh_from_file("tests/data/plane.mesh");
+	struct Mesh *v2 = mesh_from_file("tests/data/plane_v2.mesh");
+	ck_assert(v1 != NULL && v2 != NULL);
+	ck_assert(!v1->packed);
+	ck_assert(v2->packed);
+	ck_assert_int_eq(v2->vertex_count, v1->vertex_count);
+	ck_assert_int_eq(v2->index_count, v1->index_count);
+	ck_assert_int_eq(v2->vertex_size * 2, v1->vertex_size);
+	for (int c = 0; c < 3; c++) {
+		ck_assert(fabsf(v2->bounds.min.data[c] - v1->bounds.min.data[c]) < 1e-4f);
+		ck_assert(fabsf(v2->bounds.max.data[c] - v1->bounds.max.data[c]) < 1e-4f);
+	}
+	ck_assert(fabsf(v2->bounds.radius - v1->bounds.radius) < 1e-4f);
+	mesh_free(v1);
+	mesh_free(v2);
+}
+END_TEST
+
+START_TEST(test_create_optimized)
+{
+	struct Mesh *plain = mesh_from_file("tests/data/zombie.mesh");
+	ck_assert(renderer_set_option(RENDER_OPTION_OPTIMIZE_MESHES, 1));
+	struct Mesh *optimized = mesh_from_file("tests/data/zombie.mesh");
+	ck_assert(renderer_set_option(RENDER_OPTION_OPTIMIZE_MESHES, 0));
+	ck_assert(plain != NULL && optimized != NULL);
+
+	// the mesh is stored unindexed, with a vertex per triangle corner, and
+	// its cache efficiency is measured only when optimized
+	ck_assert_int_eq(plain->vertex_count, plain->index_count);
+	ck_assert(plain->vertex_cache.acmr < 0);
+	ck_assert(plain->vertex_cache.atvr < 0);
+
+	// shared vertices are welded and reused from cache
+	ck_assert_int_eq(optimized->index_count, plain->index_count);
+	ck_assert_int_lt(optimized->vertex_count, plain->vertex_count);
+	ck_assert(optimized->vertex_cache.acmr < 1.0f);
+	ck_assert(optimized->vertex_cache.atvr < 2.0f);
+	for (int c = 0; c < 3; c++) {
+		ck_assert(optimized->bounds.min.data[c] == plain->bounds.min.data[c]);
+		ck_assert(optimized->bounds.max.data[c] == plain->bounds.max.data[c]);
+	}
+	mesh_free(plain);
+	mesh_free(optimized);
+}
+END_TEST
+
+START_TEST(test_create_lods)
+{
+	ck_assert(!renderer_set_option(RENDER_OPTION_MESH_LODS, 0));
+	ck_assert(!renderer_set_option(RENDER_OPTION_MESH_LODS, MESH_MAX_LODS + 1));
+	ck_assert(renderer_set_option(RENDER_OPTION_MESH_LODS, MESH_MAX_LODS));
+	struct Mesh *mesh = mesh_from_file("tests/data/zombie.mesh");
+	ck_assert(renderer_set_option(RENDER_OPTION_MESH_LODS, 1));
+	ck_assert(mesh != NULL);
+
+	// levels follow each other in the index buffer, each about half the
+	// previous one and further away from the full mesh
+	ck_assert_uint_eq(mesh->lod_count, MESH_MAX_LODS);
+	ck_assert_uint_eq(mesh->lods[0].index_offset, 0);
+	ck_assert_uint_eq(mesh->lods[0].index_count, mesh->index_count);
+	ck_assert(mesh->lods[0].error == 0);
+	for (size_t l = 1; l < mesh->lod_count; l++) {
+		ck_assert_uint_eq(
+			mesh->lods[l].index_offset,
+			mesh->lods[l - 1].index_offset + mesh->lods[l - 1].index_count
+		);
+		ck_assert_uint_le(mesh->lods[l].index_count, mesh->lods[l - 1].index_count * 3 / 4);
+		ck_assert_uint_eq(mesh->lods[l].index_count % 3, 0);
+		ck_assert(mesh->lods[l].error >= mesh->lods[l - 1].error);
+	}
+	ck_assert(mesh->lods[1].error < mesh->bounds.radius * 0.01f);
+	mesh_free(mesh);
+}
+END_TEST
+
+START_TEST(test_load_async)
+{
+	struct Mesh *expected = mesh_from_file("tests/data/zombie.mesh");
+	ck_assert(expected != NULL);
+
+	// a small upload budget spreads the mesh buffers over several frames
+	ck_assert(!renderer_set_option(RENDER_OPTION_UPLOAD_BUDGET, 0));
+	ck_assert(renderer_set_option(RENDER_OPTION_UPLOAD_BUDGET, 65536));
+	struct MeshLoad *load = mesh_load_async("tests/data/zombie.mesh");
+	ck_assert(load != NULL);
+	size_t upload_frames = 0;
+	while (mesh_load_status(load) == MESH_LOAD_PENDING) {
+		ck_assert(renderer_present());
+		struct RenderStats stats;
+		renderer_get_stats(&stats);
+		if (stats.bytes_uploaded > 0) {
+			struct RenderFrameTimings timings;
+			renderer_get_frame_timings(&timings);
+			ck_assert(timings.cpu_upload > 0);
+			upload_frames++;
+		}
+	}
+	ck_assert(renderer_set_option(RENDER_OPTION_UPLOAD_BUDGET, 4 * 1024 * 1024));
+	ck_assert_int_eq(mesh_load_status(load), MESH_LOAD_DONE);
+	ck_assert_uint_ge(upload_frames, expected->buffer_bytes / 65536);
+
+	struct Mesh *mesh = mesh_load_finish(load);
+	ck_assert(mesh != NULL);
+	ck_assert_uint_eq(mesh->vertex_count, expected->vertex_count);
+	ck_assert_uint_eq(mesh->index_count, expected->index_count);
+	ck_assert_uint_eq(mesh->index_type, expected->index_type);
+	ck_assert_uint_eq(mesh->buffer_bytes, expected->buffer_bytes);
+	ck_assert_uint_eq(mesh->anim_count, expected->anim_count);
 	mesh_free(mesh);
+	mesh_free(expected);
+}
+END_TEST
+
+START_TEST(test_load_async_failed)
+{
+	// failures don't need frames to be presented; poll for up to 5 seconds
+	struct MeshLoad *load = mesh_load_async("tests/data/missing.mesh");
+	ck_assert(load != NULL);
+	struct timespec poll_interval = { .tv_sec = 0, .tv_nsec = 1000000 };
+	for (int i = 0; i < 5000 && mesh_load_status(load) == MESH_LOAD_PENDING; i++) {
+		nanosleep(&poll_interval, NULL);
+	}
+	ck_assert_int_eq(mesh_load_status(load), MESH_LOAD_FAILED);
+	ck_assert(mesh_load_finish(load) == NULL);
+
+	// abandoned loads are freed by the loader
+	load = mesh_load_async("tests/data/zombie.mesh");
+	ck_assert(load != NULL);
+	ck_assert(mesh_load_finish(load) == NULL);
 }
 END_TEST
 
@@ -59,7 +224,13 @@ mesh_suite(void)
 	TCase *tc_core = tcase_create("core");
 	tcase_add_checked_fixture(tc_core, setup, teardown);
 	tcase_add_test(tc_core, test_create_simple);
+	tcase_add_test(tc_core, test_create_wide_indices);
 	tcase_add_test(tc_core, test_create_from_file);
+	tcase_add_test(tc_core, test_create_from_file_v2);
+	tcase_add_test(tc_core, test_create_optimized);
+	tcase_add_test(tc_core, test_create_lods);
+	tcase_add_test(tc_core, test_load_async);
+	tcase_add_test(tc_core, test_load_async_failed);
 
 	suite_add_tcase(s, tc_core);
 
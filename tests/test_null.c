@@ -0,0 +1,181 @@
+#include <renderlib.h>
+#include <check.h>
+#include <stdlib.h>
+
+static struct Mesh *mesh = NULL;
+
+START_TEST(test_null_render)
+{
+	Mat identity, model;
+	mat_ident(&identity);
+
+	Vec offset = vec(0, -0.7, 0, 0);
+	Vec scale = vec(0.01, 0.01, 0.01, 0);
+	mat_ident(&model);
+	mat_translatev(&model, &offset);
+	mat_scalev(&model, &scale);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct Light light = {
+		.projection = identity
+	};
+	Vec eye = vec(0, 0, 0, 1);
+
+	struct MeshProps props = {
+		.cast_shadows = 1,
+		.receive_shadows = 1,
+		.animation = NULL,
+		.material = NULL
+	};
+
+	for (int i = 0; i < 3; i++) {
+		ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, &light, &eye));
+	}
+	ck_assert(renderer_present());
+
+	// the frame went through the whole submission path, with OpenGL calls
+	// counted instead of executed
+	struct RenderStats stats;
+	renderer_get_stats(&stats);
+	ck_assert_uint_eq(stats.render_ops, 3);
+	ck_assert_uint_eq(stats.shadow_ops, 3);
+	ck_assert_uint_gt(stats.draw_calls, 0);
+	ck_assert_uint_gt(stats.gl_calls, stats.draw_calls);
+}
+END_TEST
+
+START_TEST(test_null_animated)
+{
+	struct AnimationInstance *inst = animation_instance_new(&mesh->animations[0]);
+	ck_assert(inst != NULL);
+	ck_assert(animation_instance_play(inst, 0.5));
+
+	Mat identity;
+	mat_ident(&identity);
+	struct Transform transform = {
+		.model = identity,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct MeshProps props = {
+		.cast_shadows = 0,
+		.receive_shadows = 0,
+		.animation = inst,
+		.material = NULL
+	};
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, NULL, NULL));
+	ck_assert(renderer_present());
+
+	struct RenderStats stats;
+	renderer_get_stats(&stats);
+	ck_assert_uint_eq(stats.draw_calls, 1);
+	ck_assert_uint_gt(stats.bytes_uploaded, 0);
+
+	animation_instance_free(inst);
+}
+END_TEST
+
+static size_t
+render_triangles(struct Mesh *lod_mesh, float distance, int shadows)
+{
+	// mesh centered in front of the camera
+	Mat identity, model, projection;
+	mat_ident(&identity);
+	mat_persp(&projection, 45.0f, 1.0f, 1.0f, 10000.0f);
+	const float *center = lod_mesh->bounds.center.data;
+	Vec offset = vec(-center[0], -center[1], -center[2] - distance, 0);
+	mat_ident(&model);
+	mat_translatev(&model, &offset);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = projection
+	};
+	struct Light light = {
+		.projection = identity
+	};
+	Vec eye = vec(0, 0, 0, 1);
+	struct MeshProps props = {
+		.cast_shadows = shadows,
+		.receive_shadows = 0,
+		.animation = NULL,
+		.material = NULL
+	};
+	ck_assert(render_mesh(
+		RENDER_TARGET_FRAMEBUFFER,
+		lod_mesh,
+		&props,
+		&transform,
+		shadows ? &light : NULL,
+		shadows ? &eye : NULL
+	));
+	ck_assert(renderer_present());
+
+	struct RenderStats stats;
+	renderer_get_stats(&stats);
+	return stats.triangles;
+}
+
+START_TEST(test_null_lod)
+{
+	ck_assert(renderer_set_option(RENDER_OPTION_MESH_LODS, MESH_MAX_LODS));
+	struct Mesh *lod_mesh = mesh_from_file("tests/data/zombie.mesh");
+	ck_assert(renderer_set_option(RENDER_OPTION_MESH_LODS, 1));
+	ck_assert(lod_mesh != NULL);
+	ck_assert_uint_gt(lod_mesh->lod_count, 1);
+	size_t full = lod_mesh->lods[0].index_count / 3;
+	size_t coarse = lod_mesh->lods[1].index_count / 3;
+	size_t coarsest = lod_mesh->lods[lod_mesh->lod_count - 1].index_count / 3;
+
+	// full resolution up close, coarsest level far away
+	ck_assert_uint_eq(render_triangles(lod_mesh, 0, 0), full);
+	ck_assert_uint_eq(render_triangles(lod_mesh, 5000, 0), coarsest);
+
+	// shadows can be drawn coarser than the mesh itself
+	ck_assert_uint_eq(render_triangles(lod_mesh, 0, 1), full * 2);
+	ck_assert(renderer_set_option(RENDER_OPTION_SHADOW_LOD_BIAS, 1));
+	ck_assert_uint_eq(render_triangles(lod_mesh, 0, 1), full + coarse);
+	ck_assert(renderer_set_option(RENDER_OPTION_SHADOW_LOD_BIAS, 0));
+
+	mesh_free(lod_mesh);
+}
+END_TEST
+
+static void
+suite_setup(void)
+{
+	ck_assert(renderer_init_null());
+	mesh = mesh_from_file("tests/data/zombie.mesh");
+	ck_assert(mesh != NULL);
+}
+
+static void
+suite_teardown(void)
+{
+	mesh_free(mesh);
+	mesh = NULL;
+	renderer_shutdown();
+}
+
+Suite*
+null_suite(void)
+{
+	Suite *s = suite_create("null");
+
+	TCase *tc_core = tcase_create("core");
+	tcase_add_checked_fixture(tc_core, suite_setup, suite_teardown);
+	tcase_add_test(tc_core, test_null_render);
+	tcase_add_test(tc_core, test_null_animated);
+	tcase_add_test(tc_core, test_null_lod);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -1,17 +1,23 @@
 #include "fixture.h"
+#include "gl_api.h"
+#include "render_op.h"
 #include <renderlib.h>
 #include <check.h>
+#include <math.h>
 #include <stdlib.h>
 
 static struct Mesh *mesh = NULL;
 
+// model transform which fits test mesh into the clip volume
+static Mat model;
+
 START_TEST(test_render_mesh_simple)
 {
 	Mat identity;
 	mat_ident(&identity);
 
 	struct Transform transform = {
-		.model = identity,
+		.model = model,
 		.view = identity,
 		.projection = identity
 	};
@@ -44,7 +50,7 @@ START_TEST(test_render_mesh_textured)
 	mat_ident(&identity);
 
 	struct Transform transform = {
-		.model = identity,
+		.model = model,
 		.view = identity,
 		.projection = identity
 	};
@@ -66,7 +72,7 @@ START_TEST(test_render_mesh_shadowed)
 	mat_ident(&identity);
 
 	struct Transform transform = {
-		.model = identity,
+		.model = model,
 		.view = identity,
 		.projection = identity
 	};
@@ -101,7 +107,7 @@ START_TEST(test_render_mesh_animated)
 	mat_ident(&identity);
 
 	struct Transform transform = {
-		.model = identity,
+		.model = model,
 		.view = identity,
 		.projection = identity
 	};
@@ -118,11 +124,368 @@ START_TEST(test_render_mesh_animated)
 }
 END_TEST
 
+START_TEST(test_render_mesh_animated_shadowed)
+{
+	// two instances, each rendered twice in both shadow and render passes
+	struct AnimationInstance *inst[2] = {
+		animation_instance_new(&mesh->animations[0]),
+		animation_instance_new(&mesh->animations[0])
+	};
+	ck_assert(inst[0] != NULL && inst[1] != NULL);
+	animation_instance_play(inst[0], 1.234);
+	animation_instance_play(inst[1], 0.567);
+
+	Mat identity;
+	mat_ident(&identity);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct Light light = {
+		.projection = identity
+	};
+
+	Vec eye = vec(0, 0, 0, 0);
+
+	for (int i = 0; i < 4; i++) {
+		struct MeshProps props = {
+			.cast_shadows = 1,
+			.receive_shadows = 1,
+			.animation = inst[i % 2],
+			.material = NULL
+		};
+		ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, &light, &eye));
+	}
+	ck_assert(renderer_present());
+
+	animation_instance_free(inst[0]);
+	animation_instance_free(inst[1]);
+}
+END_TEST
+
+START_TEST(test_render_mesh_many)
+{
+	Mat identity;
+	mat_ident(&identity);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct MeshProps props = {
+		.cast_shadows = 0,
+		.receive_shadows = 0,
+		.animation = NULL,
+		.material = NULL
+	};
+
+	// render queues are not bound to a fixed size
+	for (int i = 0; i < 5000; i++) {
+		ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, NULL, NULL));
+	}
+	ck_assert(renderer_present());
+	ck_assert_uint_gt(renderer_get_queue_memory_peak(), 0);
+}
+END_TEST
+
+START_TEST(test_render_state_cache)
+{
+	Mat identity;
+	mat_ident(&identity);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct MeshProps props = {
+		.cast_shadows = 0,
+		.receive_shadows = 0,
+		.animation = NULL,
+		.material = NULL
+	};
+
+	// consecutive draws of the same mesh share program and vertex array
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, NULL, NULL));
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, NULL, NULL));
+	ck_assert(renderer_present());
+
+	struct RenderStats stats;
+	renderer_get_stats(&stats);
+	ck_assert_uint_gt(stats.state_changes, 0);
+	ck_assert_uint_gt(stats.state_changes_skipped, 0);
+}
+END_TEST
+
+START_TEST(test_render_mesh_culled)
+{
+	Mat identity;
+	mat_ident(&identity);
+
+	// shift a copy of the mesh off-screen
+	Mat translation, offscreen;
+	Vec offset = vec(10, 0, 0, 0);
+	mat_ident(&translation);
+	mat_translatev(&translation, &offset);
+	mat_mul(&translation, &model, &offscreen);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct Light light = {
+		.projection = identity
+	};
+
+	Vec eye = vec(0, 0, 0, 0);
+
+	struct MeshProps props = {
+		.cast_shadows = 1,
+		.receive_shadows = 1,
+		.animation = NULL,
+		.material = NULL
+	};
+
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, &light, &eye));
+	transform.model = offscreen;
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, &light, &eye));
+	ck_assert(renderer_present());
+
+	struct RenderStats stats;
+	renderer_get_stats(&stats);
+	ck_assert_uint_eq(stats.visible, 1);
+	ck_assert_uint_eq(stats.culled, 1);
+	ck_assert_uint_eq(stats.shadow_visible, 1);
+	ck_assert_uint_eq(stats.shadow_culled, 1);
+}
+END_TEST
+
+START_TEST(test_render_sort_front_to_back)
+{
+	ck_assert(renderer_set_option(RENDER_OPTION_SORT_MODE, RENDER_SORT_FRONT_TO_BACK));
+	ck_assert_int_eq(renderer_get_option(RENDER_OPTION_SORT_MODE), RENDER_SORT_FRONT_TO_BACK);
+	ck_assert(!renderer_set_option(RENDER_OPTION_SORT_MODE, -1));
+
+	Mat identity;
+	mat_ident(&identity);
+
+	struct Transform transform = {
+		.view = identity,
+		.projection = identity
+	};
+
+	struct MeshProps props = {
+		.cast_shadows = 0,
+		.receive_shadows = 0,
+		.animation = NULL,
+		.material = NULL
+	};
+
+	// submit meshes back to front
+	for (int i = 0; i < 3; i++) {
+		Mat translation;
+		Vec offset = vec(0, 0, -0.5 + i * 0.5, 0);
+		mat_ident(&translation);
+		mat_translatev(&translation, &offset);
+		mat_mul(&translation, &model, &transform.model);
+		ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, NULL, NULL));
+	}
+	ck_assert(renderer_present());
+
+	// nearer operations sort first, regardless of submission order
+	struct RenderOp ops[3] = {{ 0 }};
+	uint64_t keys[3];
+	for (int i = 0; i < 3; i++) {
+		ops[i].pass = RENDER_PASS;
+		ops[i].type = MESH_OP;
+		ops[i].position = vec(0, 0, -100 + i * 45, 1);
+		ops[i].mesh.mesh = mesh;
+		keys[i] = render_op_key(&ops[i]);
+	}
+	ck_assert(keys[2] < keys[1]);
+	ck_assert(keys[1] < keys[0]);
+
+	// state sort ignores depth
+	ck_assert(renderer_set_option(RENDER_OPTION_SORT_MODE, RENDER_SORT_STATE));
+	ck_assert(render_op_key(&ops[0]) == render_op_key(&ops[2]));
+}
+END_TEST
+
+START_TEST(test_render_depth_prepass)
+{
+	ck_assert(renderer_set_option(RENDER_OPTION_DEPTH_PREPASS, 1));
+	ck_assert_int_eq(renderer_get_option(RENDER_OPTION_DEPTH_PREPASS), 1);
+
+	struct AnimationInstance *inst = animation_instance_new(
+		&mesh->animations[0]
+	);
+	ck_assert(inst != NULL);
+	animation_instance_play(inst, 1.234);
+
+	Mat identity;
+	mat_ident(&identity);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct Light light = {
+		.projection = identity
+	};
+
+	Vec eye = vec(0, 0, 0, 0);
+
+	// static and animated meshes both go through the pre-pass
+	struct MeshProps props = {
+		.cast_shadows = 1,
+		.receive_shadows = 1,
+		.animation = NULL,
+		.material = NULL
+	};
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, &light, &eye));
+	props.animation = inst;
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, &light, &eye));
+	ck_assert(renderer_present());
+
+	// both meshes are pre-passed, then drawn in as many calls each
+	struct RenderStats stats;
+	renderer_get_stats(&stats);
+	ck_assert_uint_eq(stats.depth_ops, 2);
+	ck_assert_uint_eq(stats.render_ops, 2);
+	ck_assert_uint_eq(stats.shadow_ops, 2);
+	ck_assert_uint_eq(stats.draw_calls, 6);
+
+	// depth test and writes are back to normal after the render pass
+	GLint depth_func, depth_mask;
+	glGetIntegerv(GL_DEPTH_FUNC, &depth_func);
+	glGetIntegerv(GL_DEPTH_WRITEMASK, &depth_mask);
+	ck_assert_int_eq(depth_func, GL_LESS);
+	ck_assert_int_eq(depth_mask, GL_TRUE);
+
+	animation_instance_free(inst);
+	ck_assert(renderer_set_option(RENDER_OPTION_DEPTH_PREPASS, 0));
+}
+END_TEST
+
+START_TEST(test_render_frame_timings)
+{
+	Mat identity;
+	mat_ident(&identity);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct AnimationInstance *inst = animation_instance_new(
+		&mesh->animations[0]
+	);
+	ck_assert(inst != NULL);
+	animation_instance_play(inst, 1.234);
+
+	struct MeshProps props = {
+		.cast_shadows = 0,
+		.receive_shadows = 0,
+		.animation = inst,
+		.material = NULL
+	};
+
+	// GPU timings are collected a few frames later
+	for (int i = 0; i < 8; i++) {
+		ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, NULL, NULL));
+		ck_assert(renderer_present());
+	}
+	animation_instance_free(inst);
+
+	// each CPU stage is measured and they are all part of the frame
+	struct RenderFrameTimings timings;
+	renderer_get_frame_timings(&timings);
+	ck_assert(timings.cpu_skinning > 0);
+	ck_assert(timings.cpu_sort > 0);
+	ck_assert(timings.cpu_exec > 0);
+	ck_assert(
+		timings.cpu_total >=
+		timings.cpu_upload +
+		timings.cpu_skinning +
+		timings.cpu_sort +
+		timings.cpu_exec
+	);
+
+	// GPU passes add up to the frame total
+	double gpu_passes = (
+		timings.gpu_shadow +
+		timings.gpu_depth +
+		timings.gpu_render +
+		timings.gpu_overlay
+	);
+	ck_assert(fabs(timings.gpu_total - gpu_passes) < 1e-6);
+}
+END_TEST
+
+START_TEST(test_render_stats)
+{
+	Mat identity;
+	mat_ident(&identity);
+
+	struct Transform transform = {
+		.model = model,
+		.view = identity,
+		.projection = identity
+	};
+
+	struct MeshProps props = {
+		.cast_shadows = 0,
+		.receive_shadows = 0,
+		.animation = NULL,
+		.material = NULL
+	};
+
+	// identical meshes are drawn with a single instanced call
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, NULL, NULL));
+	ck_assert(render_mesh(RENDER_TARGET_FRAMEBUFFER, mesh, &props, &transform, NULL, NULL));
+	ck_assert(renderer_present());
+
+	struct RenderStats stats;
+	renderer_get_stats(&stats);
+	ck_assert_uint_eq(stats.render_ops, 2);
+	ck_assert_uint_eq(stats.shadow_ops, 0);
+	ck_assert_uint_eq(stats.draw_calls, 1);
+	ck_assert_uint_eq(stats.triangles, 2 * mesh->index_count / 3);
+	ck_assert_uint_gt(stats.program_binds, 0);
+	// mesh constants are streamed, not set one uniform at a time
+	ck_assert_uint_eq(stats.uniform_calls, 0);
+	ck_assert_uint_gt(stats.bytes_uploaded, 0);
+
+	// counters are reset on each frame
+	ck_assert(renderer_present());
+	renderer_get_stats(&stats);
+	ck_assert_uint_eq(stats.render_ops, 0);
+	ck_assert_uint_eq(stats.draw_calls, 0);
+}
+END_TEST
+
 static void
 suite_setup(void)
 {
 	setup();
 	mesh = mesh_from_file("tests/data/zombie.mesh");
+
+	Vec offset = vec(0, -0.7, 0, 0);
+	Vec scale = vec(0.01, 0.01, 0.01, 0);
+	mat_ident(&model);
+	mat_translatev(&model, &offset);
+	mat_scalev(&model, &scale);
 }
 
 static void
@@ -144,6 +507,14 @@ render_suite(void)
 	tcase_add_test(tc_core, test_render_mesh_textured);
 	tcase_add_test(tc_core, test_render_mesh_shadowed);
 	tcase_add_test(tc_core, test_render_mesh_animated);
+	tcase_add_test(tc_core, test_render_mesh_animated_shadowed);
+	tcase_add_test(tc_core, test_render_mesh_many);
+	tcase_add_test(tc_core, test_render_state_cache);
+	tcase_add_test(tc_core, test_render_mesh_culled);
+	tcase_add_test(tc_core, test_render_sort_front_to_back);
+	tcase_add_test(tc_core, test_render_depth_prepass);
+	tcase_add_test(tc_core, test_render_frame_timings);
+	tcase_add_test(tc_core, test_render_stats);
 
 	suite_add_tcase(s, tc_core);
 
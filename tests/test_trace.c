@@ -0,0 +1,65 @@
+#include <renderlib.h>
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_FILE "test_trace.json"
+
+#ifdef ENABLE_TRACE
+static char*
+dump_trace(void)
+{
+	ck_assert(renderer_trace_dump(TRACE_FILE));
+	FILE *fp = fopen(TRACE_FILE, "rb");
+	ck_assert(fp != NULL);
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	rewind(fp);
+	char *data = malloc(size + 1);
+	ck_assert(data != NULL);
+	ck_assert_int_eq(fread(data, 1, size, fp), size);
+	data[size] = 0;
+	fclose(fp);
+	remove(TRACE_FILE);
+	return data;
+}
+#endif
+
+START_TEST(test_trace_dump)
+{
+#ifdef ENABLE_TRACE
+	struct Image *image = image_from_file("tests/data/star.png");
+	ck_assert(image != NULL);
+	image_free(image);
+
+	// loaders are traced, with decoding nested in file loading
+	char *data = dump_trace();
+	ck_assert(strstr(data, "{\"traceEvents\":[") == data);
+	ck_assert(strstr(data, "\"name\":\"image_from_file\"") != NULL);
+	ck_assert(strstr(data, "\"name\":\"image_from_buffer\"") != NULL);
+	free(data);
+
+	// cleared events are not dumped again
+	renderer_trace_clear();
+	data = dump_trace();
+	ck_assert(strstr(data, "image_from_file") == NULL);
+	free(data);
+#else
+	ck_assert(!renderer_trace_dump(TRACE_FILE));
+#endif
+}
+END_TEST
+
+Suite*
+trace_suite(void)
+{
+	Suite *s = suite_create("trace");
+
+	TCase *tc_core = tcase_create("core");
+	tcase_add_test(tc_core, test_trace_dump);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -9,14 +9,31 @@ from struct import pack
 import argparse
 import os
 import pyassimp
+from pyassimp.postprocess import aiProcess_JoinIdenticalVertices
+from pyassimp.postprocess import aiProcess_Triangulate
 
 
-VERSION_MAJOR = 1
 VERSION_MINOR = 0
-VERSION = VERSION_MINOR << 4 | VERSION_MAJOR
+VERSIONS = {
+    1: VERSION_MINOR << 4 | 1,
+    2: VERSION_MINOR << 4 | 2,
+}
+
+# v2 sections start at offsets multiple of this
+SECTION_ALIGNMENT = 16
 
 MAX_JOINTS_PER_VERTEX = 4
 
+# entries of the simulated FIFO post-transform cache, see mesh_optimize.h
+VERTEX_CACHE_SIZE = 16
+
+# Forsyth vertex cache optimization parameters
+FORSYTH_CACHE_SIZE = 32
+FORSYTH_CACHE_DECAY = 1.5
+FORSYTH_LAST_TRIANGLE_SCORE = 0.75
+FORSYTH_VALENCE_SCALE = 2.0
+FORSYTH_VALENCE_POWER = 0.5
+
 IDENTITY_MATRIX = [
     [1.0, 0.0, 0.0, 0.0],
     [0.0, 1.0, 0.0, 0.0],
@@ -37,6 +54,193 @@ class DataFormatError(Exception):
     pass
 
 
+def sign(x):
+    return 1.0 if x >= 0 else -1.0
+
+
+def snorm16(x):
+    return int(round(max(-1.0, min(1.0, x)) * 32767))
+
+
+def unorm16(x):
+    return int(round(max(0.0, min(1.0, x)) * 65535))
+
+
+def octahedral_encode(n):
+    """Map a unit vector to the [-1, 1] square, folding the lower hemisphere
+    over the upper one."""
+    x, y, z = n
+    l1 = abs(x) + abs(y) + abs(z)
+    if l1 == 0:
+        return 0.0, 0.0
+    x, y, z = x / l1, y / l1, z / l1
+    if z < 0:
+        x, y = (1.0 - abs(y)) * sign(x), (1.0 - abs(x)) * sign(y)
+    return x, y
+
+
+def position_bounds(vertices):
+    """Return the offset and scale which map positions to [-1, 1]."""
+    lo = [min(v[c] for v in vertices) for c in range(3)]
+    hi = [max(v[c] for v in vertices) for c in range(3)]
+    offset = [(lo[c] + hi[c]) / 2.0 for c in range(3)]
+    scale = [(hi[c] - lo[c]) / 2.0 or 1.0 for c in range(3)]
+    return offset, scale
+
+
+def pad(fp):
+    fp.write(b'\0' * (-fp.tell() % SECTION_ALIGNMENT))
+
+
+def vertex_cache_stats(indices, v_count):
+    """Return ACMR (transformed vertices per triangle) and ATVR (transformed
+    vertices per referenced vertex) of indices, on a FIFO cache."""
+    stamps = [0] * v_count
+    time = VERTEX_CACHE_SIZE + 1
+    misses = unique = 0
+    for v in indices:
+        unique += stamps[v] == 0
+        if time - stamps[v] > VERTEX_CACHE_SIZE:
+            stamps[v] = time
+            time += 1
+            misses += 1
+    return misses / float(len(indices) // 3), misses / float(unique)
+
+
+def forsyth_vertex_score(cache_pos, valence):
+    if valence == 0:
+        return -1.0
+    score = FORSYTH_VALENCE_SCALE * valence ** -FORSYTH_VALENCE_POWER
+    if cache_pos < 0:
+        pass
+    elif cache_pos < 3:
+        score += FORSYTH_LAST_TRIANGLE_SCORE
+    else:
+        scale = 1.0 / (FORSYTH_CACHE_SIZE - 3)
+        score += (1.0 - (cache_pos - 3) * scale) ** FORSYTH_CACHE_DECAY
+    return score
+
+
+def optimize_vertex_cache(indices, v_count):
+    """Reorder triangles for post-transform vertex cache hits, with Tom
+    Forsyth's linear-speed algorithm."""
+    triangles = [indices[i:i + 3] for i in range(0, len(indices), 3)]
+    adjacency = [[] for _ in range(v_count)]
+    for t, tri in enumerate(triangles):
+        for v in tri:
+            adjacency[v].append(t)
+
+    vertex_scores = [forsyth_vertex_score(-1, len(adj)) for adj in adjacency]
+    triangle_scores = [sum(vertex_scores[v] for v in tri) for tri in triangles]
+    emitted = [False] * len(triangles)
+    cache = []
+    result = []
+    next_unemitted = 0
+    best = max(range(len(triangles)), key=lambda t: triangle_scores[t])
+
+    for _ in range(len(triangles)):
+        if best is None:
+            # no candidates in cache, restart from the next triangle not
+            # yet added
+            while emitted[next_unemitted]:
+                next_unemitted += 1
+            best = next_unemitted
+
+        tri = triangles[best]
+        result.extend(tri)
+        emitted[best] = True
+        for v in set(tri):
+            adjacency[v] = [t for t in adjacency[v] if t != best]
+
+        # move the triangle vertices to the front of the cache, then update
+        # scores of vertices in cache or pushed out of it
+        new_cache = [v for i, v in enumerate(tri) if v not in tri[:i]]
+        new_cache += [v for v in cache if v not in tri]
+        for pos, v in enumerate(new_cache):
+            score = forsyth_vertex_score(
+                pos if pos < FORSYTH_CACHE_SIZE else -1, len(adjacency[v]))
+            delta = score - vertex_scores[v]
+            vertex_scores[v] = score
+            for t in adjacency[v]:
+                triangle_scores[t] += delta
+        cache = new_cache[:FORSYTH_CACHE_SIZE]
+
+        candidates = [t for v in cache for t in adjacency[v]]
+        best = max(candidates, key=lambda t: triangle_scores[t]) if candidates else None
+
+    return result
+
+
+def optimize_overdraw(indices, positions):
+    """Reorder clusters of triangles, split where the FIFO cache restarts, so
+    that those facing away from the mesh center come first."""
+    stamps = [0] * len(positions)
+    time = VERTEX_CACHE_SIZE + 1
+    clusters = []
+    for i in range(0, len(indices), 3):
+        misses = 0
+        for v in indices[i:i + 3]:
+            if time - stamps[v] > VERTEX_CACHE_SIZE:
+                stamps[v] = time
+                time += 1
+                misses += 1
+        if i == 0 or misses == 3:
+            clusters.append([])
+        clusters[-1].extend(indices[i:i + 3])
+
+    # area weighted centroid and normal of each cluster and of the mesh
+    stats = []
+    mesh_centroid = [0.0, 0.0, 0.0]
+    mesh_area = 0.0
+    for cluster in clusters:
+        centroid = [0.0, 0.0, 0.0]
+        normal = [0.0, 0.0, 0.0]
+        area = 0.0
+        for i in range(0, len(cluster), 3):
+            p0, p1, p2 = [positions[v] for v in cluster[i:i + 3]]
+            e1 = [p1[c] - p0[c] for c in range(3)]
+            e2 = [p2[c] - p0[c] for c in range(3)]
+            n = [
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0],
+            ]
+            a = sum(x * x for x in n) ** 0.5
+            for c in range(3):
+                centroid[c] += (p0[c] + p1[c] + p2[c]) / 3.0 * a
+                normal[c] += n[c]
+            area += a
+        for c in range(3):
+            mesh_centroid[c] += centroid[c]
+        mesh_area += area
+        stats.append((centroid, normal, area))
+    mesh_centroid = [x / mesh_area if mesh_area else 0.0 for x in mesh_centroid]
+
+    def outwardness(k):
+        centroid, normal, area = stats[k]
+        length = sum(x * x for x in normal) ** 0.5
+        if not area or not length:
+            return 0.0
+        return sum(
+            (centroid[c] / area - mesh_centroid[c]) * normal[c] / length
+            for c in range(3))
+
+    order = sorted(range(len(clusters)), key=outwardness, reverse=True)
+    return [v for k in order for v in clusters[k]]
+
+
+def optimize_vertex_fetch(indices):
+    """Number vertices by first use; return the source vertex of each output
+    vertex and the remapped indices."""
+    remap = {}
+    order = []
+    for v in indices:
+        if v not in remap:
+            remap[v] = len(order)
+            order.append(v)
+    return order, [remap[v] for v in indices]
+
+
 def traverse_children(node, op):
     for child in node.children:
         if op(child):
@@ -213,12 +417,185 @@ def load_skeleton(scene):
     return skeleton, vertex_bone_ids, vertex_bone_weights
 
 
-def main(mesh, out, anims=None):
-    scene = pyassimp.load(mesh)
+def joint_attribs(v, vertex_bone_ids, vertex_bone_weights):
+    """Return joint IDs and weights of a vertex, padded to
+    MAX_JOINTS_PER_VERTEX."""
+    ids = list(vertex_bone_ids.get(v, []))
+    weights = list(vertex_bone_weights.get(v, []))
+    bindings_count = len(ids)
+    ids.extend([255] * (MAX_JOINTS_PER_VERTEX - bindings_count))
+    weights.extend([0] * (MAX_JOINTS_PER_VERTEX - bindings_count))
+    return ids + weights
+
+
+def write_v1(fp, scene, mesh, fmt, order, indices, skeleton,
+             vertex_bone_ids, vertex_bone_weights, animations):
+    # write header
+    header = pack(
+        '<bhLLBH',
+        VERSIONS[1],
+        fmt,
+        len(order),
+        len(indices),
+        len(skeleton),
+        len(animations))
+    fp.write(header)
+
+    # write root transformation
+    for val in chain.from_iterable(scene.rootnode.transformation):
+        fp.write(pack('<f', val))
+
+    # write vertices, in output order
+    for v in order:
+        # position
+        px, py, pz = mesh.vertices[v]
+        fp.write(pack('<fff', px, py, pz))
+
+        # normal
+        if fmt & VertexFormat.has_normal:
+            nx, ny, nz = mesh.normals[v]
+            fp.write(pack('<fff', nx, ny, nz))
+
+        # UV
+        if fmt & VertexFormat.has_uv:
+            tx, ty, _ = mesh.texturecoords[0][v]
+            fp.write(pack('<ff', tx, ty))
+
+        # joint data
+        if fmt & VertexFormat.has_joints:
+            for attr in joint_attribs(v, vertex_bone_ids, vertex_bone_weights):
+                fp.write(pack('<B', attr))
+
+    # write indices
+    for i in indices:
+        fp.write(pack('<L', i))
+
+    # write joints
+    for j_id, p_id, transform in sorted(skeleton.values(), key=lambda j: j[0]):
+        fp.write(pack('<BB', j_id, p_id))
+        for row in transform:
+            fp.write(pack('<ffff', *row))
+
+    # write animations
+    for timestamps, poses, duration, tickspersecond in animations:
+        # header
+        fp.write(pack(
+            '<ffL',
+            duration,
+            tickspersecond,
+            len(timestamps)))
+
+        # timestamps
+        for t in timestamps:
+            fp.write(pack('<f', t))
+
+        # pose data
+        for joint_id, pos, rot, scale in poses:
+            pose = pack(
+                '<Bffffffffff',
+                joint_id,
+                pos[0], pos[1], pos[2],
+                rot[0], rot[1], rot[2], rot[3],
+                scale[0], scale[1], scale[2])
+            fp.write(pose)
+
+
+def write_v2(fp, scene, mesh, fmt, order, indices, skeleton,
+             vertex_bone_ids, vertex_bone_weights, animations):
+    offset, scale = position_bounds([mesh.vertices[v] for v in order])
+
+    # write header
+    fp.write(pack(
+        '<BBHLLHH',
+        VERSIONS[2],
+        len(skeleton),
+        fmt,
+        len(order),
+        len(indices),
+        len(animations),
+        0))
+    fp.write(pack('<ffff', scale[0], scale[1], scale[2], 0))
+    fp.write(pack('<ffff', offset[0], offset[1], offset[2], 0))
+
+    # write root transformation
+    for val in chain.from_iterable(scene.rootnode.transformation):
+        fp.write(pack('<f', val))
+
+    # write vertices, in output order
+    for v in order:
+        # position, as snorm16 relative to mesh bounds, padded to 8 bytes
+        p = mesh.vertices[v]
+        fp.write(pack(
+            '<hhhh',
+            snorm16((p[0] - offset[0]) / scale[0]),
+            snorm16((p[1] - offset[1]) / scale[1]),
+            snorm16((p[2] - offset[2]) / scale[2]),
+            0))
+
+        # normal, octahedral-encoded
+        if fmt & VertexFormat.has_normal:
+            ox, oy = octahedral_encode(mesh.normals[v])
+            fp.write(pack('<hh', snorm16(ox), snorm16(oy)))
+
+        # UV, as unorm16
+        if fmt & VertexFormat.has_uv:
+            tx, ty, _ = mesh.texturecoords[0][v]
+            if not (0 <= tx <= 1 and 0 <= ty <= 1):
+                raise DataFormatError(
+                    'UV coordinates of vertex {} out of [0, 1] range, '
+                    'convert to format 1'.format(v))
+            fp.write(pack('<HH', unorm16(tx), unorm16(ty)))
+
+        # joint data
+        if fmt & VertexFormat.has_joints:
+            for attr in joint_attribs(v, vertex_bone_ids, vertex_bone_weights):
+                fp.write(pack('<B', attr))
+    pad(fp)
+
+    # write indices
+    for i in indices:
+        fp.write(pack('<L', i))
+    pad(fp)
+
+    # write joints, in ID order
+    for j_id, p_id, transform in sorted(skeleton.values(), key=lambda j: j[0]):
+        for row in transform:
+            fp.write(pack('<ffff', *row))
+        fp.write(pack('<B', p_id))
+        fp.write(b'\0' * 15)
+
+    # write animations
+    for timestamps, poses, duration, tickspersecond in animations:
+        # header
+        fp.write(pack(
+            '<ffLL',
+            duration,
+            tickspersecond,
+            len(timestamps),
+            0))
+
+        # timestamps
+        for t in timestamps:
+            fp.write(pack('<f', t))
+        pad(fp)
+
+        # pose data, sorted by joint ID
+        for joint_id, pos, rot, scl in poses:
+            fp.write(pack('<ffff', pos[0], pos[1], pos[2], 0))
+            fp.write(pack('<ffff', rot[0], rot[1], rot[2], rot[3]))
+            fp.write(pack('<ffff', scl[0], scl[1], scl[2], 0))
+
+
+def main(mesh, out, version=2, anims=None, optimize=True):
+    scene = pyassimp.load(
+        mesh,
+        processing=aiProcess_Triangulate | aiProcess_JoinIdenticalVertices)
 
     anim_counter = count(0)
     animations = []
     skeleton = {}
+    vertex_bone_ids = {}
+    vertex_bone_weights = {}
 
     if scene.mNumMeshes != 1:
         raise DataFormatError('File expected to contain exactly one mesh')
@@ -247,88 +624,30 @@ def main(mesh, out, anims=None):
             for anim in load_animations(anim_scene, skeleton, anim_counter):
                 animations.append(anim)
 
+    # triangles reordered for vertex cache hits, then overdraw, and vertices
+    # for fetch locality
+    indices = [int(i) for face in mesh.faces for i in face]
+    if len(indices) != len(mesh.faces) * 3:
+        raise DataFormatError('mesh has non-triangle faces')
+    acmr, atvr = vertex_cache_stats(indices, v_count)
+    print('Vertex cache before: ACMR {:.3f}, ATVR {:.3f}'.format(acmr, atvr))
+    if optimize:
+        indices = optimize_vertex_cache(indices, v_count)
+        indices = optimize_overdraw(indices, mesh.vertices)
+    order, indices = optimize_vertex_fetch(indices)
+    acmr, atvr = vertex_cache_stats(indices, len(order))
+    print('Vertex cache after:  ACMR {:.3f}, ATVR {:.3f}'.format(acmr, atvr))
+
     with open(out, 'wb') as fp:
-        # write header
-        header = pack(
-            '<bhLLBH',
-            VERSION,
-            fmt,
-            v_count,
-            v_count,
-            len(skeleton),
-            len(animations))
-        fp.write(header)
-
-        # write root transformation
-        for val in chain.from_iterable(scene.rootnode.transformation):
-            fp.write(pack('<f', val))
-
-        # write vertices
-        for v in range(v_count):
-            # position
-            px, py, pz = mesh.vertices[v]
-            fp.write(pack('<fff', px, py, pz))
-
-            # normal
-            if fmt & VertexFormat.has_normal:
-                nx, ny, nz = mesh.normals[v]
-                fp.write(pack('<fff', nx, ny, nz))
-
-            # UV
-            if fmt & VertexFormat.has_uv:
-                tx, ty, _ = mesh.texturecoords[0][v]
-                fp.write(pack('<ff', tx, ty))
-
-            # joint data
-            if fmt & VertexFormat.has_joints:
-                ids, weights = vertex_bone_ids.get(v, []), vertex_bone_weights.get(v, [])
-
-                # extend the arrays to size equal to MAX_JOINTS_PER_VERTEX
-                bindings_count = len(ids)
-                ids.extend([255] * (MAX_JOINTS_PER_VERTEX - bindings_count))
-                weights.extend([0] * (MAX_JOINTS_PER_VERTEX - bindings_count))
-
-                for attr in ids + weights:
-                    fp.write(pack('<B', attr))
-
-        # write indices
-        for i in range(len(mesh.vertices)):
-            fp.write(pack('<L', i))
-
-        # write joints
-        for j_id, p_id, transform in sorted(skeleton.values(), key=lambda j: j[0]):
-            fp.write(pack('<BB', j_id, p_id))
-            for row in transform:
-                fp.write(pack('<ffff', *row))
-
-        # write animations
-        for timestamps, poses, duration, tickspersecond in animations:
-            # header
-            fp.write(pack(
-                '<ffL',
-                duration,
-                tickspersecond,
-                len(timestamps)))
-
-            # timestamps
-            for t in timestamps:
-                fp.write(pack('<f', t))
-
-            # pose data
-            for joint_id, pos, rot, scale in poses:
-                pose = pack(
-                    '<Bffffffffff',
-                    joint_id,
-                    pos[0], pos[1], pos[2],
-                    rot[0], rot[1], rot[2], rot[3],
-                    scale[0], scale[1], scale[2])
-                fp.write(pose)
+        write = write_v2 if version == 2 else write_v1
+        write(fp, scene, mesh, fmt, order, indices, skeleton,
+              vertex_bone_ids, vertex_bone_weights, animations)
 
     print('Mesh file:  {}'.format(out))
     print('Mesh size:  {} bytes'.format(os.stat(out).st_size))
     print('Polygons:   {}'.format(len(mesh.faces)))
-    print('Vertices:   {}'.format(v_count))
-    print('Indices:    {}'.format(v_count))
+    print('Vertices:   {}'.format(len(order)))
+    print('Indices:    {}'.format(len(indices)))
     print('Joints:     {}'.format(len(skeleton)))
     for i, (timeline, pose_data, duration, tickspersecond) in enumerate(animations):
         print('Animation {}:'.format(i))
@@ -344,10 +663,17 @@ if __name__ == '__main__':
     parser.add_argument('--mesh', type=str, required=True, help='Mesh file')
     parser.add_argument('--anims', type=str, nargs='+', help='Animation file')
     parser.add_argument('-o', type=str, help='Output filename')
+    parser.add_argument(
+        '--format', type=int, choices=sorted(VERSIONS), default=2,
+        help='MESH format version (default: 2)')
+    parser.add_argument(
+        '--no-optimize', action='store_true',
+        help='Keep the triangle order of the source file')
 
     args = parser.parse_args()
 
     try:
-        main(args.mesh, args.o, anims=args.anims or None)
+        main(args.mesh, args.o, version=args.format, anims=args.anims or None,
+             optimize=not args.no_optimize)
     except DataFormatError as err:
         print 'Conversion failed: {}'.format(err)